@@ -25,7 +25,7 @@
 #define A1_0_INIT_MUXSEL 0u
 #define A1_0_INPUT_SYNC 2u
 #define A1_0_INTERRUPT_MODE CY_GPIO_INTR_DISABLE
-#define A1_0_NUM 2u
+#define A1_0_NUM 1u
 #define A1_0_PORT GPIO_PRT10
 #define A1_0_SLEWRATE CY_GPIO_SLEW_FAST
 #define A1_0_THRESHOLD_LEVEL CY_GPIO_VTRIP_CMOS
@@ -35,7 +35,7 @@
 #define A1_INIT_MUXSEL 0u
 #define A1_INPUT_SYNC 2u
 #define A1_INTERRUPT_MODE CY_GPIO_INTR_DISABLE
-#define A1_NUM 2u
+#define A1_NUM 1u
 #define A1_PORT GPIO_PRT10
 #define A1_SLEWRATE CY_GPIO_SLEW_FAST
 #define A1_THRESHOLD_LEVEL CY_GPIO_VTRIP_CMOS
@@ -18,6 +18,7 @@ extern "C" {
 #define PCA9685_PULSE_WIDTH_MIN    (TIME_MIN)
 #define PCA9685_PULSE_WIDTH_MAX    (TIME_MAX)    
 #define CHANNELS_PER_DEVICE        (16u) 
+#define PCA9685_BURST_CHANNELS_MAX (8u)     // Channels per burst, limited by the I2C queue buffer
 
 typedef uint16_t Channel;
 typedef uint16_t Frequency;
@@ -44,6 +45,8 @@ union Mode1Register
     
 
   void PCA9685_Init(void);    
+  void PCA9685_allOff(void);          // Full off on all channels until a channel is written again
+  void PCA9685_emergencyOff(void);    // Same with polled I2C, usable from an interrupt while a transfer hangs
   void PCA9685_setToFrequency(Frequency frequency);
   void PCA9685_setToServoFrequency();
 
@@ -53,6 +56,26 @@ union Mode1Register
   void PCA9685_setChannelPulseWidth(Channel channel, Duration pulse_width);
   void PCA9685_setChannelOnAndOffTime(Channel channel, Time on_time, Time off_time);
 
+  // Atomic update of several channels: stage their values, then PCA9685_commit() sends
+  // the registers that differ from the RAM shadow, from the first to the last changed one,
+  // in one auto-increment transaction (nothing if none changed). MODE2 OCH = change on
+  // STOP, so all of them switch at its STOP, on the next PWM period of each channel.
+  // A span of up to PCA9685_BURST_CHANNELS_MAX channels fits in one transaction.
+  void PCA9685_stageChannelPulseWidth(Channel channel, Duration pulse_width);
+  void PCA9685_stageChannelOnAndOffTime(Channel channel, Time on_time, Time off_time);
+  void PCA9685_commit(void);
+
+  // Turn-on tick (0..4095) of a channel within the PWM period, used by every later pulse width
+  // of the channel. Spread phases keep the channels from switching on together, so their
+  // inrush currents do not add up. All channels start at phase 0.
+  void PCA9685_setChannelPhase(Channel channel, Time phase_shift);
+  Time PCA9685_getChannelPhase(Channel channel);
+  // Phases of count consecutive channels evenly over the period, TIME_MAX / count apart
+  void PCA9685_staggerPhases(Channel first_channel, uint8_t count);
+
+  // Bus time of the last and the longest PCA9685_commit(), microseconds; last is 0 if it sent nothing
+  void PCA9685_getBurstBusTime(uint32_t *last_us, uint32_t *max_us);
+
   Frequency PCA9685_getDeviceServoFrequency();
 
   union Mode1Register PCA9685_readMode1Register();
@@ -63,7 +86,7 @@ union Mode1Register
   void PCA9685_setPrescale(uint8_t prescale);
   uint8_t PCA9685_frequencyToPrescale(Frequency frequency);
 
-  void PCA9685_pulseWidthAndPhaseShiftToOnTimeAndOffTime(Duration pulse_width, Time *on_time, Time *off_time);
+  void PCA9685_pulseWidthAndPhaseShiftToOnTimeAndOffTime(Duration pulse_width, Time phase_shift, Time *on_time, Time *off_time);
 
 #ifdef __cplusplus
 }
@@ -1,13 +1,20 @@
 #include "PCA9685.h"
 #include "project.h"
 #include "utils.h"
+#include "i2c_queue.h"
 
 #define PCA9685_ADDRESS (0x5Fu)
 #define MODE1_REGISTER_ADDRESS (0x00)
+#define MODE2_REGISTER_ADDRESS (0x01)
+#define MODE2_OUTDRV_TOTEM_POLE (0x04u)
+#define MODE2_OCH_STOP (0x00u)       /* Outputs change on STOP, not on every ACK */
 
 const static uint8_t LED0_ON_L_REGISTER_ADDRESS = 0x06;
 const static uint8_t LED_REGISTERS_SIZE = 4;
 
+const static uint8_t ALL_LED_OFF_H_REGISTER_ADDRESS = 0xFD;
+const static uint8_t LED_FULL_OFF = 0x10;
+
 const static uint8_t PRE_SCALE_REGISTER_ADDRESS = 0xFE;
 const static uint8_t PRE_SCALE_MIN = 0x03;
 const static uint8_t PRE_SCALE_MAX = 0xFF;
@@ -19,136 +26,332 @@ const static uint8_t PRE_SCALE_MAX = 0xFF;
 #define RESTART_ENABLED (1u)
 #define RESTART_CLEAR (1u)
 
+#define EMERGENCY_TIMEOUT_MS (2u)
+
   const static Frequency SERVO_FREQUENCY = 50;
   const static DurationMicroseconds SERVO_PERIOD_MICROSECONDS = 20000;
 
+/* RAM mirror of MODE1 .. LED15_OFF_H, registers are written only when they change */
+#define SHADOW_SIZE (0x46u)
+#define WRITE_DATA_MAX (I2C_QUEUE_BUFFER_SIZE - 1u)
+#define MAX_RANGES (SHADOW_SIZE / WRITE_DATA_MAX + 1u)
+
+#define CONTEXT_COUNT_SHIFT (8u)
+#define CONTEXT_MEASURE (1uL << 16u)
+#define CONTEXT_LAST (1uL << 17u)
+
+static uint8_t shadow[SHADOW_SIZE];
+static volatile bool shadow_known[SHADOW_SIZE];
+static uint8_t prescale_shadow;
+static bool prescale_known = false;
+
+/* Commanded LED register values, the ones staged since the last PCA9685_commit() not sent yet */
+static uint8_t staged[SHADOW_SIZE];
+static uint8_t staged_first = SHADOW_SIZE;
+static uint8_t staged_last = 0;
+
+/* Turn-on instant of each channel within the period, spreads switching edges and inrush currents */
+static Time channel_phase[CHANNELS_PER_DEVICE];
+
+static volatile uint32_t burst_bus_time_us = 0;
+static volatile uint32_t burst_bus_time_max_us = 0;
+static uint32_t update_bus_time_us = 0;
+
 static void write8(uint8_t register_address, uint8_t data)
 {
-  cy_stc_scb_i2c_master_xfer_config_t transaction;
-  static uint8_t dataPacket[2];
-
-/* Wait for previous transaction completion */
-  while (0UL != (CY_SCB_I2C_MASTER_BUSY & Cy_SCB_I2C_MasterGetStatus(I2C_Main_HW, &I2C_Main_context)))
-  {
-  }
+  uint8_t dataPacket[2];
 
   dataPacket[0] = register_address;
   dataPacket[1] = data;
-
-  transaction.slaveAddress = PCA9685_ADDRESS;
-  transaction.buffer = dataPacket;
-  transaction.bufferSize = 2;
-  transaction.xferPending = false;
-  Cy_SCB_I2C_MasterWrite(I2C_Main_HW, &transaction, &I2C_Main_context);
+  I2cQueue_WriteWait(PCA9685_ADDRESS, dataPacket, 2, NULL, NULL);
 }
 
-static void write32(uint8_t register_address, uint32_t data)
+/* Completion of a shadowed write, context carries its register range */
+static void shadowWriteDone(enum i2cQueueStatus status, const uint8_t *data, uint8_t length, void *context)
 {
-  cy_stc_scb_i2c_master_xfer_config_t transaction;
-  static uint8_t dataPacket[5];
+  uint32_t info = (uint32_t)(uintptr_t)context;
+  uint8_t first = info & 0xFFu;
+  uint8_t count = (info >> CONTEXT_COUNT_SHIFT) & 0xFFu;
+  (void)data;
+  (void)length;
 
-/* Wait for previous transaction completion */
-  while (0UL != (CY_SCB_I2C_MASTER_BUSY & Cy_SCB_I2C_MasterGetStatus(I2C_Main_HW, &I2C_Main_context)))
+  if (status != I2C_QUEUE_OK)
   {
+    /* Device may hold old or new values, send them again next time */
+    for (uint8_t byte_n=0; byte_n<count; ++byte_n)
+    {
+      shadow_known[first + byte_n] = false;
+    }
+    update_bus_time_us = 0;
+    return;
   }
-
-  dataPacket[0] = register_address;
-  for (int byte_n=0; byte_n<4; ++byte_n)
+  if ((info & CONTEXT_MEASURE) != 0u)
   {
-    dataPacket[byte_n+1] = (data >> (8u * byte_n)) & 0xFFu;
-  }  
-
-  transaction.slaveAddress = PCA9685_ADDRESS;
-  transaction.buffer = dataPacket;
-  transaction.bufferSize = 5;
-  transaction.xferPending = false;
-  Cy_SCB_I2C_MasterWrite(I2C_Main_HW, &transaction, &I2C_Main_context);
+    update_bus_time_us += I2cQueue_GetBusTimeUs();
+    if ((info & CONTEXT_LAST) != 0u)
+    {
+      burst_bus_time_us = update_bus_time_us;
+      if (burst_bus_time_us > burst_bus_time_max_us)
+      {
+        burst_bus_time_max_us = burst_bus_time_us;
+      }
+      update_bus_time_us = 0;
+    }
+  }
 }
 
-static uint8_t read8(uint8_t register_address)
+/* Write the registers that differ from the shadow: first to last changed byte in one auto-increment
+   transaction, unchanged bytes between them rewritten, so the outputs change at one STOP (OCH).
+   Only spans longer than WRITE_DATA_MAX bytes take more than one transaction. */
+static void writeRegisters(uint8_t first_register, const uint8_t values[], uint8_t count, bool measure)
 {
-  cy_stc_scb_i2c_master_xfer_config_t transaction;
-  static uint8_t dataPacket[1];
+  uint8_t range_start[MAX_RANGES];
+  uint8_t range_end[MAX_RANGES];
+  uint8_t ranges = 0;
 
-  /* Wait for previous transaction completion */
-  while (0UL != (CY_SCB_I2C_MASTER_BUSY & Cy_SCB_I2C_MasterGetStatus(I2C_Main_HW, &I2C_Main_context)))
+  for (uint8_t byte_n=0; byte_n<count; ++byte_n)
   {
+    uint8_t register_address = first_register + byte_n;
+    if (shadow_known[register_address] && (shadow[register_address] == values[byte_n]))
+    {
+      continue;
+    }
+    if ((ranges > 0) && ((uint8_t)(byte_n - range_start[ranges - 1]) < WRITE_DATA_MAX))
+    {
+      range_end[ranges - 1] = byte_n;
+    }
+    else
+    {
+      range_start[ranges] = byte_n;
+      range_end[ranges] = byte_n;
+      ranges++;
+    }
   }
-  
-  dataPacket[0] = register_address;
 
-  transaction.slaveAddress = PCA9685_ADDRESS;
-  transaction.buffer = dataPacket;
-  transaction.bufferSize = 1;
-  transaction.xferPending = true;
-
-  Cy_SCB_I2C_MasterWrite(I2C_Main_HW, &transaction, &I2C_Main_context);
-
-/* Wait for previous transaction completion */
-   while (0UL != (CY_SCB_I2C_MASTER_BUSY & Cy_SCB_I2C_MasterGetStatus(I2C_Main_HW, &I2C_Main_context)))
+  if (measure && (ranges == 0))
+  {
+    burst_bus_time_us = 0;
+  }
+  for (uint8_t range_n=0; range_n<ranges; ++range_n)
   {
+    uint8_t dataPacket[I2C_QUEUE_BUFFER_SIZE];
+    uint8_t start = range_start[range_n];
+    uint8_t length = range_end[range_n] - start + 1;
+    uint32_t info = (first_register + start) | ((uint32_t)length << CONTEXT_COUNT_SHIFT);
+
+    if (measure)
+    {
+      info |= CONTEXT_MEASURE;
+      if (range_n == ranges - 1)
+      {
+        info |= CONTEXT_LAST;
+      }
+    }
+
+    /* Shadow holds what is on its way, a failed write forgets it again */
+    dataPacket[0] = first_register + start;
+    for (uint8_t byte_n=0; byte_n<length; ++byte_n)
+    {
+      dataPacket[byte_n + 1] = values[start + byte_n];
+      shadow[first_register + start + byte_n] = values[start + byte_n];
+      shadow_known[first_register + start + byte_n] = true;
+    }
+    I2cQueue_WriteWait(PCA9685_ADDRESS, dataPacket, length + 1, shadowWriteDone, (void *)(uintptr_t)info);
   }
+}
 
-  transaction.bufferSize = 1;
-  transaction.xferPending = false;
-  Cy_SCB_I2C_MasterRead(I2C_Main_HW, &transaction, &I2C_Main_context);
+/* ALL_LED_OFF_H set every LEDn_OFF_H to full off behind the shadow. Channels staged later keep
+   it in the commit span, the LED registers are sent in full next time. */
+static void ledsFullOff(void)
+{
+  for (uint8_t register_address=LED0_ON_L_REGISTER_ADDRESS; register_address<SHADOW_SIZE; ++register_address)
+  {
+    shadow_known[register_address] = false;
+  }
+  for (uint8_t channel=0; channel<CHANNELS_PER_DEVICE; ++channel)
+  {
+    staged[LED0_ON_L_REGISTER_ADDRESS + LED_REGISTERS_SIZE * channel + 3] = LED_FULL_OFF;
+  }
+}
 
-  return dataPacket[0];
+static void writeMode1(union Mode1Register mode1_register)
+{
+  writeRegisters(MODE1_REGISTER_ADDRESS, &mode1_register.data, 1, false);
 }
 
+/* MODE1 comes from the shadow, PCA9685_Init() wrote it, no read back needed */
 static void sleep()
 {
   union Mode1Register mode1_register;
-  mode1_register.data = read8(MODE1_REGISTER_ADDRESS);
+  mode1_register.data = shadow[MODE1_REGISTER_ADDRESS];
   mode1_register.fields.sleep = SLEEP;
-  write8(MODE1_REGISTER_ADDRESS,mode1_register.data);
+  writeMode1(mode1_register);
 }
 
 static void wake()
 {
   union Mode1Register mode1_register;
-  mode1_register.data = read8(MODE1_REGISTER_ADDRESS);
+  mode1_register.data = shadow[MODE1_REGISTER_ADDRESS];
   mode1_register.fields.sleep = WAKE;
   mode1_register.fields.ai = AUTO_INCREMENT_ENABLED;
-  write8(MODE1_REGISTER_ADDRESS,mode1_register.data);
-  if (mode1_register.fields.restart == RESTART_ENABLED)
+  writeMode1(mode1_register);
+
+  /* RESTART is set by the device if PWM ran before sleep; writing 1 while it is clear has no effect,
+     so restart unconditionally instead of reading it. The oscillator needs 500 us after the wake write. */
+  while (!I2cQueue_IsIdle())
   {
-    CyDelay(1);
-    mode1_register.fields.restart = RESTART_CLEAR;
-    write8(MODE1_REGISTER_ADDRESS,mode1_register.data);
   }
+  CyDelay(1);
+  mode1_register.fields.restart = RESTART_CLEAR;
+  write8(MODE1_REGISTER_ADDRESS,mode1_register.data);
 }
 
 void PCA9685_Init(void)
 {
-  /* write 0x00, 0x00 to PCA9685 */
-  uint8_t dataToSend[2u] = {0x00, 0x00}; 
-  cy_stc_scb_i2c_master_xfer_config_t transaction;
-
-  transaction.slaveAddress = PCA9685_ADDRESS;
-  transaction.buffer = dataToSend;
-  transaction.bufferSize = 2u;
-  transaction.xferPending = false;
-  Cy_SCB_I2C_MasterWrite(I2C_Main_HW, &transaction, &I2C_Main_context);
+  /* write 0x00 to MODE1, whatever the state after an MCU reset is */
+  union Mode1Register mode1_register;
+  for (uint8_t register_address=0; register_address<SHADOW_SIZE; ++register_address)
+  {
+    shadow_known[register_address] = false;
+  }
+  prescale_known = false;
+  staged_first = SHADOW_SIZE;
+  staged_last = 0;
+  ledsFullOff();
+  mode1_register.data = 0x00;
+  writeMode1(mode1_register);
+
+  /* Power-on value, written anyway: the atomic commit relies on output change on STOP */
+  uint8_t mode2 = MODE2_OUTDRV_TOTEM_POLE | MODE2_OCH_STOP;
+  writeRegisters(MODE2_REGISTER_ADDRESS, &mode2, 1, false);
 }    
 
+void PCA9685_allOff(void)
+{
+  write8(ALL_LED_OFF_H_REGISTER_ADDRESS, LED_FULL_OFF);
+  ledsFullOff();
+}
+
+void PCA9685_emergencyOff(void)
+{
+  /* Take the block away from the interrupt driven driver, dropping any transfer in progress.
+     Queued duty writes are dropped too, they would turn the motors back on. */
+  NVIC_DisableIRQ(I2C_Main_SCB_IRQ_cfg.intrSrc);
+  I2cQueue_Abort();
+  ledsFullOff();
+  Cy_SCB_I2C_Disable(I2C_Main_HW, &I2C_Main_context);
+  Cy_SCB_SetMasterInterruptMask(I2C_Main_HW, CY_SCB_CLEAR_ALL_INTR_SRC);
+  Cy_SCB_SetTxInterruptMask(I2C_Main_HW, CY_SCB_CLEAR_ALL_INTR_SRC);
+  Cy_SCB_ClearTxFifo(I2C_Main_HW);
+  Cy_SCB_ClearRxFifo(I2C_Main_HW);
+  Cy_SCB_I2C_Enable(I2C_Main_HW);
+
+  /* Polled write of the full off bit of all channels */
+  if (CY_SCB_I2C_SUCCESS == Cy_SCB_I2C_MasterSendStart(I2C_Main_HW, PCA9685_ADDRESS, CY_SCB_I2C_WRITE_XFER,
+                                                       EMERGENCY_TIMEOUT_MS, &I2C_Main_context))
+  {
+    (void)Cy_SCB_I2C_MasterWriteByte(I2C_Main_HW, ALL_LED_OFF_H_REGISTER_ADDRESS, EMERGENCY_TIMEOUT_MS, &I2C_Main_context);
+    (void)Cy_SCB_I2C_MasterWriteByte(I2C_Main_HW, LED_FULL_OFF, EMERGENCY_TIMEOUT_MS, &I2C_Main_context);
+  }
+  (void)Cy_SCB_I2C_MasterSendStop(I2C_Main_HW, EMERGENCY_TIMEOUT_MS, &I2C_Main_context);
+
+  /* Hand the block back to the queue, it is empty now */
+  Cy_SCB_ClearMasterInterrupt(I2C_Main_HW, CY_SCB_I2C_MASTER_INTR_ALL);
+  NVIC_ClearPendingIRQ(I2C_Main_SCB_IRQ_cfg.intrSrc);
+  NVIC_EnableIRQ(I2C_Main_SCB_IRQ_cfg.intrSrc);
+}
+
 void PCA9685_setChannelPulseWidth(Channel channel, Duration pulse_width)
+{
+  PCA9685_stageChannelPulseWidth(channel,pulse_width);
+  PCA9685_commit();
+}
+
+void PCA9685_setChannelOnAndOffTime(Channel channel, Time on_time, Time off_time)
+{
+  if (channel >= CHANNELS_PER_DEVICE)
+  {
+    return;
+  }
+  PCA9685_stageChannelOnAndOffTime(channel,on_time,off_time);
+  PCA9685_commit();
+}
+
+void PCA9685_stageChannelPulseWidth(Channel channel, Duration pulse_width)
 {
   Time on_time;
   Time off_time;
-  PCA9685_pulseWidthAndPhaseShiftToOnTimeAndOffTime(pulse_width,&on_time,&off_time);
-  PCA9685_setChannelOnAndOffTime(channel,on_time,off_time);
+  if (channel >= CHANNELS_PER_DEVICE)
+  {
+    return;
+  }
+  PCA9685_pulseWidthAndPhaseShiftToOnTimeAndOffTime(pulse_width,channel_phase[channel],&on_time,&off_time);
+  PCA9685_stageChannelOnAndOffTime(channel,on_time,off_time);
 }
 
-void PCA9685_setChannelOnAndOffTime(Channel channel, Time on_time, Time off_time)
+void PCA9685_stageChannelOnAndOffTime(Channel channel, Time on_time, Time off_time)
 {
   if (channel >= CHANNELS_PER_DEVICE)
   {
     return;
   }
   uint8_t register_address = LED0_ON_L_REGISTER_ADDRESS + LED_REGISTERS_SIZE * channel;
-  uint32_t data = (off_time << 16u) | on_time;
-  write32(register_address,data);
+  staged[register_address] = on_time & 0xFFu;
+  staged[register_address + 1] = on_time >> 8u;
+  staged[register_address + 2] = off_time & 0xFFu;
+  staged[register_address + 3] = off_time >> 8u;
+  if (register_address < staged_first)
+  {
+    staged_first = register_address;
+  }
+  if (register_address + 3 > staged_last)
+  {
+    staged_last = register_address + 3;
+  }
+}
+
+void PCA9685_commit(void)
+{
+  if (staged_first > staged_last)
+  {
+    return;
+  }
+  /* Registers of consecutive channels are contiguous, MODE1 auto-increment (set in wake()) walks them */
+  writeRegisters(staged_first, &staged[staged_first], staged_last - staged_first + 1, true);
+  staged_first = SHADOW_SIZE;
+  staged_last = 0;
+}
+
+void PCA9685_setChannelPhase(Channel channel, Time phase_shift)
+{
+  if (channel < CHANNELS_PER_DEVICE)
+  {
+    channel_phase[channel] = phase_shift % TIME_MAX;
+  }
+}
+
+Time PCA9685_getChannelPhase(Channel channel)
+{
+  return (channel < CHANNELS_PER_DEVICE) ? channel_phase[channel] : TIME_MIN;
+}
+
+void PCA9685_staggerPhases(Channel first_channel, uint8_t count)
+{
+  if ((count == 0) || (first_channel + count > CHANNELS_PER_DEVICE))
+  {
+    return;
+  }
+  /* Evenly over the period: no two channels of the group turn on at the same tick */
+  for (uint8_t channel_n=0; channel_n<count; ++channel_n)
+  {
+    channel_phase[first_channel + channel_n] = (Time)((TIME_MAX * channel_n) / count);
+  }
+}
+
+void PCA9685_getBurstBusTime(uint32_t *last_us, uint32_t *max_us)
+{
+  *last_us = burst_bus_time_us;
+  *max_us = burst_bus_time_max_us;
 }
 
 void PCA9685_setToFrequency(Frequency frequency)
@@ -164,8 +367,15 @@ void PCA9685_setToServoFrequency()
 
 void PCA9685_setPrescale(uint8_t prescale)
 {
+  /* PRE_SCALE is written only in sleep, skip the whole sequence if it holds the value already */
+  if (prescale_known && (prescale_shadow == prescale))
+  {
+    return;
+  }
   sleep();
   write8(PRE_SCALE_REGISTER_ADDRESS,prescale);
+  prescale_shadow = prescale;
+  prescale_known = true;
   wake();
 }
 
@@ -178,6 +388,7 @@ uint8_t PCA9685_frequencyToPrescale(Frequency frequency)
 }
 
 void PCA9685_pulseWidthAndPhaseShiftToOnTimeAndOffTime(Duration pulse_width,
+  Time phase_shift,
   Time *on_time,
   Time *off_time)
 {
@@ -193,7 +404,8 @@ void PCA9685_pulseWidthAndPhaseShiftToOnTimeAndOffTime(Duration pulse_width,
     *off_time = TIME_MIN;
     return;
   }
-  *on_time = 0;
+  /* Off before on wraps around the end of the period, the device handles it */
+  *on_time = phase_shift % TIME_MAX;
   *off_time = (*on_time + pulse_width) % TIME_MAX;
 }
 
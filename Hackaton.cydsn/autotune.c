@@ -0,0 +1,156 @@
+/* ========================================
+ * autotune.c
+ * ========================================
+ */
+
+#include "autotune.h"
+
+#define AUTOTUNE_PI     (3.14159265f)
+
+static enum autotuneState state = AUTOTUNE_IDLE;
+static enum autotuneRule tuneRule = AUTOTUNE_RULE_PD;
+static AutotuneResult result;
+
+static float amplitude;         // Relay output
+static float output;            // Current relay output
+static uint64_t startTime;
+static uint64_t lastSwitchUp;   // Time of the last -amplitude to +amplitude switch
+static uint8_t cycles;          // Complete oscillation cycles seen
+static float cycleMax;
+static float cycleMin;
+static float periodSum;
+static float amplitudeSum;
+
+static void computeGains(void)
+{
+    float ku = result.ku;
+    float tu = result.tu;
+
+    switch (tuneRule)
+    {
+        case AUTOTUNE_RULE_PID:
+            result.kp = 0.6f * ku;
+            result.ki = 1.2f * ku / tu;
+            result.kd = 0.075f * ku * tu;
+            break;
+        case AUTOTUNE_RULE_NO_OVERSHOOT:
+            result.kp = 0.2f * ku;
+            result.ki = 0.4f * ku / tu;
+            result.kd = 0.0667f * ku * tu;
+            break;
+        case AUTOTUNE_RULE_PD:
+        default:
+            result.kp = 0.8f * ku;
+            result.ki = 0.0f;
+            result.kd = 0.1f * ku * tu;
+            break;
+    }
+}
+
+static void finish(void)
+{
+    float a = amplitudeSum / (float)AUTOTUNE_MEASURE_CYCLES;
+
+    // Oscillation must be clearly larger than the hysteresis band
+    if (a <= AUTOTUNE_HYSTERESIS)
+    {
+        state = AUTOTUNE_FAILED;
+        return;
+    }
+
+    result.tu = periodSum / (float)AUTOTUNE_MEASURE_CYCLES;
+    result.ku = 4.0f * amplitude / (AUTOTUNE_PI * a);
+    computeGains();
+    state = AUTOTUNE_DONE;
+}
+
+void Autotune_Start(float relayAmplitude, enum autotuneRule rule, uint64_t now)
+{
+    amplitude = (relayAmplitude > 0.0f) ? relayAmplitude : AUTOTUNE_RELAY_AMPLITUDE;
+    tuneRule = rule;
+    output = amplitude;
+    startTime = now;
+    lastSwitchUp = now;
+    cycles = 0;
+    cycleMax = 0.0f;
+    cycleMin = 0.0f;
+    periodSum = 0.0f;
+    amplitudeSum = 0.0f;
+    state = AUTOTUNE_RUNNING;
+}
+
+void Autotune_Abort(void)
+{
+    if (state == AUTOTUNE_RUNNING)
+    {
+        state = AUTOTUNE_IDLE;
+    }
+}
+
+enum autotuneState Autotune_GetState(void)
+{
+    return state;
+}
+
+bool Autotune_IsRunning(void)
+{
+    return (state == AUTOTUNE_RUNNING);
+}
+
+float Autotune_Update(float error, uint64_t now)
+{
+    if (state != AUTOTUNE_RUNNING)
+    {
+        return 0.0f;
+    }
+
+    if ((now - startTime) > AUTOTUNE_TIMEOUT_US)
+    {
+        state = AUTOTUNE_FAILED;
+        return 0.0f;
+    }
+
+    if (error > cycleMax)
+    {
+        cycleMax = error;
+    }
+    if (error < cycleMin)
+    {
+        cycleMin = error;
+    }
+
+    if ((output < 0.0f) && (error > AUTOTUNE_HYSTERESIS))
+    {
+        // One full cycle ends when the relay switches up again
+        output = amplitude;
+
+        if (cycles > AUTOTUNE_SETTLE_CYCLES)
+        {
+            periodSum += (float)(now - lastSwitchUp) * 1.0e-6f;
+            amplitudeSum += 0.5f * (cycleMax - cycleMin);
+        }
+        cycles++;
+        lastSwitchUp = now;
+        cycleMax = error;
+        cycleMin = error;
+
+        if (cycles > AUTOTUNE_SETTLE_CYCLES + AUTOTUNE_MEASURE_CYCLES)
+        {
+            finish();
+            return 0.0f;
+        }
+    }
+    else if ((output > 0.0f) && (error < -AUTOTUNE_HYSTERESIS))
+    {
+        output = -amplitude;
+    }
+
+    return output;
+}
+
+const AutotuneResult* Autotune_GetResult(void)
+{
+    return &result;
+}
+
+/* [] END OF FILE */
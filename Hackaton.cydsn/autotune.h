@@ -0,0 +1,70 @@
+#ifndef AUTOTUNE_H
+#define AUTOTUNE_H
+
+#ifdef __cplusplus
+extern "C" {
+#endif
+
+#include <stdint.h>
+#include <stdbool.h>
+
+// Relay feedback auto-tuner (Astrom-Hagglund) for the line PID.
+//
+// While running, steering correction is a relay: +amplitude when the line is
+// right of the hysteresis band, -amplitude when it is left of it. The car then
+// oscillates around the line at the ultimate period Tu. From the relay amplitude d
+// and the error oscillation amplitude a the ultimate gain is
+//   Ku = 4 * d / (pi * a)
+// and PID gains are computed with Ziegler-Nichols style rules. Hysteresis only
+// keeps the relay from chattering on sensor flicker; it adds some phase lag, so
+// choose relay amplitude that makes a several times larger than the hysteresis.
+
+#define AUTOTUNE_RELAY_AMPLITUDE    (500.0f)    // Motor units, keeps the relay out of the pivot-turn regime
+#define AUTOTUNE_HYSTERESIS         (0.25f)     // Position units, rejects sensor pattern flicker
+#define AUTOTUNE_SETTLE_CYCLES      (2u)        // Oscillation cycles ignored at start
+#define AUTOTUNE_MEASURE_CYCLES     (4u)        // Oscillation cycles averaged
+#define AUTOTUNE_TIMEOUT_US         (15000000u)
+
+enum autotuneState
+{
+    AUTOTUNE_IDLE    = 0,
+    AUTOTUNE_RUNNING = 1,
+    AUTOTUNE_DONE    = 2,
+    AUTOTUNE_FAILED  = 3,
+};
+
+enum autotuneRule
+{
+    AUTOTUNE_RULE_PD            = 0,  // Kp = 0.8 Ku, Kd = 0.1 Ku Tu (line PID runs without Ki)
+    AUTOTUNE_RULE_PID           = 1,  // Classic Ziegler-Nichols
+    AUTOTUNE_RULE_NO_OVERSHOOT  = 2,  // Kp = 0.2 Ku, Ki = 0.4 Ku / Tu, Kd = 0.066 Ku Tu
+};
+
+typedef struct
+{
+    float ku;       // Ultimate gain, motor units per position unit
+    float tu;       // Ultimate period, seconds
+    float kp;
+    float ki;
+    float kd;
+} AutotuneResult;
+
+// Start relay experiment. relayAmplitude 0 selects AUTOTUNE_RELAY_AMPLITUDE.
+void Autotune_Start(float relayAmplitude, enum autotuneRule rule, uint64_t now);
+void Autotune_Abort(void);
+
+enum autotuneState Autotune_GetState(void);
+bool Autotune_IsRunning(void);
+
+// Relay output (steering correction) for line error measured at time now.
+// Call every control period while Autotune_IsRunning().
+float Autotune_Update(float error, uint64_t now);
+
+// Valid when state is AUTOTUNE_DONE
+const AutotuneResult* Autotune_GetResult(void);
+
+#ifdef __cplusplus
+}
+#endif
+
+#endif /* AUTOTUNE_H */
@@ -16,13 +16,129 @@
 #define PIN_MOTOR_M3_IN2 13      //Define the negative pole of M3
 #define PIN_MOTOR_M4_IN1 10      //Define the positive pole of M4
 #define PIN_MOTOR_M4_IN2 11      //Define the negative pole of M4
+#define MOTOR_FIRST_CHANNEL 8    //Motor poles take channels 8..15
+#define MOTOR_CHANNEL_COUNT 8
 
 #define SOUND_PWM_CLOCK (1000000u)  // Income clock frequency
 
 /* 8MHz IMO clock with 8000000 reload value to generate 1s interrupt */
 #define SYSTICK_RELOAD_VAL   (8000UL)
 
+/* Microsecond clock: free running 32-bit TCPWM counter, extended to 64 bits by its overflow interrupt */
+#define TIMING_US_HW            TCPWM0
+#define TIMING_US_CNT_NUM       (2UL)
+#define TIMING_US_CNT_MASK      (1UL << TIMING_US_CNT_NUM)
+#define TIMING_US_PCLK          PCLK_TCPWM0_CLOCKS2
+#define TIMING_US_DIV_NUM       (4UL)    // 8-bit divider producing 1 MHz, also feeds Counter_Echo and PWM_Trig
+#define TIMING_US_IRQ           tcpwm_0_interrupts_2_IRQn
+#define TIMING_US_IRQ_PRIORITY  (1UL)
+
+/* Wheel encoders: quadrature decoder counts position, capture counter timestamps phase A edges.
+ * Encoder pins reach TCPWM0 through trigger groups 12 and 2, trigger line n of an
+ * encoder phase is routed to tcpwm[0].tr_in[ENCODER_TR_IN_FIRST + n]. tr_in[0] is used by Counter_Echo. */
+#define ENCODER_HW              TCPWM0
+#define ENCODER_DIV_NUM         TIMING_US_DIV_NUM   // Capture counters measure pulse period in microseconds
+#define ENCODER_TR_IN_FIRST     (1UL)
+#define ENCODER_MIDPOINT        (0x80000000UL)      // Quadrature counter start value, counts both ways from here
+
+#define ODOMETRY_SYSTICK_CALLBACK   (2UL)   // SysTick callback slot, 0 is the millisecond counter, 1 the CM4 scheduler
+
+typedef struct
+{
+    GPIO_PRT_Type* port;
+    uint32_t pin;
+    en_hsiom_sel_t hsiom;
+    uint32_t ioTrigger;     // TRIG12_IN_PERI_TR_IO_INPUTx of the pin
+} encoderPhaseConfig;
+
+typedef struct
+{
+    encoderPhaseConfig phaseA;
+    encoderPhaseConfig phaseB;
+    uint32_t quadDecCntNum;
+    en_clk_dst_t quadDecPclk;
+    uint32_t captureCntNum;
+    en_clk_dst_t capturePclk;
+    int32_t direction;
+} encoderConfig;
+
+// BOARD CONFIG: encoder phase pins.
+// A phase needs a pin with a peri.tr_io_input trigger. On this package only
+// P0.0, P0.1, P5.0, P5.1, P6.4, P6.5, P7.1, P9.0, P9.1, P10.0 and P10.1 have
+// one, and all but P0.0/P0.1 are taken:
+//   P5.0/P5.1 UART_Debug, P6.4 WS2812, P7.1 LEDG, P9.0/P9.1 I2C_Main, P10.0 IR_rx,
+//   P10.1 LED strip data and battery divider net, P6.5 KitProg I2C SDA (SDA_KP).
+// The left encoder wiring is not known, so its phases are placeholders (port
+// NULL). Encoders stay off until every phase is set here: Encoder_IsAvailable()
+// is false, counts read 0, and the wheel speed loop, calibration and track map
+// are not used.
+static const encoderConfig encoders[ENCODER_COUNT] =
+{
+    [ENCODER_LEFT] =
+    {
+        .phaseA = { NULL, 0UL, HSIOM_SEL_GPIO, 0UL },     // Placeholder, see above
+        .phaseB = { NULL, 0UL, HSIOM_SEL_GPIO, 0UL },     // Placeholder, see above
+        .quadDecCntNum = 3UL,
+        .quadDecPclk = PCLK_TCPWM0_CLOCKS3,
+        .captureCntNum = 4UL,
+        .capturePclk = PCLK_TCPWM0_CLOCKS4,
+        .direction = ENCODER_LEFT_DIRECTION,
+    },
+    [ENCODER_RIGHT] =
+    {
+        .phaseA = { GPIO_PRT0, 0UL, P0_0_PERI_TR_IO_INPUT0, TRIG12_IN_PERI_TR_IO_INPUT0 },
+        .phaseB = { GPIO_PRT0, 1UL, P0_1_PERI_TR_IO_INPUT1, TRIG12_IN_PERI_TR_IO_INPUT1 },
+        .quadDecCntNum = 5UL,
+        .quadDecPclk = PCLK_TCPWM0_CLOCKS5,
+        .captureCntNum = 6UL,
+        .capturePclk = PCLK_TCPWM0_CLOCKS6,
+        .direction = ENCODER_RIGHT_DIRECTION,
+    },
+};
+
 static volatile uint32_t milliseconds = 0;
+static volatile uint32_t microsecondsHigh = 0;
+
+static Motor_Linearization motorLinearization = NULL;
+static float motorScale = 1.0f;
+static volatile bool motorsLocked = false;
+
+static float batteryVoltage = 0.0f;
+static bool batteryValid = false;
+static uint64_t batterySampleTime = 0u;
+
+// Pose integrated in the SysTick interrupt
+static DeadReckoning odometry;
+static int32_t odometryLastCount[ENCODER_COUNT];
+
+static const cy_stc_tcpwm_counter_config_t microsecondCounterConfig =
+{
+    .period = 0xFFFFFFFFUL,
+    .clockPrescaler = CY_TCPWM_COUNTER_PRESCALER_DIVBY_1,
+    .runMode = CY_TCPWM_COUNTER_CONTINUOUS,
+    .countDirection = CY_TCPWM_COUNTER_COUNT_UP,
+    .compareOrCapture = CY_TCPWM_COUNTER_MODE_COMPARE,
+    .compare0 = 0UL,
+    .compare1 = 0UL,
+    .enableCompareSwap = false,
+    .interruptSources = CY_TCPWM_INT_ON_TC,
+    .captureInputMode = CY_TCPWM_INPUT_RISINGEDGE,
+    .captureInput = CY_TCPWM_INPUT_0,
+    .reloadInputMode = CY_TCPWM_INPUT_RISINGEDGE,
+    .reloadInput = CY_TCPWM_INPUT_0,
+    .startInputMode = CY_TCPWM_INPUT_RISINGEDGE,
+    .startInput = CY_TCPWM_INPUT_0,
+    .stopInputMode = CY_TCPWM_INPUT_RISINGEDGE,
+    .stopInput = CY_TCPWM_INPUT_0,
+    .countInputMode = CY_TCPWM_INPUT_LEVEL,
+    .countInput = CY_TCPWM_INPUT_1,
+};
+
+static const cy_stc_sysint_t microsecondIrqConfig =
+{
+    .intrSrc = TIMING_US_IRQ,
+    .intrPriority = TIMING_US_IRQ_PRIORITY,
+};
 
 ///////////////////// MOTORS API //////////////////////////////////////////////
 
@@ -31,46 +147,113 @@ void Motor_Init(void)
 {
   PCA9685_Init();
   PCA9685_setToFrequency(SERVO_FREQUENCY);
+  //Motors switch on at different ticks of the period, their inrush currents do not add up
+  PCA9685_staggerPhases(MOTOR_FIRST_CHANNEL, MOTOR_CHANNEL_COUNT);
+  //PWM outputs survive an MCU reset (watchdog), start with motors stopped
+  PCA9685_allOff();
 }
 
 //Function to control the car motors
 void Motor_Move(int m1_speed, int m2_speed, int m3_speed, int m4_speed) {
+  if (motorLinearization != NULL) {
+    m1_speed = motorLinearization(MOTOR_LEFT_FRONT, constrain_int(m1_speed, MOTOR_SPEED_MIN, MOTOR_SPEED_MAX));
+    m2_speed = motorLinearization(MOTOR_LEFT_REAR, constrain_int(m2_speed, MOTOR_SPEED_MIN, MOTOR_SPEED_MAX));
+    m3_speed = motorLinearization(MOTOR_RIGHT_FRONT, constrain_int(m3_speed, MOTOR_SPEED_MIN, MOTOR_SPEED_MAX));
+    m4_speed = motorLinearization(MOTOR_RIGHT_REAR, constrain_int(m4_speed, MOTOR_SPEED_MIN, MOTOR_SPEED_MAX));
+  }
+  if (motorScale != 1.0f) {
+    m1_speed = (int)((float)m1_speed * motorScale);
+    m2_speed = (int)((float)m2_speed * motorScale);
+    m3_speed = (int)((float)m3_speed * motorScale);
+    m4_speed = (int)((float)m4_speed * motorScale);
+  }
+  Motor_MoveRaw(m1_speed, m2_speed, m3_speed, m4_speed);
+}
+
+//Motor linearization (calibration table), NULL drives PCA9685 duty directly
+void Motor_SetLinearization(Motor_Linearization linearization) {
+  motorLinearization = linearization;
+}
+
+//Duty multiplier, keeps motor authority constant while the battery discharges
+void Motor_SetScale(float scale) {
+  motorScale = scale;
+}
+
+//Stop path independent of the interrupt driven I2C driver, safe from an interrupt
+void Motor_EmergencyStop(void) {
+  motorsLocked = true;
+  PCA9685_emergencyOff();
+}
+
+void Motor_Unlock(void) {
+  motorsLocked = false;
+}
+
+bool Motor_IsLocked(void) {
+  return motorsLocked;
+}
+
+void Motor_GetBusTime(uint32_t* lastUs, uint32_t* maxUs) {
+  PCA9685_getBurstBusTime(lastUs, maxUs);
+}
+
+//Stage the duty of one H-bridge, the other input stays low
+static void stageBridge(Channel in1, Channel in2, int speed) {
+  if (speed >= 0) {
+    PCA9685_stageChannelPulseWidth(in1, speed);
+    PCA9685_stageChannelPulseWidth(in2, 0);
+  } else {
+    PCA9685_stageChannelPulseWidth(in1, 0);
+    PCA9685_stageChannelPulseWidth(in2, -speed);
+  }
+}
+
+//Function to control the car motors with PCA9685 duty
+void Motor_MoveRaw(int m1_speed, int m2_speed, int m3_speed, int m4_speed) {
+  if (motorsLocked) {
+    return;
+  }
+
   m1_speed = MOTOR_1_DIRECTION * constrain_int(m1_speed, MOTOR_SPEED_MIN, MOTOR_SPEED_MAX);
   m2_speed = MOTOR_2_DIRECTION * constrain_int(m2_speed, MOTOR_SPEED_MIN, MOTOR_SPEED_MAX);
   m3_speed = MOTOR_3_DIRECTION * constrain_int(m3_speed, MOTOR_SPEED_MIN, MOTOR_SPEED_MAX);
   m4_speed = MOTOR_4_DIRECTION * constrain_int(m4_speed, MOTOR_SPEED_MIN, MOTOR_SPEED_MAX);
 
-  if (m1_speed >= 0) {
-    PCA9685_setChannelPulseWidth(PIN_MOTOR_M1_IN1, m1_speed);
-    PCA9685_setChannelPulseWidth(PIN_MOTOR_M1_IN2, 0);
-  } else {
-    m1_speed = -m1_speed;
-    PCA9685_setChannelPulseWidth(PIN_MOTOR_M1_IN1, 0);
-    PCA9685_setChannelPulseWidth(PIN_MOTOR_M1_IN2, m1_speed);
+  stageBridge(PIN_MOTOR_M1_IN1, PIN_MOTOR_M1_IN2, m1_speed);
+  stageBridge(PIN_MOTOR_M2_IN1, PIN_MOTOR_M2_IN2, m2_speed);
+  stageBridge(PIN_MOTOR_M3_IN1, PIN_MOTOR_M3_IN2, m3_speed);
+  stageBridge(PIN_MOTOR_M4_IN1, PIN_MOTOR_M4_IN2, m4_speed);
+
+  //Changed motor channels in one auto-increment transaction, all outputs latch at its STOP
+  PCA9685_commit();
+
+  //Emergency stop came in the middle of the update and the commit queued after it runs the motors again
+  if (motorsLocked) {
+    PCA9685_allOff();
   }
-  if (m2_speed >= 0) {
-    PCA9685_setChannelPulseWidth(PIN_MOTOR_M2_IN1, m2_speed);
-    PCA9685_setChannelPulseWidth(PIN_MOTOR_M2_IN2, 0);
-  } else {
-    m2_speed = -m2_speed;
-    PCA9685_setChannelPulseWidth(PIN_MOTOR_M2_IN1, 0);
-    PCA9685_setChannelPulseWidth(PIN_MOTOR_M2_IN2, m2_speed);
+}
+
+//Both inputs of every H-bridge full on: the bridges short the motors (brake),
+//where both low (Motor_Move() with 0) lets them coast
+void Motor_Brake(void) {
+  if (motorsLocked) {
+    return;
   }
-  if (m3_speed >= 0) {
-    PCA9685_setChannelPulseWidth(PIN_MOTOR_M3_IN1, m3_speed);
-    PCA9685_setChannelPulseWidth(PIN_MOTOR_M3_IN2, 0);
-  } else {
-    m3_speed = -m3_speed;
-    PCA9685_setChannelPulseWidth(PIN_MOTOR_M3_IN1, 0);
-    PCA9685_setChannelPulseWidth(PIN_MOTOR_M3_IN2, m3_speed);
+
+  static const Channel inputs[] = {
+    PIN_MOTOR_M1_IN1, PIN_MOTOR_M1_IN2, PIN_MOTOR_M2_IN1, PIN_MOTOR_M2_IN2,
+    PIN_MOTOR_M3_IN1, PIN_MOTOR_M3_IN2, PIN_MOTOR_M4_IN1, PIN_MOTOR_M4_IN2
+  };
+  for (uint8_t input_n = 0; input_n < sizeof(inputs) / sizeof(inputs[0]); ++input_n) {
+    PCA9685_stageChannelPulseWidth(inputs[input_n], PCA9685_PULSE_WIDTH_MAX);
   }
-  if (m4_speed >= 0) {
-    PCA9685_setChannelPulseWidth(PIN_MOTOR_M4_IN1, m4_speed);
-    PCA9685_setChannelPulseWidth(PIN_MOTOR_M4_IN2, 0);
-  } else {
-    m4_speed = -m4_speed;
-    PCA9685_setChannelPulseWidth(PIN_MOTOR_M4_IN1, 0);
-    PCA9685_setChannelPulseWidth(PIN_MOTOR_M4_IN2, m4_speed);
+  //Nothing goes on the bus while the brake is already applied
+  PCA9685_commit();
+
+  //Emergency stop came in the middle of the update
+  if (motorsLocked) {
+    PCA9685_allOff();
   }
 }
 
@@ -133,12 +316,152 @@ uint8_t Read_Sensor(uint8_t sensor_number)
   return !!(Track_Read() & (1 << (sensor_number)));
 }
 
+///////////////////// ENCODER API /////////////////////////////////////////////
+
+// Connect encoder pin to TCPWM0 trigger input, returns counter input selection for it
+static uint32_t encoder_route_phase(const encoderPhaseConfig* phase, uint32_t line)
+{
+    Cy_GPIO_Pin_FastInit(phase->port, phase->pin, CY_GPIO_DM_PULLUP, 1UL, phase->hsiom);
+    (void)Cy_TrigMux_Connect(phase->ioTrigger, TRIG12_OUT_TR_GROUP2_INPUT25 + line,
+                             CY_TR_MUX_TR_INV_DISABLE, TRIGGER_TYPE_LEVEL);
+    (void)Cy_TrigMux_Connect(TRIG2_IN_TR_GROUP12_OUTPUT0 + line, TRIG2_OUT_TCPWM0_TR_IN0 + ENCODER_TR_IN_FIRST + line,
+                             CY_TR_MUX_TR_INV_DISABLE, TRIGGER_TYPE_LEVEL);
+    return CY_TCPWM_INPUT_TRIG_0 + ENCODER_TR_IN_FIRST + line;
+}
+
+bool Encoder_IsAvailable(void)
+{
+    for (uint32_t encoder_n = 0; encoder_n < ENCODER_COUNT; encoder_n++)
+    {
+        if ((encoders[encoder_n].phaseA.port == NULL) || (encoders[encoder_n].phaseB.port == NULL))
+        {
+            return false;
+        }
+    }
+    return true;
+}
+
+void Encoder_Init(void)
+{
+    // Never drive or pull pins that are not configured for the encoders
+    if (!Encoder_IsAvailable())
+    {
+        return;
+    }
+
+    for (uint32_t encoder_n = 0; encoder_n < ENCODER_COUNT; encoder_n++)
+    {
+        const encoderConfig* encoder = &encoders[encoder_n];
+        uint32_t phaseAInput = encoder_route_phase(&encoder->phaseA, 2UL * encoder_n);
+        uint32_t phaseBInput = encoder_route_phase(&encoder->phaseB, 2UL * encoder_n + 1UL);
+
+        cy_stc_tcpwm_quaddec_config_t quadDecConfig =
+        {
+            .resolution = CY_TCPWM_QUADDEC_X4,
+            .interruptSources = CY_TCPWM_INT_NONE,
+            .indexInputMode = CY_TCPWM_INPUT_RISINGEDGE,
+            .indexInput = CY_TCPWM_INPUT_0,
+            .stopInputMode = CY_TCPWM_INPUT_RISINGEDGE,
+            .stopInput = CY_TCPWM_INPUT_0,
+            .phiAInput = phaseAInput,
+            .phiBInput = phaseBInput,
+        };
+
+        // Free running 1 MHz counter, phase A rising edge copies it to capture (previous capture goes to buffer)
+        cy_stc_tcpwm_counter_config_t captureConfig =
+        {
+            .period = 0xFFFFFFFFUL,
+            .clockPrescaler = CY_TCPWM_COUNTER_PRESCALER_DIVBY_1,
+            .runMode = CY_TCPWM_COUNTER_CONTINUOUS,
+            .countDirection = CY_TCPWM_COUNTER_COUNT_UP,
+            .compareOrCapture = CY_TCPWM_COUNTER_MODE_CAPTURE,
+            .compare0 = 0UL,
+            .compare1 = 0UL,
+            .enableCompareSwap = false,
+            .interruptSources = CY_TCPWM_INT_NONE,
+            .captureInputMode = CY_TCPWM_INPUT_RISINGEDGE,
+            .captureInput = phaseAInput,
+            .reloadInputMode = CY_TCPWM_INPUT_RISINGEDGE,
+            .reloadInput = CY_TCPWM_INPUT_0,
+            .startInputMode = CY_TCPWM_INPUT_RISINGEDGE,
+            .startInput = CY_TCPWM_INPUT_0,
+            .stopInputMode = CY_TCPWM_INPUT_RISINGEDGE,
+            .stopInput = CY_TCPWM_INPUT_0,
+            .countInputMode = CY_TCPWM_INPUT_LEVEL,
+            .countInput = CY_TCPWM_INPUT_1,
+        };
+
+        Cy_SysClk_PeriphAssignDivider(encoder->quadDecPclk, CY_SYSCLK_DIV_8_BIT, ENCODER_DIV_NUM);
+        Cy_SysClk_PeriphAssignDivider(encoder->capturePclk, CY_SYSCLK_DIV_8_BIT, ENCODER_DIV_NUM);
+
+        (void)Cy_TCPWM_QuadDec_Init(ENCODER_HW, encoder->quadDecCntNum, &quadDecConfig);
+        Cy_TCPWM_Counter_SetPeriod(ENCODER_HW, encoder->quadDecCntNum, 0xFFFFFFFFUL);
+        Cy_TCPWM_QuadDec_SetCounter(ENCODER_HW, encoder->quadDecCntNum, ENCODER_MIDPOINT);
+        (void)Cy_TCPWM_Counter_Init(ENCODER_HW, encoder->captureCntNum, &captureConfig);
+
+        Cy_TCPWM_Enable_Multiple(ENCODER_HW, (1UL << encoder->quadDecCntNum) | (1UL << encoder->captureCntNum));
+        Cy_TCPWM_TriggerReloadOrIndex(ENCODER_HW, 1UL << encoder->quadDecCntNum);
+        Cy_TCPWM_TriggerStart(ENCODER_HW, 1UL << encoder->captureCntNum);
+    }
+}
+
+int32_t Encoder_GetCount(uint8_t encoder)
+{
+    if ((encoder >= ENCODER_COUNT) || !Encoder_IsAvailable())
+    {
+        return 0;
+    }
+    uint32_t counter = Cy_TCPWM_QuadDec_GetCounter(ENCODER_HW, encoders[encoder].quadDecCntNum);
+    return encoders[encoder].direction * (int32_t)(counter - ENCODER_MIDPOINT);
+}
+
+uint32_t Encoder_GetPulsePeriod(uint8_t encoder)
+{
+    if ((encoder >= ENCODER_COUNT) || !Encoder_IsAvailable())
+    {
+        return 0UL;
+    }
+    uint32_t cntNum = encoders[encoder].captureCntNum;
+    uint32_t capture;
+    uint32_t previous;
+
+    // An edge between the two reads moves capture to buffer, read again then
+    do
+    {
+        capture = Cy_TCPWM_Counter_GetCapture(ENCODER_HW, cntNum);
+        previous = Cy_TCPWM_Counter_GetCaptureBuf(ENCODER_HW, cntNum);
+    } while (capture != Cy_TCPWM_Counter_GetCapture(ENCODER_HW, cntNum));
+
+    // No edges captured yet
+    if (previous == 0UL)
+    {
+        return 0UL;
+    }
+    return capture - previous;
+}
+
+uint32_t Encoder_GetTimeSinceEdge(uint8_t encoder)
+{
+    if ((encoder >= ENCODER_COUNT) || !Encoder_IsAvailable())
+    {
+        return 0xFFFFFFFFUL;
+    }
+    uint32_t cntNum = encoders[encoder].captureCntNum;
+    return Cy_TCPWM_Counter_GetCounter(ENCODER_HW, cntNum) - Cy_TCPWM_Counter_GetCapture(ENCODER_HW, cntNum);
+}
+
 ///////////////////// TIMING API //////////////////////////////////////////////
 static void systick_handler(void)
 {
     milliseconds++;
 }
 
+static void microsecond_overflow_handler(void)
+{
+    Cy_TCPWM_ClearInterrupt(TIMING_US_HW, TIMING_US_CNT_NUM, CY_TCPWM_INT_ON_TC);
+    microsecondsHigh++;
+}
+
 void Timing_Init(void)
 {
     /* Enable Systick and the Systick interrupt */
@@ -149,9 +472,149 @@ void Timing_Init(void)
 
     /* Set Systick interrupt callback */
     Cy_SysTick_SetCallback(0, systick_handler);
+
+    /* Clock the microsecond counter from the existing 1 MHz divider and start it */
+    Cy_SysClk_PeriphAssignDivider(TIMING_US_PCLK, CY_SYSCLK_DIV_8_BIT, TIMING_US_DIV_NUM);
+    (void)Cy_TCPWM_Counter_Init(TIMING_US_HW, TIMING_US_CNT_NUM, &microsecondCounterConfig);
+    Cy_SysInt_Init(&microsecondIrqConfig, microsecond_overflow_handler);
+    NVIC_EnableIRQ(TIMING_US_IRQ);
+    Cy_TCPWM_Enable_Multiple(TIMING_US_HW, TIMING_US_CNT_MASK);
+    Cy_TCPWM_TriggerStart(TIMING_US_HW, TIMING_US_CNT_MASK);
 }
 
 uint32_t Timing_GetMillisecongs(void)
 {
    return milliseconds;   
+}
+
+uint64_t Timing_GetMicroseconds(void)
+{
+    uint32_t high;
+    uint32_t low;
+    uint32_t overflowPending;
+
+    // Retry if the overflow interrupt ran between reading the two halves
+    do
+    {
+        high = microsecondsHigh;
+        low = Cy_TCPWM_Counter_GetCounter(TIMING_US_HW, TIMING_US_CNT_NUM);
+        overflowPending = Cy_TCPWM_GetInterruptStatus(TIMING_US_HW, TIMING_US_CNT_NUM) & CY_TCPWM_INT_ON_TC;
+    } while (high != microsecondsHigh);
+
+    // Called with the overflow interrupt blocked (higher priority ISR or interrupts disabled):
+    // the counter already wrapped but the high word was not incremented yet
+    if ((overflowPending != 0UL) && (low < 0x80000000UL))
+    {
+        high++;
+    }
+
+    return ((uint64_t)high << 32) | low;
+}
+
+///////////////////// ODOMETRY API ////////////////////////////////////////////
+static void odometry_handler(void)
+{
+    int32_t left = Encoder_GetCount(ENCODER_LEFT);
+    int32_t right = Encoder_GetCount(ENCODER_RIGHT);
+    float leftTravel = (float)(left - odometryLastCount[ENCODER_LEFT]) * (1.0f / ODOMETRY_COUNTS_PER_METER);
+    float rightTravel = (float)(right - odometryLastCount[ENCODER_RIGHT]) * (1.0f / ODOMETRY_COUNTS_PER_METER);
+    odometryLastCount[ENCODER_LEFT] = left;
+    odometryLastCount[ENCODER_RIGHT] = right;
+
+    DeadReckoning_Step(&odometry, leftTravel, rightTravel, ODOMETRY_TRACK_WIDTH);
+}
+
+void Odometry_Init(void)
+{
+    Odometry_Reset(0.0f, 0.0f, 0.0f);
+    Cy_SysTick_SetCallback(ODOMETRY_SYSTICK_CALLBACK, odometry_handler);
+}
+
+void Odometry_Reset(float x, float y, float heading)
+{
+    uint32_t interruptState = Cy_SysLib_EnterCriticalSection();
+
+    DeadReckoning_Reset(&odometry, x, y, heading);
+    for (uint8_t encoder_n = 0; encoder_n < ENCODER_COUNT; encoder_n++)
+    {
+        odometryLastCount[encoder_n] = Encoder_GetCount(encoder_n);
+    }
+
+    Cy_SysLib_ExitCriticalSection(interruptState);
+}
+
+void Odometry_GetPose(Odometry_Pose* pose)
+{
+    uint32_t interruptState = Cy_SysLib_EnterCriticalSection();
+    *pose = odometry.pose;
+    Cy_SysLib_ExitCriticalSection(interruptState);
+}
+
+float Odometry_GetDistance(void)
+{
+    // Single aligned word, read atomically
+    return odometry.pose.distance;
+}
+
+///////////////////// BATTERY API /////////////////////////////////////////////
+void Battery_Init(void)
+{
+    batteryVoltage = 0.0f;
+    batteryValid = false;
+    ADC_Start();
+}
+
+// The divider shares its wire with the WS2812 data line (SPI MOSI, P6.4). MOSI
+// drives the wire even when idle, so it is released for the single conversion
+// and handed back to the SCB afterwards. Call only while no LED data is shifted.
+void Battery_Update(uint64_t now)
+{
+    Cy_GPIO_SetHSIOM(WS2812_PORT, WS2812_NUM, HSIOM_SEL_GPIO);
+    Cy_GPIO_SetDrivemode(WS2812_PORT, WS2812_NUM, CY_GPIO_DM_HIGHZ);
+    Cy_SysLib_DelayUs(BATTERY_SETTLE_US);
+
+    ADC_StartConvert();
+    (void)ADC_IsEndConversion(CY_SAR_WAIT_FOR_RESULT);
+
+    Cy_GPIO_SetDrivemode(WS2812_PORT, WS2812_NUM, WS2812_DRIVEMODE);
+    Cy_GPIO_SetHSIOM(WS2812_PORT, WS2812_NUM, (en_hsiom_sel_t)WS2812_INIT_MUXSEL);
+
+    int16_t millivolts = ADC_CountsTo_mVolts(0u, ADC_GetResult16(0u));
+    float voltage = (float)millivolts * 0.001f * BATTERY_DIVIDER_RATIO;
+
+    if ((voltage < BATTERY_MIN_VOLTAGE) || (voltage > BATTERY_MAX_VOLTAGE))
+    {
+        return;
+    }
+
+    // First sample after a gap is taken as is, motor load makes single samples noisy
+    if (!batteryValid || Battery_IsStale(now))
+    {
+        batteryVoltage = voltage;
+    }
+    else
+    {
+        batteryVoltage += BATTERY_FILTER_ALPHA * (voltage - batteryVoltage);
+    }
+    batteryValid = true;
+    batterySampleTime = now;
+}
+
+bool Battery_IsStale(uint64_t now)
+{
+    return !batteryValid || ((now - batterySampleTime) > BATTERY_STALE_US);
+}
+
+float Battery_GetVoltage(void)
+{
+    return batteryVoltage;
+}
+
+float Battery_GetMotorScale(uint64_t now)
+{
+    if (Battery_IsStale(now))
+    {
+        return 1.0f;
+    }
+    return BATTERY_NOMINAL_VOLTAGE / batteryVoltage;
 }
\ No newline at end of file
@@ -5,8 +5,10 @@
 extern "C" {
 #endif
     
+#include <stdbool.h>
 #include <PCA9685.h>
 #include <PCF8574.h>
+#include "dead_reckoning.h"
 
 #define MOTOR_1_DIRECTION     1 //If the direction is reversed, change 1 to -1
 #define MOTOR_2_DIRECTION     1 //If the direction is reversed, change 1 to -1
@@ -16,8 +18,25 @@ extern "C" {
 void PCA9685_Close_Com_Address(void);//Close the PCA9685 public address
 
 ///////////////////// MOTORS & SERVO API //////////////////////////////////////
+#define MOTOR_LEFT_FRONT          0u  //m1
+#define MOTOR_LEFT_REAR           1u  //m2
+#define MOTOR_RIGHT_FRONT         2u  //m3
+#define MOTOR_RIGHT_REAR          3u  //m4
+#define MOTOR_COUNT               4u
+
+//Maps commanded speed of a motor (-4095..4095) to PCA9685 duty with the same sign
+typedef int (*Motor_Linearization)(uint8_t motor, int speed);
+
 void Motor_Init(void);                //servo initialization
 void Motor_Move(int m1_speed, int m2_speed, int m3_speed, int m4_speed);//A function to control the car motor
+void Motor_MoveRaw(int m1_speed, int m2_speed, int m3_speed, int m4_speed);//Same without linearization, duty goes to PCA9685 as given
+void Motor_SetLinearization(Motor_Linearization linearization);           //Applied by Motor_Move(), NULL = none
+void Motor_SetScale(float scale);     //Duty multiplier applied by Motor_Move() after linearization (battery feed-forward), 1 = none
+void Motor_Brake(void);               //Short all motors (both H-bridge inputs full on) until the next Motor_Move()
+void Motor_EmergencyStop(void);       //All motors off from any context, also an interrupt; commands are ignored until Motor_Unlock()
+void Motor_Unlock(void);
+bool Motor_IsLocked(void);
+void Motor_GetBusTime(uint32_t* lastUs, uint32_t* maxUs); //I2C time of the last and the longest motor update, microseconds
 
 ///////////////////// SOUND API ///////////////////////////////////////////////
 void Sound_Init(void);
@@ -29,9 +48,50 @@ void Track_Init(void);
 uint8_t Track_Read(void);
 uint8_t Read_Sensor(uint8_t sensor_number);
 
+///////////////////// ENCODER API /////////////////////////////////////////////
+#define ENCODER_LEFT              0u
+#define ENCODER_RIGHT             1u
+#define ENCODER_COUNT             2u
+#define ENCODER_LEFT_DIRECTION    1  //If the count is reversed, change 1 to -1
+#define ENCODER_RIGHT_DIRECTION   1  //If the count is reversed, change 1 to -1
+#define ENCODER_COUNTS_PER_PULSE  4u //X4 decoding: counts per phase A period
+
+void Encoder_Init(void);                            //Does nothing while Encoder_IsAvailable() is false
+bool Encoder_IsAvailable(void);                     //All encoder phase pins are set in the board config of car.c
+int32_t Encoder_GetCount(uint8_t encoder);          //Quadrature counts since Encoder_Init(), positive = forward
+uint32_t Encoder_GetPulsePeriod(uint8_t encoder);   //Microseconds between the last two phase A rising edges, 0 if unknown
+uint32_t Encoder_GetTimeSinceEdge(uint8_t encoder); //Microseconds since the last phase A rising edge
+
 ///////////////////// TIMING API //////////////////////////////////////////////
 void Timing_Init(void);
 uint32_t Timing_GetMillisecongs(void);
+uint64_t Timing_GetMicroseconds(void);  //Monotonic, safe to call from thread and interrupt context
+
+///////////////////// ODOMETRY API ////////////////////////////////////////////
+#define ODOMETRY_COUNTS_PER_METER (4000.0f) //Encoder counts per metre of wheel travel, calibrate by driving a known distance
+#define ODOMETRY_TRACK_WIDTH      (0.19f)   //Effective track width in metres, wider than the wheels on skid-steer; calibrate by turning in place
+
+// Odometry_Pose is declared in dead_reckoning.h
+
+void Odometry_Init(void);               //Integrate pose from encoders every SysTick (1 kHz), call after Timing_Init() and Encoder_Init()
+void Odometry_Reset(float x, float y, float heading);
+void Odometry_GetPose(Odometry_Pose* pose);
+float Odometry_GetDistance(void);
+
+///////////////////// BATTERY API /////////////////////////////////////////////
+#define BATTERY_DIVIDER_RATIO     (4.0f)    //Pack voltage / ADC pin (A1, P10[1]) voltage, set to the divider on the board
+#define BATTERY_NOMINAL_VOLTAGE   (7.4f)    //Motor commands are scaled to act as they do at this voltage
+#define BATTERY_MIN_VOLTAGE       (5.0f)    //Readings outside the range are rejected (divider or wiring fault)
+#define BATTERY_MAX_VOLTAGE       (9.0f)
+#define BATTERY_FILTER_ALPHA      (0.15f)   //Weight of a new sample in the low-pass filter, ~0.2 s at the ~30 Hz LED refresh
+#define BATTERY_STALE_US          (500000u) //Voltage is unknown when no valid sample came for this long
+#define BATTERY_SETTLE_US         (10u)     //Divider settling after WS2812 MOSI is released, before the conversion
+
+void Battery_Init(void);                    //Start the ADC
+void Battery_Update(uint64_t now);          //Release MOSI, convert one sample and filter it (blocks ~30 us), call while the LED strip is idle
+bool Battery_IsStale(uint64_t now);
+float Battery_GetVoltage(void);             //Filtered pack voltage in volts, 0 before the first valid sample
+float Battery_GetMotorScale(uint64_t now);  //Nominal / filtered voltage, 1 while stale
 
 #ifdef __cplusplus
 }
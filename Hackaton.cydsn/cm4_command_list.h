@@ -20,7 +20,16 @@ enum cm4CommandList
     CM4_COMMAND_START_CAR = 0x01,
     CM4_COMMAND_STOP_CAR = 0x02,
     CM4_COMMAND_ECHO = 0x03,
-    CM4_COMMAND_END = CM4_COMMAND_ECHO,
+    CM4_COMMAND_AUTOTUNE = 0x04,    // [1..2] relay amplitude (int16, 0 = default), [3] rule (enum autotuneRule)
+    CM4_COMMAND_CALIBRATE = 0x05,   // Motor characterization sweep, car on a stand with wheels off the ground
+    CM4_COMMAND_SYSID = 0x06,       // [1] enum cm4SysidRequest, then its arguments
+    CM4_COMMAND_END = CM4_COMMAND_SYSID,
+};
+
+enum cm4SysidRequest
+{
+    CM4_SYSID_START = 0x00,         // [2] enum sysidSignal, [3..4] excitation amplitude (int16, 0 = default)
+    CM4_SYSID_DOWNLOAD = 0x01,      // [2..3] first sample, [4..5] sample count (0 = up to the last one)
 };
 
 #endif /* CM4_COMMAND_LIST_H */
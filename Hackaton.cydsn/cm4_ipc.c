@@ -13,7 +13,7 @@
 #include "project.h"
 #include "ipc_def.h"
 
-static bool isCM0Ready = true;
+static volatile bool isCM0Ready = true;
 static bool isDataAvailableFromCM0 = false;
 
 static ipc_msg_t ipcMsgFromCM0_Local;
@@ -66,6 +66,8 @@ ipc_msg_t* CM4_GetCM0Message(void)
 bool CM4_SendCM0Message(ipc_msg_t* msg)
 {
     bool ret = true;
+    // CM0 is busy until it releases this message (see CM4_ReleaseCallback)
+    isCM0Ready = false;
     /* Send the string message to CM0 */
     // For the sake of simplicity, we won't record exact error.
     // Inversion is needed so retuned 0 error will be actually converted to true
@@ -73,6 +75,11 @@ bool CM4_SendCM0Message(ipc_msg_t* msg)
                                          CY_IPC_EP_CYPIPE_CM4_ADDR,
                                          (void *)msg,
                                          CM4_ReleaseCallback);
+    if (!ret)
+    {
+        // Message was not sent, so no release callback will come
+        isCM0Ready = true;
+    }
     return ret;
 }
 
@@ -0,0 +1,139 @@
+/* ========================================
+ * controller.c
+ * ========================================
+ */
+
+#include "controller.h"
+#include <stddef.h>
+
+static const Controller* controllers[CONTROLLER_MAX_COUNT];
+static ControllerCost costs[CONTROLLER_MAX_COUNT];
+static uint8_t controllerCount = 0;
+static uint8_t active = CONTROLLER_INVALID;
+
+static Controller_CounterFunction counterSource = NULL;
+
+static uint32_t readCounter(void)
+{
+    return (counterSource != NULL) ? counterSource() : 0u;
+}
+
+void Controller_Init(Controller_CounterFunction counter)
+{
+    counterSource = counter;
+    controllerCount = 0;
+    active = CONTROLLER_INVALID;
+    Controller_ResetCost();
+}
+
+uint8_t Controller_Register(const Controller* controller)
+{
+    if ((controllerCount >= CONTROLLER_MAX_COUNT) || (controller == NULL) || (controller->update == NULL))
+    {
+        return CONTROLLER_INVALID;
+    }
+
+    if (controller->init != NULL)
+    {
+        controller->init(controller->context);
+    }
+
+    controllers[controllerCount] = controller;
+    costs[controllerCount] = (ControllerCost){0};
+    if (active == CONTROLLER_INVALID)
+    {
+        active = controllerCount;
+    }
+
+    return controllerCount++;
+}
+
+bool Controller_Select(uint8_t id, uint64_t now)
+{
+    if (id >= controllerCount)
+    {
+        return false;
+    }
+
+    active = id;
+    Controller_Reset(now);
+    return true;
+}
+
+uint8_t Controller_GetActive(void)
+{
+    return active;
+}
+
+void Controller_Reset(uint64_t now)
+{
+    if (active == CONTROLLER_INVALID)
+    {
+        return;
+    }
+
+    const Controller* controller = controllers[active];
+    if (controller->reset != NULL)
+    {
+        controller->reset(controller->context, now);
+    }
+}
+
+float Controller_Update(const ControllerInput* input)
+{
+    if (active == CONTROLLER_INVALID)
+    {
+        return 0.0f;
+    }
+
+    const Controller* controller = controllers[active];
+    ControllerCost* cost = &costs[active];
+
+    uint32_t start = readCounter();
+    float correction = controller->update(controller->context, input);
+    uint32_t end = readCounter();
+
+    cost->runs++;
+    cost->lastCycles = end - start;
+    cost->totalCycles += cost->lastCycles;
+    if (cost->lastCycles > cost->maxCycles)
+    {
+        cost->maxCycles = cost->lastCycles;
+    }
+
+    return correction;
+}
+
+const char* Controller_GetName(uint8_t id)
+{
+    return (id < controllerCount) ? controllers[id]->name : NULL;
+}
+
+uint8_t Controller_GetCount(void)
+{
+    return controllerCount;
+}
+
+const ControllerCost* Controller_GetCost(uint8_t id)
+{
+    return (id < controllerCount) ? &costs[id] : NULL;
+}
+
+uint32_t Controller_GetMeanCycles(uint8_t id)
+{
+    if ((id >= controllerCount) || (costs[id].runs == 0u))
+    {
+        return 0u;
+    }
+    return (uint32_t)(costs[id].totalCycles / costs[id].runs);
+}
+
+void Controller_ResetCost(void)
+{
+    for (uint8_t i = 0; i < CONTROLLER_MAX_COUNT; i++)
+    {
+        costs[i] = (ControllerCost){0};
+    }
+}
+
+/* [] END OF FILE */
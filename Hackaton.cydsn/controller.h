@@ -0,0 +1,84 @@
+#ifndef CONTROLLER_H
+#define CONTROLLER_H
+
+#ifdef __cplusplus
+extern "C" {
+#endif
+
+#include <stdint.h>
+#include <stdbool.h>
+
+// Steering controller interface and registry for the line following loop.
+//
+// Every steering algorithm is wrapped in a Controller: a table of hooks plus a
+// context pointer to its own state. Controllers are registered once at start-up
+// and exactly one of them is active. Switching resets the new controller, so the
+// active one can be changed at runtime (BLE) while the car is driving.
+//
+// The registry measures execution time of every update with the counter passed
+// to Controller_Init() (CPU cycles on the car), so controllers can be compared
+// by cost as well as by behaviour.
+
+#define CONTROLLER_MAX_COUNT    (4u)
+#define CONTROLLER_INVALID      (0xFFu)
+
+// Everything the line following loop knows at one control step
+typedef struct
+{
+    uint8_t sensors;        // Track_Read() pattern
+    float position;         // Line position used for control (estimate when the line estimator is enabled)
+    float estimate;         // Line estimator position, always updated
+    float velocity;         // Line estimator lateral velocity, position units per second
+    float speed;            // Base forward speed, motor units
+    uint64_t now;           // Microseconds
+} ControllerInput;
+
+typedef struct
+{
+    const char* name;
+    void (*init)(void* context);                                    // Optional, called by Controller_Register()
+    void (*reset)(void* context, uint64_t now);                     // Optional, clear history before the controller takes over
+    float (*update)(void* context, const ControllerInput* input);   // Returns steering correction in motor units
+    void* context;
+} Controller;
+
+typedef uint32_t (*Controller_CounterFunction)(void);
+
+typedef struct
+{
+    uint32_t runs;          // Updates measured since last reset
+    uint32_t lastCycles;    // Cost of the last update
+    uint32_t maxCycles;     // Worst update seen
+    uint64_t totalCycles;   // Sum over all measured updates
+} ControllerCost;
+
+// Clear the registry. counter timestamps updates, NULL disables cost measurement.
+void Controller_Init(Controller_CounterFunction counter);
+
+// Register a controller and call its init hook. The first one registered becomes active.
+// Returns controller id or CONTROLLER_INVALID when the registry is full.
+uint8_t Controller_Register(const Controller* controller);
+
+// Make controller id active and reset it. Returns false for unknown id.
+bool Controller_Select(uint8_t id, uint64_t now);
+uint8_t Controller_GetActive(void);
+
+// Reset the active controller (e.g. when motors are enabled)
+void Controller_Reset(uint64_t now);
+
+// Run the active controller, returns steering correction
+float Controller_Update(const ControllerInput* input);
+
+const char* Controller_GetName(uint8_t id);
+uint8_t Controller_GetCount(void);
+
+// Cost statistics per controller
+const ControllerCost* Controller_GetCost(uint8_t id);
+uint32_t Controller_GetMeanCycles(uint8_t id);
+void Controller_ResetCost(void);
+
+#ifdef __cplusplus
+}
+#endif
+
+#endif /* CONTROLLER_H */
@@ -0,0 +1,55 @@
+/* ========================================
+ * dead_reckoning.c
+ * ========================================
+ */
+
+#include "dead_reckoning.h"
+#include <math.h>
+
+#define DEAD_RECKONING_PI   (3.14159265f)
+
+void DeadReckoning_Reset(DeadReckoning* reckoning, float x, float y, float heading)
+{
+    reckoning->pose.x = x;
+    reckoning->pose.y = y;
+    reckoning->pose.heading = heading;
+    reckoning->pose.distance = 0.0f;
+    reckoning->cosHeading = cosf(heading);
+    reckoning->sinHeading = sinf(heading);
+}
+
+void DeadReckoning_Step(DeadReckoning* reckoning, float leftTravel, float rightTravel, float trackWidth)
+{
+    Odometry_Pose* pose = &reckoning->pose;
+    float cosHeading = reckoning->cosHeading;
+    float sinHeading = reckoning->sinHeading;
+
+    float travel = 0.5f * (leftTravel + rightTravel);
+    float turn = (rightTravel - leftTravel) / trackWidth;
+
+    // Move along the heading at the middle of the step
+    float halfTurn = 0.5f * turn;
+    pose->x += travel * (cosHeading - sinHeading * halfTurn);
+    pose->y += travel * (sinHeading + cosHeading * halfTurn);
+    pose->distance += travel;
+
+    // Rotate heading vector by turn (second order), then pull it back to unit length
+    float cosTurn = 1.0f - 0.5f * turn * turn;
+    float cosNew = cosHeading * cosTurn - sinHeading * turn;
+    float sinNew = sinHeading * cosTurn + cosHeading * turn;
+    float norm = 1.5f - 0.5f * (cosNew * cosNew + sinNew * sinNew);
+    reckoning->cosHeading = cosNew * norm;
+    reckoning->sinHeading = sinNew * norm;
+
+    pose->heading += turn;
+    if (pose->heading > DEAD_RECKONING_PI)
+    {
+        pose->heading -= 2.0f * DEAD_RECKONING_PI;
+    }
+    else if (pose->heading < -DEAD_RECKONING_PI)
+    {
+        pose->heading += 2.0f * DEAD_RECKONING_PI;
+    }
+}
+
+/* [] END OF FILE */
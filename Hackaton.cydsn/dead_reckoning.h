@@ -0,0 +1,43 @@
+#ifndef DEAD_RECKONING_H
+#define DEAD_RECKONING_H
+
+#ifdef __cplusplus
+extern "C" {
+#endif
+
+#include <stdint.h>
+#include <stdbool.h>
+
+// Pose of a differential (skid-steer) drive from the travel of its two sides.
+//
+// One step moves the car along the heading at the middle of the step, then
+// turns it. The heading is kept as a unit vector rotated by a second order
+// small-angle update and pulled back to unit length, so a step needs no
+// sinf()/cosf() and runs in the SysTick interrupt (Odometry API of car.h).
+// No hardware dependencies: the integration is checked on a PC.
+
+typedef struct
+{
+    float x;            //Metres, x axis points where the car faced at Odometry_Reset()
+    float y;            //Metres, positive to the left
+    float heading;      //Radians, -pi..pi, positive = turned left (counter-clockwise)
+    float distance;     //Metres travelled by the car centre, backwards counts negative
+} Odometry_Pose;
+
+typedef struct
+{
+    Odometry_Pose pose;
+    float cosHeading;
+    float sinHeading;
+} DeadReckoning;
+
+void DeadReckoning_Reset(DeadReckoning* reckoning, float x, float y, float heading);
+
+// Travel of the left and right side in metres since the last step, trackWidth in metres
+void DeadReckoning_Step(DeadReckoning* reckoning, float leftTravel, float rightTravel, float trackWidth);
+
+#ifdef __cplusplus
+}
+#endif
+
+#endif /* DEAD_RECKONING_H */
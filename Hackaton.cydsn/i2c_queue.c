@@ -0,0 +1,282 @@
+/* ========================================
+ * i2c_queue.c
+ * ========================================
+ */
+
+#include "i2c_queue.h"
+#include <string.h>
+
+typedef struct
+{
+    uint8_t address;
+    uint8_t writeLength;
+    uint8_t readLength;
+    uint8_t buffer[I2C_QUEUE_BUFFER_SIZE];  // Write data, then the bytes read
+    I2cQueue_Callback callback;
+    void* context;
+} Transaction;
+
+typedef struct
+{
+    volatile bool done;
+    enum i2cQueueStatus status;
+    uint8_t* data;
+    uint8_t length;
+} BlockingTransfer;
+
+static const I2cQueue_Port* port = NULL;
+
+// Slots from tail to head are queued, the one at tail is on the bus while busy
+static Transaction queue[I2C_QUEUE_LENGTH];
+static uint8_t head;
+static uint8_t tail;
+static volatile uint8_t count;
+static bool busy;
+static bool reading;            // Read phase of the transaction at tail
+static uint32_t startTime;
+static uint32_t busTime;        // Of the transaction being reported
+static I2cQueue_Stats stats;
+
+static uint8_t next(uint8_t index)
+{
+    return (uint8_t)((index + 1u) % I2C_QUEUE_LENGTH);
+}
+
+static uint32_t timestamp(void)
+{
+    return (port->now != NULL) ? port->now() : 0u;
+}
+
+// Start the transaction at tail, with the lock held
+static bool start(void)
+{
+    Transaction* transaction = &queue[tail];
+
+    busy = true;
+    reading = (transaction->writeLength == 0u);
+    startTime = timestamp();
+    if (reading)
+    {
+        return port->read(transaction->address, transaction->buffer, transaction->readLength);
+    }
+    return port->write(transaction->address, transaction->buffer, transaction->writeLength,
+                       (transaction->readLength > 0u));
+}
+
+// Report the transaction at tail and remove it, with the lock held
+static void finish(enum i2cQueueStatus status)
+{
+    Transaction* transaction = &queue[tail];
+    uint8_t length = (status == I2C_QUEUE_OK) ? transaction->readLength : 0u;
+
+    busTime = busy ? (timestamp() - startTime) : 0u;
+
+    if (status == I2C_QUEUE_ABORTED)
+    {
+        stats.aborted++;
+    }
+    else
+    {
+        stats.transactions++;
+        if (status != I2C_QUEUE_OK)
+        {
+            stats.errors++;
+        }
+    }
+    if (transaction->callback != NULL)
+    {
+        transaction->callback(status, transaction->buffer, length, transaction->context);
+    }
+    tail = next(tail);
+    count--;
+    busy = false;
+}
+
+// Start queued transactions until one is on the bus, with the lock held
+static void startNext(void)
+{
+    while (!busy && (count > 0u))
+    {
+        if (!start())
+        {
+            finish(I2C_QUEUE_ERROR);
+        }
+    }
+}
+
+static bool submit(uint8_t address, const uint8_t* data, uint8_t writeLength, uint8_t readLength,
+                   I2cQueue_Callback callback, void* context)
+{
+    if ((writeLength > I2C_QUEUE_BUFFER_SIZE) || (readLength > I2C_QUEUE_BUFFER_SIZE) ||
+        ((writeLength == 0u) && (readLength == 0u)))
+    {
+        return false;
+    }
+
+    uint32_t state = port->lock();
+    if (count >= I2C_QUEUE_LENGTH)
+    {
+        stats.full++;
+        port->unlock(state);
+        return false;
+    }
+
+    Transaction* transaction = &queue[head];
+    transaction->address = address;
+    transaction->writeLength = writeLength;
+    transaction->readLength = readLength;
+    if (writeLength > 0u)
+    {
+        memcpy(transaction->buffer, data, writeLength);
+    }
+    transaction->callback = callback;
+    transaction->context = context;
+    head = next(head);
+    count++;
+    if (count > stats.maxDepth)
+    {
+        stats.maxDepth = count;
+    }
+    startNext();
+
+    port->unlock(state);
+    return true;
+}
+
+static void blockingDone(enum i2cQueueStatus status, const uint8_t* data, uint8_t length, void* context)
+{
+    BlockingTransfer* transfer = (BlockingTransfer*)context;
+
+    if (length > transfer->length)
+    {
+        length = transfer->length;
+    }
+    if (length > 0u)
+    {
+        memcpy(transfer->data, data, length);
+    }
+    transfer->status = status;
+    transfer->done = true;
+}
+
+void I2cQueue_Init(const I2cQueue_Port* busPort)
+{
+    port = busPort;
+    head = 0u;
+    tail = 0u;
+    count = 0u;
+    busy = false;
+    reading = false;
+    busTime = 0u;
+    stats = (I2cQueue_Stats){0};
+}
+
+bool I2cQueue_Write(uint8_t address, const uint8_t* data, uint8_t length, I2cQueue_Callback callback, void* context)
+{
+    return submit(address, data, length, 0u, callback, context);
+}
+
+bool I2cQueue_Read(uint8_t address, uint8_t length, I2cQueue_Callback callback, void* context)
+{
+    return submit(address, NULL, 0u, length, callback, context);
+}
+
+bool I2cQueue_WriteRead(uint8_t address, const uint8_t* data, uint8_t writeLength, uint8_t readLength,
+                        I2cQueue_Callback callback, void* context)
+{
+    return submit(address, data, writeLength, readLength, callback, context);
+}
+
+void I2cQueue_WriteWait(uint8_t address, const uint8_t* data, uint8_t length, I2cQueue_Callback callback, void* context)
+{
+    // Full queue: the interrupt frees a slot with every completion
+    while (!I2cQueue_Write(address, data, length, callback, context))
+    {
+    }
+}
+
+enum i2cQueueStatus I2cQueue_Transfer(uint8_t address, const uint8_t* writeData, uint8_t writeLength,
+                                      uint8_t* readData, uint8_t readLength)
+{
+    BlockingTransfer transfer = { .done = false, .status = I2C_QUEUE_ERROR, .data = readData, .length = readLength };
+
+    if ((writeLength > I2C_QUEUE_BUFFER_SIZE) || (readLength > I2C_QUEUE_BUFFER_SIZE) ||
+        ((writeLength == 0u) && (readLength == 0u)))
+    {
+        return I2C_QUEUE_ERROR;
+    }
+    while (!submit(address, writeData, writeLength, readLength, blockingDone, &transfer))
+    {
+    }
+    while (!transfer.done)
+    {
+    }
+    return transfer.status;
+}
+
+void I2cQueue_OnComplete(bool error)
+{
+    uint32_t state = port->lock();
+
+    if (busy)
+    {
+        Transaction* transaction = &queue[tail];
+
+        if (error)
+        {
+            finish(I2C_QUEUE_ERROR);
+        }
+        else if (!reading && (transaction->readLength > 0u))
+        {
+            // Write part of a write-read went out, read after a repeated start
+            reading = true;
+            if (!port->read(transaction->address, transaction->buffer, transaction->readLength))
+            {
+                finish(I2C_QUEUE_ERROR);
+            }
+        }
+        else
+        {
+            finish(I2C_QUEUE_OK);
+        }
+        startNext();
+    }
+
+    port->unlock(state);
+}
+
+void I2cQueue_Abort(void)
+{
+    uint32_t state = port->lock();
+
+    while (count > 0u)
+    {
+        finish(I2C_QUEUE_ABORTED);
+    }
+
+    port->unlock(state);
+}
+
+uint32_t I2cQueue_GetBusTimeUs(void)
+{
+    return busTime;
+}
+
+bool I2cQueue_IsIdle(void)
+{
+    return (count == 0u);
+}
+
+uint8_t I2cQueue_GetDepth(void)
+{
+    return count;
+}
+
+void I2cQueue_GetStats(I2cQueue_Stats* copy)
+{
+    uint32_t state = port->lock();
+    *copy = stats;
+    port->unlock(state);
+}
+
+/* [] END OF FILE */
@@ -0,0 +1,102 @@
+#ifndef I2C_QUEUE_H
+#define I2C_QUEUE_H
+
+#ifdef __cplusplus
+extern "C" {
+#endif
+
+#include <stdint.h>
+#include <stdbool.h>
+
+// Asynchronous I2C master: a fixed-size queue of transactions on one bus.
+//
+// I2cQueue_Write/Read/WriteRead() copy the request into a free slot and return
+// at once; the bus works from the I2C interrupt while the CM4 keeps computing.
+// Every slot owns its buffer, so callers may reuse their data right away and
+// the driver never shares a static packet between transfers. A write-read
+// sends the write without stop and reads after a repeated start (register read).
+//
+// Transactions run in submission order. When one finishes its callback runs,
+// then the next one starts. Callbacks run in the I2C interrupt (or in
+// I2cQueue_Abort()) with interrupts disabled: keep them short and do not
+// submit from them. Submit calls return false while the queue is full.
+//
+// The blocking helpers wait for their own transaction only (and for a free
+// slot); use them for init code and for reads whose result is needed right
+// away. Never call them from an interrupt.
+//
+// The bus is reached through a port, so the queue runs on the host against a
+// stubbed SCB. The port starts a transfer and reports its end with
+// I2cQueue_OnComplete(). I2cQueue_InitScb() binds the queue to I2C_Main.
+
+#define I2C_QUEUE_LENGTH        (16u)
+#define I2C_QUEUE_BUFFER_SIZE   (33u)   // Register address + 8 PCA9685 channels of 4 bytes
+
+enum i2cQueueStatus
+{
+    I2C_QUEUE_OK = 0,
+    I2C_QUEUE_ERROR,        // Address or data not acknowledged, arbitration lost
+    I2C_QUEUE_ABORTED       // Dropped by I2cQueue_Abort()
+};
+
+// data points to the bytes read (length 0 for writes), valid during the call only
+typedef void (*I2cQueue_Callback)(enum i2cQueueStatus status, const uint8_t* data, uint8_t length, void* context);
+
+typedef struct
+{
+    // Start a transfer, return false if it could not start.
+    // keepBus: end without stop, a read with repeated start follows.
+    bool (*write)(uint8_t address, uint8_t* data, uint8_t length, bool keepBus);
+    bool (*read)(uint8_t address, uint8_t* data, uint8_t length);
+    uint32_t (*lock)(void);             // Critical section against the I2C interrupt
+    void (*unlock)(uint32_t state);
+    uint32_t (*now)(void);              // Microseconds, NULL if bus time is not measured
+} I2cQueue_Port;
+
+typedef struct
+{
+    uint32_t transactions;      // Completed, with or without error
+    uint32_t errors;
+    uint32_t aborted;
+    uint32_t full;              // Submissions refused for a full queue
+    uint8_t maxDepth;
+} I2cQueue_Stats;
+
+void I2cQueue_Init(const I2cQueue_Port* port);
+
+// Bind to I2C_Main, after the SCB is initialised and its interrupt hooked
+void I2cQueue_InitScb(void);
+
+bool I2cQueue_Write(uint8_t address, const uint8_t* data, uint8_t length, I2cQueue_Callback callback, void* context);
+bool I2cQueue_Read(uint8_t address, uint8_t length, I2cQueue_Callback callback, void* context);
+bool I2cQueue_WriteRead(uint8_t address, const uint8_t* data, uint8_t writeLength, uint8_t readLength,
+                        I2cQueue_Callback callback, void* context);
+
+// Submit, waiting while the queue is full; callback may be NULL (fire and forget)
+void I2cQueue_WriteWait(uint8_t address, const uint8_t* data, uint8_t length, I2cQueue_Callback callback, void* context);
+
+// Submit and wait for this transaction. writeLength 0 is a plain read,
+// readLength 0 a plain write.
+enum i2cQueueStatus I2cQueue_Transfer(uint8_t address, const uint8_t* writeData, uint8_t writeLength,
+                                      uint8_t* readData, uint8_t readLength);
+
+// Port: the transfer started last finished
+void I2cQueue_OnComplete(bool error);
+
+// Drop the transaction on the bus and everything queued, callbacks get
+// I2C_QUEUE_ABORTED. The caller owns the hardware afterwards: it resets the
+// block, so no completion of the dropped transfer arrives.
+void I2cQueue_Abort(void);
+
+// Microseconds from start to end of the transaction being reported, valid in its callback
+uint32_t I2cQueue_GetBusTimeUs(void);
+
+bool I2cQueue_IsIdle(void);
+uint8_t I2cQueue_GetDepth(void);
+void I2cQueue_GetStats(I2cQueue_Stats* stats);
+
+#ifdef __cplusplus
+}
+#endif
+
+#endif /* I2C_QUEUE_H */
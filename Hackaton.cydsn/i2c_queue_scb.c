@@ -0,0 +1,74 @@
+/* ========================================
+ * i2c_queue_scb.c
+ * ========================================
+ */
+
+#include "i2c_queue.h"
+#include "project.h"
+#include "car.h"
+
+// Transfer configuration must live until the transfer is complete
+static cy_stc_scb_i2c_master_xfer_config_t transfer;
+
+static bool scbWrite(uint8_t address, uint8_t* data, uint8_t length, bool keepBus)
+{
+    transfer.slaveAddress = address;
+    transfer.buffer = data;
+    transfer.bufferSize = length;
+    transfer.xferPending = keepBus;
+    return (CY_SCB_I2C_SUCCESS == Cy_SCB_I2C_MasterWrite(I2C_Main_HW, &transfer, &I2C_Main_context));
+}
+
+static bool scbRead(uint8_t address, uint8_t* data, uint8_t length)
+{
+    transfer.slaveAddress = address;
+    transfer.buffer = data;
+    transfer.bufferSize = length;
+    transfer.xferPending = false;
+    return (CY_SCB_I2C_SUCCESS == Cy_SCB_I2C_MasterRead(I2C_Main_HW, &transfer, &I2C_Main_context));
+}
+
+static uint32_t scbLock(void)
+{
+    return Cy_SysLib_EnterCriticalSection();
+}
+
+static void scbUnlock(uint32_t state)
+{
+    Cy_SysLib_ExitCriticalSection(state);
+}
+
+static uint32_t scbNow(void)
+{
+    return (uint32_t)Timing_GetMicroseconds();
+}
+
+// Called by Cy_SCB_I2C_Interrupt() after the driver finished the transfer
+static void scbEvent(uint32_t events)
+{
+    if (0u != (events & CY_SCB_I2C_MASTER_ERR_EVENT))
+    {
+        I2cQueue_OnComplete(true);
+    }
+    else if (0u != (events & (CY_SCB_I2C_MASTER_WR_CMPLT_EVENT | CY_SCB_I2C_MASTER_RD_CMPLT_EVENT)))
+    {
+        I2cQueue_OnComplete(false);
+    }
+}
+
+static const I2cQueue_Port scbPort =
+{
+    .write = scbWrite,
+    .read = scbRead,
+    .lock = scbLock,
+    .unlock = scbUnlock,
+    .now = scbNow,
+};
+
+void I2cQueue_InitScb(void)
+{
+    I2cQueue_Init(&scbPort);
+    Cy_SCB_I2C_RegisterEventCallback(I2C_Main_HW, scbEvent, &I2C_Main_context);
+}
+
+/* [] END OF FILE */
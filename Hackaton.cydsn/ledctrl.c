@@ -88,5 +88,10 @@ void Leds_Update(void)
     Leds_SendData(&Leds_rawColorBuffer[0], WS2812_BUFFER_SIZE);
 }
 
+bool Leds_IsIdle(void)
+{
+    return Cy_SCB_SPI_IsTxComplete(SPI_LEDCTRL_HW);
+}
+
 
 /* [] END OF FILE */
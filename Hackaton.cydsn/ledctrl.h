@@ -91,6 +91,16 @@ void Leds_FillSolidColor(uint8_t g, uint8_t r, uint8_t b);
 *******************************************************************************/
 void Leds_Update(void);
 
+/*******************************************************************************
+* Function Name: Leds_IsIdle()
+********************************************************************************
+* Summary:
+*    True when the last update has been shifted out completely and the data
+*    line is quiet (the battery divider on the same wire can be sampled).
+*
+*******************************************************************************/
+bool Leds_IsIdle(void);
+
 #endif /* LEDCTRL_H */
     
 /* [] END OF FILE */
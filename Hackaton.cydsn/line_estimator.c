@@ -0,0 +1,107 @@
+/* ========================================
+ * line_estimator.c
+ * ========================================
+ */
+
+#include "line_estimator.h"
+#include "line_position.h"
+
+static float clamp(float x, float low, float high)
+{
+    if (x > high)
+        return high;
+    else if (x < low)
+        return low;
+    else
+        return x;
+}
+
+void LineEstimator_Init(LineEstimator* estimator, float alpha, float beta)
+{
+    estimator->alpha = alpha;
+    estimator->beta = beta;
+    LineEstimator_Reset(estimator, 0u, 0.0f, 0u);
+}
+
+void LineEstimator_Reset(LineEstimator* estimator, uint8_t sensors, float measurement, uint64_t now)
+{
+    estimator->position = measurement;
+    estimator->velocity = 0.0f;
+    estimator->lastMeasurement = measurement;
+    estimator->lastEdgePosition = measurement;
+    estimator->lastSensors = sensors;
+    estimator->lastTime = now;
+    estimator->lastEdgeTime = now;
+}
+
+float LineEstimator_Update(LineEstimator* estimator, uint8_t sensors, float measurement, uint64_t now)
+{
+    float deltaTime = (float)(now - estimator->lastTime) * 1.0e-6f;
+    float edgeTime = (float)(now - estimator->lastEdgeTime) * 1.0e-6f;
+    float predicted = estimator->position + estimator->velocity * deltaTime;
+
+    estimator->lastTime = now;
+
+    if (sensors == 0u)
+    {
+        // Line lost, nothing to correct against - follow the no-line policy of the measurement
+        estimator->position = measurement;
+    }
+    else if (sensors != estimator->lastSensors)
+    {
+        // Edge: line is on the boundary between previous and current pattern
+        float edgePosition = (estimator->lastSensors != 0u) ?
+            0.5f * (estimator->lastMeasurement + measurement) : measurement;
+
+        estimator->position = predicted + estimator->alpha * (edgePosition - predicted);
+
+        // Distance between two consecutive edges over the time between them is a velocity measurement
+        if ((estimator->lastSensors != 0u) && (edgeTime > 0.0f) &&
+            ((now - estimator->lastEdgeTime) < LINE_ESTIMATOR_MAX_EDGE_US))
+        {
+            float edgeVelocity = (edgePosition - estimator->lastEdgePosition) / edgeTime;
+            estimator->velocity += estimator->beta * (edgeVelocity - estimator->velocity);
+        }
+        else
+        {
+            estimator->velocity = 0.0f;
+        }
+        estimator->lastEdgePosition = edgePosition;
+        estimator->lastEdgeTime = now;
+    }
+    else
+    {
+        // No edge: line stayed within the band of the current pattern
+        float below;
+        float above;
+        LinePosition_GetBand(sensors, &below, &above);
+        float low = measurement - below;
+        float high = measurement + above;
+
+        if (((predicted > high) && (estimator->velocity > 0.0f)) ||
+            ((predicted < low) && (estimator->velocity < 0.0f)))
+        {
+            // Ran through the far band limit without an edge - the line has stopped or
+            // turned back, the best guess is the middle of the band
+            estimator->position = measurement;
+            estimator->velocity = 0.0f;
+        }
+        else
+        {
+            // Behind the edge just crossed (alpha < 1 leaves the estimate short of it) or inside
+            estimator->position = clamp(predicted, low, high);
+        }
+    }
+
+    estimator->lastSensors = sensors;
+    estimator->lastMeasurement = measurement;
+
+    return estimator->position;
+}
+
+float LineEstimator_GetVelocity(const LineEstimator* estimator)
+{
+    return estimator->velocity;
+}
+
+/* [] END OF FILE */
@@ -0,0 +1,54 @@
+#ifndef LINE_ESTIMATOR_H
+#define LINE_ESTIMATOR_H
+
+#ifdef __cplusplus
+extern "C" {
+#endif
+
+#include <stdint.h>
+#include <stdbool.h>
+
+// Continuous line position from binary track sensors.
+//
+// Weighted average of binary sensors only takes a few discrete values. The line
+// position is exactly known only at the moment a sensor changes state: the line
+// is then on the boundary between the old and the new pattern. The estimator is
+// an alpha-beta filter updated at these edges: distance between two edges over
+// the time since the previous edge measures lateral velocity. Between edges the
+// position is predicted from velocity and kept inside the band of the current
+// pattern (LinePosition_GetBand()), so the output changes smoothly at the
+// control rate. Bands follow the sensor weights, they are wider where the
+// weights are further apart.
+
+#define LINE_ESTIMATOR_ALPHA        (0.7f)
+#define LINE_ESTIMATOR_BETA         (0.3f)
+#define LINE_ESTIMATOR_MAX_EDGE_US  (200000u)   // Longer edge intervals don't correct velocity
+
+typedef struct
+{
+    float alpha;            // Position correction gain
+    float beta;             // Velocity correction gain
+    float position;
+    float velocity;         // Position units per second
+    float lastMeasurement;  // Position of the current sensor pattern
+    float lastEdgePosition;
+    uint8_t lastSensors;
+    uint64_t lastTime;      // Microseconds
+    uint64_t lastEdgeTime;  // Microseconds
+} LineEstimator;
+
+void LineEstimator_Init(LineEstimator* estimator, float alpha, float beta);
+
+// Restart from measurement at time now (microseconds)
+void LineEstimator_Reset(LineEstimator* estimator, uint8_t sensors, float measurement, uint64_t now);
+
+// Feed sensor pattern and its position (LinePosition_Get()) measured at time now, returns estimated position
+float LineEstimator_Update(LineEstimator* estimator, uint8_t sensors, float measurement, uint64_t now);
+
+float LineEstimator_GetVelocity(const LineEstimator* estimator);
+
+#ifdef __cplusplus
+}
+#endif
+
+#endif /* LINE_ESTIMATOR_H */
@@ -0,0 +1,144 @@
+/* ========================================
+ * line_position.c
+ * ========================================
+ */
+
+#include "line_position.h"
+
+// Sensor positions:  [0]   [1]   [2]   [3]   [4]   [5]   [6]
+//                   LEFT  LEFT  LEFT CENTER RIGHT RIGHT RIGHT
+static float weights[LINE_SENSOR_COUNT] = {-3.0f, -2.0f, -1.0f, 0.0f, 1.5f, 2.5f, 3.5f};
+
+static float positionTable[LINE_PATTERN_COUNT];
+static float bandBelow[LINE_PATTERN_COUNT];
+static float bandAbove[LINE_PATTERN_COUNT];
+static enum lineNoLinePolicy noLinePolicy = LINE_NO_LINE_LAST_SIDE;
+
+// Weighted average of active sensors. Summation order is fixed (sensor 0 first)
+// so the table holds exactly what the per-tick loop used to compute.
+static void buildTable(void)
+{
+    positionTable[0] = 0.0f;    // Not used, see LinePosition_Get()
+
+    for (uint32_t pattern = 1u; pattern < LINE_PATTERN_COUNT; pattern++)
+    {
+        float weightedSum = 0.0f;
+        int activeCount = 0;
+
+        for (uint8_t i = 0; i < LINE_SENSOR_COUNT; i++)
+        {
+            if (pattern & (1u << i))
+            {
+                weightedSum += weights[i];
+                activeCount++;
+            }
+        }
+
+        positionTable[pattern] = weightedSum / (float)activeCount;
+    }
+}
+
+// Half distance to the nearest sweep pattern (one sensor or two neighbours) on
+// each side. Patterns outside the sweep, e.g. a crossing, get the bands of the
+// sweep positions around them. At the ends of the bar the band is symmetric.
+static void buildBands(void)
+{
+    bandBelow[0] = 0.0f;
+    bandAbove[0] = 0.0f;
+
+    for (uint32_t pattern = 1u; pattern < LINE_PATTERN_COUNT; pattern++)
+    {
+        float position = positionTable[pattern];
+        float lower = position;     // Nearest sweep positions, position itself if none
+        float upper = position;
+
+        for (uint8_t i = 0; i < LINE_SENSOR_COUNT; i++)
+        {
+            // Sensor i alone, then sensors i and i + 1
+            for (uint8_t width = 1u; (width <= 2u) && ((i + width) <= LINE_SENSOR_COUNT); width++)
+            {
+                float sweep = positionTable[((1u << width) - 1u) << i];
+                if ((sweep < position) && ((lower == position) || (sweep > lower)))
+                {
+                    lower = sweep;
+                }
+                if ((sweep > position) && ((upper == position) || (sweep < upper)))
+                {
+                    upper = sweep;
+                }
+            }
+        }
+
+        float below = 0.5f * (position - lower);
+        float above = 0.5f * (upper - position);
+        bandBelow[pattern] = (lower != position) ? below : above;
+        bandAbove[pattern] = (upper != position) ? above : below;
+    }
+}
+
+void LinePosition_Init(void)
+{
+    buildTable();
+    buildBands();
+}
+
+void LinePosition_SetWeights(const float newWeights[LINE_SENSOR_COUNT])
+{
+    for (uint8_t i = 0; i < LINE_SENSOR_COUNT; i++)
+    {
+        weights[i] = newWeights[i];
+    }
+    buildTable();
+    buildBands();
+}
+
+void LinePosition_SetWeight(uint8_t sensor, float weight)
+{
+    if (sensor < LINE_SENSOR_COUNT)
+    {
+        weights[sensor] = weight;
+        buildTable();
+        buildBands();
+    }
+}
+
+float LinePosition_GetWeight(uint8_t sensor)
+{
+    return (sensor < LINE_SENSOR_COUNT) ? weights[sensor] : 0.0f;
+}
+
+void LinePosition_SetNoLinePolicy(enum lineNoLinePolicy policy)
+{
+    noLinePolicy = policy;
+}
+
+float LinePosition_Get(uint8_t sensors, float lastPosition)
+{
+    sensors &= (uint8_t)(LINE_PATTERN_COUNT - 1u);
+
+    if (sensors != 0u)
+    {
+        return positionTable[sensors];
+    }
+
+    switch (noLinePolicy)
+    {
+        case LINE_NO_LINE_HOLD:
+            return lastPosition;
+        case LINE_NO_LINE_CENTER:
+            return 0.0f;
+        case LINE_NO_LINE_LAST_SIDE:
+        default:
+            // If robot was turning left (negative position), assume line is still left
+            return (lastPosition < 0.0f) ? -LINE_LOST_POSITION : LINE_LOST_POSITION;
+    }
+}
+
+void LinePosition_GetBand(uint8_t sensors, float* below, float* above)
+{
+    sensors &= (uint8_t)(LINE_PATTERN_COUNT - 1u);
+    *below = bandBelow[sensors];
+    *above = bandAbove[sensors];
+}
+
+/* [] END OF FILE */
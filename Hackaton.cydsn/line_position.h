@@ -0,0 +1,56 @@
+#ifndef LINE_POSITION_H
+#define LINE_POSITION_H
+
+#ifdef __cplusplus
+extern "C" {
+#endif
+
+#include <stdint.h>
+#include <stdbool.h>
+
+// Line position from the 7-bit track sensor pattern (Track_Read()).
+//
+// The position is the average weight of active sensors. Since there are only
+// 128 possible patterns, the positions are precomputed into a table whenever
+// the weights change, so LinePosition_Get() is a single table lookup.
+//
+// While the line sweeps across the sensor bar, the pattern alternates between
+// one sensor and two neighbours. The band of a pattern is the range of line
+// positions it stands for: it reaches halfway to the positions of the sweep
+// patterns on either side. With uneven weights the two halves differ.
+
+#define LINE_SENSOR_COUNT       (7u)
+#define LINE_PATTERN_COUNT      (1u << LINE_SENSOR_COUNT)
+
+// Position reported by LINE_NO_LINE_LAST_SIDE when the line is lost
+#define LINE_LOST_POSITION      (3.0f)
+
+// What LinePosition_Get() returns for pattern 0x00 (no sensor sees the line)
+enum lineNoLinePolicy
+{
+    LINE_NO_LINE_LAST_SIDE = 0,   // +-LINE_LOST_POSITION, on the side of the last position (default)
+    LINE_NO_LINE_HOLD      = 1,   // Last position unchanged
+    LINE_NO_LINE_CENTER    = 2,   // 0, drive straight
+};
+
+// Build the table from default weights
+void LinePosition_Init(void);
+
+// Change weights (sensor 0 is leftmost, negative = left) and rebuild the table
+void LinePosition_SetWeights(const float weights[LINE_SENSOR_COUNT]);
+void LinePosition_SetWeight(uint8_t sensor, float weight);
+float LinePosition_GetWeight(uint8_t sensor);
+
+void LinePosition_SetNoLinePolicy(enum lineNoLinePolicy policy);
+
+// Position for sensor pattern. lastPosition is only used when no sensor sees the line.
+float LinePosition_Get(uint8_t sensors, float lastPosition);
+
+// Distance from the position of a pattern to the lower and upper edge of its band, 0 for pattern 0x00
+void LinePosition_GetBand(uint8_t sensors, float* below, float* above);
+
+#ifdef __cplusplus
+}
+#endif
+
+#endif /* LINE_POSITION_H */
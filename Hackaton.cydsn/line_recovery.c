@@ -0,0 +1,156 @@
+/* ========================================
+ * line_recovery.c
+ * ========================================
+ */
+
+#include "line_recovery.h"
+
+static void setTurn(LineRecovery* recovery, int8_t direction)
+{
+    // Same sign convention as tank steering: positive turns right (left wheel forward)
+    recovery->direction = direction;
+    recovery->leftSpeed = (int16_t)(recovery->searchSpeed * direction);
+    recovery->rightSpeed = (int16_t)(-recovery->searchSpeed * direction);
+}
+
+static void setState(LineRecovery* recovery, enum lineRecoveryState state, uint64_t now)
+{
+    recovery->state = state;
+    recovery->stateTime = now;
+}
+
+void LineRecovery_Init(LineRecovery* recovery)
+{
+    LineRecovery_SetSearch(recovery, LINE_RECOVERY_SEARCH_SPEED, LINE_RECOVERY_SWEEP_US);
+    LineRecovery_ResetStats(recovery);
+    LineRecovery_Reset(recovery, 0u);
+}
+
+void LineRecovery_SetSearch(LineRecovery* recovery, int16_t searchSpeed, uint32_t sweepTime)
+{
+    recovery->searchSpeed = (searchSpeed < 0) ? -searchSpeed : searchSpeed;
+    recovery->sweepTime = (sweepTime > 0u) ? sweepTime : LINE_RECOVERY_SWEEP_US;
+}
+
+void LineRecovery_Reset(LineRecovery* recovery, uint64_t now)
+{
+    recovery->side = 1;
+    recovery->direction = 0;
+    recovery->sweep = 0;
+    recovery->lineVisible = true;
+    recovery->lostTime = now;
+    recovery->leftSpeed = 0;
+    recovery->rightSpeed = 0;
+    setState(recovery, LINE_RECOVERY_TRACKING, now);
+}
+
+void LineRecovery_ResetStats(LineRecovery* recovery)
+{
+    recovery->stats = (LineRecoveryStats){0};
+}
+
+enum lineRecoveryEvent LineRecovery_Update(LineRecovery* recovery, uint8_t sensors, float lastPosition, uint64_t now)
+{
+    bool visible = (sensors != 0u);
+
+    if (visible)
+    {
+        enum lineRecoveryEvent event = LINE_RECOVERY_EVENT_NONE;
+
+        if ((recovery->state == LINE_RECOVERY_BRAKE) || (recovery->state == LINE_RECOVERY_SEARCH))
+        {
+            LineRecoveryStats* stats = &recovery->stats;
+            stats->recoveries++;
+            stats->lastReacquireUs = (uint32_t)(now - recovery->lostTime);
+            if (stats->lastReacquireUs > stats->maxReacquireUs)
+            {
+                stats->maxReacquireUs = stats->lastReacquireUs;
+            }
+            setState(recovery, LINE_RECOVERY_TRACKING, now);
+            event = LINE_RECOVERY_EVENT_REACQUIRED;
+        }
+
+        // A failed search stays failed until reset, the car has been stopped
+        recovery->lineVisible = true;
+        recovery->lostTime = now;
+        return event;
+    }
+
+    // Line just disappeared: remember the side it was on
+    if (recovery->lineVisible)
+    {
+        recovery->lineVisible = false;
+        recovery->side = (lastPosition < 0.0f) ? -1 : 1;
+    }
+
+    uint64_t lostFor = now - recovery->lostTime;
+
+    switch (recovery->state)
+    {
+        case LINE_RECOVERY_TRACKING:
+            if (lostFor >= LINE_RECOVERY_CONFIRM_US)
+            {
+                recovery->leftSpeed = 0;
+                recovery->rightSpeed = 0;
+                setState(recovery, LINE_RECOVERY_BRAKE, now);
+                return LINE_RECOVERY_EVENT_LOST;
+            }
+            break;
+
+        case LINE_RECOVERY_BRAKE:
+            if ((now - recovery->stateTime) >= LINE_RECOVERY_BRAKE_US)
+            {
+                recovery->sweep = 0;
+                setTurn(recovery, recovery->side);
+                setState(recovery, LINE_RECOVERY_SEARCH, now);
+            }
+            break;
+
+        case LINE_RECOVERY_SEARCH:
+            if (lostFor >= LINE_RECOVERY_TIMEOUT_US)
+            {
+                recovery->leftSpeed = 0;
+                recovery->rightSpeed = 0;
+                recovery->stats.failures++;
+                setState(recovery, LINE_RECOVERY_FAILED, now);
+                return LINE_RECOVERY_EVENT_FAILED;
+            }
+            // Sweep n lasts (n + 1) sweep times: T, -2T, 3T, ... covers T, -T, 2T, -2T, ...
+            if ((now - recovery->stateTime) >= (uint64_t)recovery->sweepTime * (recovery->sweep + 1u))
+            {
+                recovery->sweep++;
+                setTurn(recovery, (int8_t)-recovery->direction);
+                recovery->stateTime = now;
+            }
+            break;
+
+        case LINE_RECOVERY_FAILED:
+        default:
+            break;
+    }
+
+    return LINE_RECOVERY_EVENT_NONE;
+}
+
+enum lineRecoveryState LineRecovery_GetState(const LineRecovery* recovery)
+{
+    return recovery->state;
+}
+
+bool LineRecovery_IsActive(const LineRecovery* recovery)
+{
+    return (recovery->state != LINE_RECOVERY_TRACKING);
+}
+
+void LineRecovery_GetWheelTargets(const LineRecovery* recovery, int16_t* left, int16_t* right)
+{
+    *left = recovery->leftSpeed;
+    *right = recovery->rightSpeed;
+}
+
+const LineRecoveryStats* LineRecovery_GetStats(const LineRecovery* recovery)
+{
+    return &recovery->stats;
+}
+
+/* [] END OF FILE */
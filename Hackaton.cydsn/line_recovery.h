@@ -0,0 +1,91 @@
+#ifndef LINE_RECOVERY_H
+#define LINE_RECOVERY_H
+
+#ifdef __cplusplus
+extern "C" {
+#endif
+
+#include <stdint.h>
+#include <stdbool.h>
+
+// Lost-line recovery for line following.
+//
+// Short gaps (no sensor sees the line for less than LINE_RECOVERY_CONFIRM_US) are
+// left to the steering controller. After that the car:
+//   1. brakes for LINE_RECOVERY_BRAKE_US (wheel targets are 0, the caller shorts
+//      the motors with Motor_Brake() while in LINE_RECOVERY_BRAKE),
+//   2. turns in place towards the side the line was last seen on, then sweeps
+//      back and forth, every sweep one LINE_RECOVERY_SWEEP_US longer than the
+//      previous one, so the searched angle widens on both sides,
+//   3. gives up after LINE_RECOVERY_TIMEOUT_US and reports failure.
+// Any sensor seeing the line ends the search. Time from the loss to reacquisition
+// and recovery counts are kept for telemetry.
+
+#define LINE_RECOVERY_CONFIRM_US    (20000u)    // Gaps shorter than this are not a loss
+#define LINE_RECOVERY_BRAKE_US      (80000u)
+#define LINE_RECOVERY_SWEEP_US      (150000u)   // First sweep, later sweeps grow by this much
+#define LINE_RECOVERY_TIMEOUT_US    (3000000u)  // From the loss to giving up
+#define LINE_RECOVERY_SEARCH_SPEED  (1200)      // Wheel speed while turning in place, motor units
+
+enum lineRecoveryState
+{
+    LINE_RECOVERY_TRACKING  = 0,    // Line visible (or gap shorter than confirm time)
+    LINE_RECOVERY_BRAKE     = 1,
+    LINE_RECOVERY_SEARCH    = 2,
+    LINE_RECOVERY_FAILED    = 3,    // Timeout, car must stop
+};
+
+enum lineRecoveryEvent
+{
+    LINE_RECOVERY_EVENT_NONE        = 0,
+    LINE_RECOVERY_EVENT_LOST        = 1,    // Loss confirmed, recovery started
+    LINE_RECOVERY_EVENT_REACQUIRED  = 2,    // Line found again during recovery
+    LINE_RECOVERY_EVENT_FAILED      = 3,    // Search timed out
+};
+
+typedef struct
+{
+    uint16_t recoveries;        // Successful reacquisitions
+    uint16_t failures;          // Searches that timed out
+    uint32_t lastReacquireUs;   // Loss to reacquisition time of the last recovery
+    uint32_t maxReacquireUs;
+} LineRecoveryStats;
+
+typedef struct
+{
+    enum lineRecoveryState state;
+    uint32_t sweepTime;         // Microseconds, first sweep
+    int16_t searchSpeed;        // Motor units
+    int8_t side;                // +1 line was last seen right, -1 left
+    int8_t direction;           // Current sweep direction, +1 turns right
+    uint8_t sweep;              // Number of the current sweep
+    bool lineVisible;
+    uint64_t lostTime;          // Last time the line was seen, microseconds
+    uint64_t stateTime;         // Start of the current state / sweep
+    int16_t leftSpeed;          // Wheel targets while recovering
+    int16_t rightSpeed;
+    LineRecoveryStats stats;
+} LineRecovery;
+
+void LineRecovery_Init(LineRecovery* recovery);
+void LineRecovery_SetSearch(LineRecovery* recovery, int16_t searchSpeed, uint32_t sweepTime);
+
+// Back to tracking, e.g. when motors are enabled. Statistics are kept.
+void LineRecovery_Reset(LineRecovery* recovery, uint64_t now);
+void LineRecovery_ResetStats(LineRecovery* recovery);
+
+// Feed sensor pattern and the last known line position at time now.
+// Returns what happened in this step. While LineRecovery_IsActive() the wheel
+// targets from LineRecovery_GetWheelTargets() replace the steering controller.
+enum lineRecoveryEvent LineRecovery_Update(LineRecovery* recovery, uint8_t sensors, float lastPosition, uint64_t now);
+
+enum lineRecoveryState LineRecovery_GetState(const LineRecovery* recovery);
+bool LineRecovery_IsActive(const LineRecovery* recovery);
+void LineRecovery_GetWheelTargets(const LineRecovery* recovery, int16_t* left, int16_t* right);
+const LineRecoveryStats* LineRecovery_GetStats(const LineRecovery* recovery);
+
+#ifdef __cplusplus
+}
+#endif
+
+#endif /* LINE_RECOVERY_H */
@@ -0,0 +1,77 @@
+/* ========================================
+ * lut_controller.c
+ * ========================================
+ */
+
+#include "lut_controller.h"
+
+#define LUT_CONTROLLER_STEP     (2.0f * LUT_CONTROLLER_RANGE / (float)(LUT_CONTROLLER_POINTS - 1u))
+
+static float limit(float value, float max)
+{
+    if (value > max)
+    {
+        return max;
+    }
+    if (value < -max)
+    {
+        return -max;
+    }
+    return value;
+}
+
+void LutController_Init(LutController* lut, float linearGain, float cubicGain, float kd, float outputLimit)
+{
+    lut->outputLimit = outputLimit;
+    LutController_SetKd(lut, kd);
+    LutController_SetCurve(lut, linearGain, cubicGain);
+}
+
+void LutController_SetCurve(LutController* lut, float linearGain, float cubicGain)
+{
+    lut->linearGain = linearGain;
+    lut->cubicGain = cubicGain;
+
+    for (uint8_t i = 0; i < LUT_CONTROLLER_POINTS; i++)
+    {
+        float x = -LUT_CONTROLLER_RANGE + (float)i * LUT_CONTROLLER_STEP;
+        lut->table[i] = limit(linearGain * x + cubicGain * x * x * x, lut->outputLimit);
+    }
+}
+
+void LutController_SetPoint(LutController* lut, uint8_t index, float correction)
+{
+    if (index < LUT_CONTROLLER_POINTS)
+    {
+        lut->table[index] = limit(correction, lut->outputLimit);
+    }
+}
+
+void LutController_SetKd(LutController* lut, float kd)
+{
+    lut->kd = kd;
+}
+
+void LutController_SetOutputLimit(LutController* lut, float outputLimit)
+{
+    lut->outputLimit = outputLimit;
+    LutController_SetCurve(lut, lut->linearGain, lut->cubicGain);
+}
+
+float LutController_Update(const LutController* lut, float position, float velocity)
+{
+    float x = (limit(position, LUT_CONTROLLER_RANGE) + LUT_CONTROLLER_RANGE) / LUT_CONTROLLER_STEP;
+    uint8_t index = (uint8_t)x;
+    if (index >= LUT_CONTROLLER_POINTS - 1u)
+    {
+        index = LUT_CONTROLLER_POINTS - 2u;
+    }
+    float fraction = x - (float)index;
+
+    float correction = lut->table[index] + fraction * (lut->table[index + 1u] - lut->table[index]);
+    correction += lut->kd * velocity;
+
+    return limit(correction, lut->outputLimit);
+}
+
+/* [] END OF FILE */
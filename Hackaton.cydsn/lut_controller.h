@@ -0,0 +1,54 @@
+#ifndef LUT_CONTROLLER_H
+#define LUT_CONTROLLER_H
+
+#ifdef __cplusplus
+extern "C" {
+#endif
+
+#include <stdint.h>
+#include <stdbool.h>
+
+// Lookup table steering: nonlinear proportional map plus velocity damping.
+//
+// Correction for line positions -3..+3 is stored at LUT_CONTROLLER_POINTS
+// evenly spaced points and linearly interpolated in between, so any shape of
+// the steering curve costs the same at runtime. The default curve
+//   table(x) = linearGain * x + cubicGain * x^3
+// steers gently near the centre and hard at the edges. Damping uses the line
+// estimator velocity: correction = table(position) + kd * velocity.
+
+#define LUT_CONTROLLER_POINTS       (25u)       // 0.25 position units apart, half the sensor spacing
+#define LUT_CONTROLLER_RANGE        (3.0f)      // Table covers -RANGE..+RANGE
+
+#define LUT_CONTROLLER_LINEAR_GAIN  (400.0f)
+#define LUT_CONTROLLER_CUBIC_GAIN   (40.0f)
+#define LUT_CONTROLLER_KD           (20.0f)
+
+typedef struct
+{
+    float table[LUT_CONTROLLER_POINTS];
+    float linearGain;       // Curve the table was last built from
+    float cubicGain;
+    float kd;
+    float outputLimit;
+} LutController;
+
+void LutController_Init(LutController* lut, float linearGain, float cubicGain, float kd, float outputLimit);
+
+// Rebuild the whole table from the polynomial curve
+void LutController_SetCurve(LutController* lut, float linearGain, float cubicGain);
+
+// Overwrite one table point (0 = -RANGE)
+void LutController_SetPoint(LutController* lut, uint8_t index, float correction);
+void LutController_SetKd(LutController* lut, float kd);
+
+// Change output limit, the table is rebuilt from the stored curve
+void LutController_SetOutputLimit(LutController* lut, float outputLimit);
+
+float LutController_Update(const LutController* lut, float position, float velocity);
+
+#ifdef __cplusplus
+}
+#endif
+
+#endif /* LUT_CONTROLLER_H */
@@ -2,7 +2,28 @@
 #include <stdlib.h>
 
 #include "car.h"
+#include "i2c_queue.h"
 #include "music.h"
+#include "scheduler.h"
+#include "pid.h"
+#include "line_position.h"
+#include "line_estimator.h"
+#include "wheel_speed.h"
+#include "wheel_mixer.h"
+#include "motion.h"
+#include "motor_calibration.h"
+#include "supervisor.h"
+#include "oscillation_detector.h"
+#include "sysid.h"
+#include "speed_governor.h"
+#include "autotune.h"
+#include "controller.h"
+#include "pure_pursuit.h"
+#include "lut_controller.h"
+#include "line_recovery.h"
+#include "track_features.h"
+#include "track_map.h"
+#include "telemetry.h"
 #include "cm4_common.h"
 
 // ===============================================================================
@@ -10,22 +31,58 @@
 // ===============================================================================
 
 // PID Gains - These values need tuning based on your robot's behavior
-#define PID_KP          500.0    // Proportional gain: responds to current error
-#define PID_KD          20    // Derivative gain: dampens oscillation
-#define PID_KI          0.0     // Integral gain: eliminates steady-state error'
-#define TANK_CORRECTION 600
-
-double pidKp = PID_KP;
-double pidKd = PID_KD;
-double pidKi = PID_KI;
-double tankCorrection = TANK_CORRECTION;
+#define PID_KP          500.0f   // Proportional gain: responds to current error
+#define PID_KD          20.0f    // Derivative gain: dampens oscillation
+#define PID_KI          0.0f     // Integral gain: eliminates steady-state error'
+#define PID_INTEGRAL_LIMIT 100.0f // Anti-windup limit of the integral
+// Kd was tuned with the old ~10 ms loop. At 2 ms an unfiltered sensor edge would give
+// 5x the D kick and saturate MAX_CORRECTION; filtering the error rate over 8 ms keeps
+// the first-tick D term at Kd * step / 10 ms, as before.
+#define PID_DERIVATIVE_FILTER_US 8000u
+
+// Steering correction becomes a curvature command, the motion layer mixes it to wheel speeds
+static Motion motion;
 
 // Motor control parameters
 #define BASE_SPEED      1000    // Base forward speed (range: -4000 to 4000)
 #define MAX_CORRECTION  2000    // Maximum steering correction value
 
 uint16_t baseSpeed = BASE_SPEED;
-uint16_t maxCorrection = MAX_CORRECTION;
+
+// Start flag
+bool startCar = false;
+bool motorsEnabled = false;
+
+// Motor commands are scaled by battery voltage (ECHO command 34)
+bool batteryCompensationEnabled = true;
+
+// Speed governor raises speed above baseSpeed on straights (baseSpeed is kept in corners)
+static SpeedGovernor speedGovernor;
+bool speedGovernorEnabled = false;
+
+// Wobbling around the line backs off the PID gains, then base speed (ECHO command 38)
+// Back-offs hold for one run, the tuned values come back at the next start
+static OscillationDetector oscillationDetector;
+bool oscillationBackoffEnabled = false;
+static float gainScale = 1.0f;      // Share of the tuned Kp, Kd left after back-offs
+static float tunedKp;               // Kp, Kd before the first back-off, valid while gainScale < 1
+static float tunedKd;
+static uint16_t tunedBaseSpeed = BASE_SPEED;                // Set by ECHO commands 0 and 17
+static float tunedMaxSpeed = SPEED_GOVERNOR_MAX_SPEED;
+
+// Task periods in scheduler ticks (1 tick = 1 ms SysTick)
+#define CONTROL_PERIOD_TICKS    2u     // Line following loop, 500 Hz
+#define WHEELS_PERIOD_TICKS     2u     // Wheel speed loop, limited by Motor_Move() I2C transfer time
+#define IPC_PERIOD_TICKS        1u     // Poll messages from CM0
+#define LEDS_PERIOD_TICKS       33u    // Track sensor mirror on LEDs, ~30 Hz
+#define TELEMETRY_PERIOD_TICKS  50u    // Control state and pose notifications in turn, 10 Hz each
+#define SYSID_PERIOD_TICKS      1u     // Capture download, one frame per run while CM0 keeps up
+#define TELEMETRY_COST_EVERY    20u    // Every 20th notification reports controller cost instead, 1 Hz
+#define TELEMETRY_SUPERVISOR_AT 10u    // ...and the 10th reports deadline supervisor statistics
+#define TELEMETRY_I2C_AT        4u     // ...and the 4th motor update bus time and I2C queue statistics
+
+// Control task must run within its period plus this slack, 5 misses in a row stop the motors
+#define SUPERVISOR_SLACK_US     2000u
 
 // int16_t abs(int16_t x) {
 //     return (x > 0) ? x : -x;   
@@ -38,10 +95,41 @@ int16_t sign(int16_t x) {
     return (x > 0) ? 1 : -1;  
 }
 
-// PID state variables
-static double lastError = 0.0;
-static double integral = 0.0;
-static uint32_t lastTime = 0;
+// Line following PID (gains, limits and state)
+static Pid linePid;
+
+// Alternative steering controllers, selectable at runtime (ECHO command 20)
+static PurePursuit purePursuit;
+static LutController lutController;
+static uint8_t pidControllerId = CONTROLLER_INVALID;
+
+// Last line position, tells on which side the line was lost
+static float lastPosition = 0.0f;
+
+// Brake and search when the line is lost for longer than a short gap
+static LineRecovery lineRecovery;
+bool lineRecoveryEnabled = true;
+
+// Continuous line position estimate, used instead of the raw weighted average when enabled
+static LineEstimator lineEstimator;
+bool lineEstimatorEnabled = false;
+
+// Latest control loop values, reported by the telemetry task
+static struct
+{
+    int16_t position;       // Line position x1000
+    int16_t correction;
+    int16_t leftSpeed;
+    int16_t rightSpeed;
+} controlSample;
+
+// Identification capture download (CM4_SYSID_DOWNLOAD), sent by the sysid task
+static struct
+{
+    bool statusPending;     // Status goes first, it tells the host sample count and period
+    uint16_t next;
+    uint16_t end;
+} sysidDownload;
 
 // bool biased = false;
 
@@ -51,45 +139,17 @@ static uint32_t lastTime = 0;
 // ===============================================================================
 // Returns: Position from -3000 (far left) to +3000 (far right), 0 = centered
 // Input: 7-bit value where each bit represents one sensor (1 = line detected)
-static double calculateLinePosition(uint8_t sensors)
+//
+// CRITICAL: Sensor weights must match physical layout! They live in line_position.c
+// and can be changed at runtime (ECHO commands 6..12), the position of every
+// sensor pattern is precomputed into a table so this is a single lookup.
+//
+// When line is to the LEFT:  negative position → turn LEFT
+// When line is to the RIGHT: positive position → turn RIGHT
+static float calculateLinePosition(uint8_t sensors)
 {
-    // CRITICAL: Sensor weights must match physical layout!
-    // Assuming sensors are numbered left to right:
-    // Sensor positions:  [0]   [1]   [2]   [3]   [4]   [5]   [6]
-    //                   LEFT  LEFT  LEFT CENTER RIGHT RIGHT RIGHT
-    // Weights (×1000):  -3000 -2000 -1000   0   +1000 +2000 +3000
-    //
-    // When line is to the LEFT:  negative position → turn LEFT
-    // When line is to the RIGHT: positive position → turn RIGHT
-    
-    static const double weights[7] = {-3.0, -2.0, -1.0, 0.0, 1.5, 2.5, 3.5};
-
-    double weightedSum = 0.0;
-    int activeCount = 0;
-
-    // Calculate weighted average of active sensors
-    for (uint8_t i = 0; i < 7; i++)
-    {
-        if (sensors & (1 << i))  // Check if sensor i detected the line (1 = black line)
-        {
-            weightedSum += weights[i];
-            activeCount++;
-        }
-    }
-
-    // Return weighted average (position)
-    // If no sensors detect line, return last known position
-    if (activeCount > 0)
-    {
-        // FIXED: Use double division to avoid integer truncation!
-        return (double)weightedSum / (double)activeCount;
-    }
-    else
-    {
-        // No line detected - use last error to guess direction
-        // If robot was turning left (negative error), assume line is still left
-        return (lastError < 0) ? -3.0 : 3.0;
-    }
+    // No line detected - LinePosition_Get() uses last position to guess direction
+    return LinePosition_Get(sensors, lastPosition);
 }
 
 
@@ -144,84 +204,248 @@ static double calculateLinePosition(uint8_t sensors)
 //    - Limits integral to ±100 to prevent it from growing too large
 //    - Without this, integral could accumulate during startup and cause huge overshoots
 //
-static int16_t pidControl(double error, uint32_t currentTime)
+// The arithmetic itself lives in pid.c (float or Q16.16, see PID_IMPLEMENTATION).
+//
+static int16_t pidControl(float error, uint64_t currentTime)
 {
-    // Calculate time difference in seconds
-    double deltaTime = (currentTime - lastTime) / 1000.0;
+    pid_value_t correction = Pid_Update(&linePid, PID_FROM_FLOAT(error), currentTime);
 
-    // Prevent division by zero on first iteration
-    if (deltaTime < 0.001)
+    return (int16_t)PID_TO_INT(correction);
+}
+
+// ===============================================================================
+// STEERING CONTROLLERS
+// ===============================================================================
+// Adapters that put the steering algorithms behind the Controller interface.
+// Registration order gives the controller ids used by ECHO command 20.
+
+static void pidControllerReset(void* context, uint64_t now)
+{
+    Pid_Reset((Pid*)context, now);
+}
+
+static float pidControllerUpdate(void* context, const ControllerInput* input)
+{
+    (void)context;
+    return (float)pidControl(input->position, input->now);
+}
+
+static float purePursuitUpdate(void* context, const ControllerInput* input)
+{
+    return PurePursuit_Update((const PurePursuit*)context, input->estimate, input->velocity, input->speed);
+}
+
+static float lutControllerUpdate(void* context, const ControllerInput* input)
+{
+    return LutController_Update((const LutController*)context, input->position, input->velocity);
+}
+
+static const Controller pidController = {
+    .name    = "pid",
+    .init    = NULL,
+    .reset   = pidControllerReset,
+    .update  = pidControllerUpdate,
+    .context = &linePid,
+};
+
+static const Controller purePursuitController = {
+    .name    = "pursuit",
+    .init    = NULL,
+    .reset   = NULL,
+    .update  = purePursuitUpdate,
+    .context = &purePursuit,
+};
+
+static const Controller lutControllerEntry = {
+    .name    = "lut",
+    .init    = NULL,
+    .reset   = NULL,
+    .update  = lutControllerUpdate,
+    .context = &lutController,
+};
+
+// Controller cost is measured in CPU cycles by the DWT cycle counter
+static uint32_t cycleCounter(void)
+{
+    return DWT->CYCCNT;
+}
+
+static void initControllers(void)
+{
+    CoreDebug->DEMCR |= CoreDebug_DEMCR_TRCENA_Msk;
+    DWT->CYCCNT = 0u;
+    DWT->CTRL |= DWT_CTRL_CYCCNTENA_Msk;
+
+    PurePursuit_Init(&purePursuit, PURE_PURSUIT_LOOKAHEAD, PURE_PURSUIT_PREDICT_TIME, MAX_CORRECTION);
+    LutController_Init(&lutController, LUT_CONTROLLER_LINEAR_GAIN, LUT_CONTROLLER_CUBIC_GAIN,
+                       LUT_CONTROLLER_KD, MAX_CORRECTION);
+
+    Controller_Init(cycleCounter);
+    pidControllerId = Controller_Register(&pidController);          // 0, active by default
+    (void)Controller_Register(&purePursuitController);              // 1
+    (void)Controller_Register(&lutControllerEntry);                 // 2
+}
+
+// ===============================================================================
+// AUTO-TUNING
+// ===============================================================================
+// Relay experiment finished: apply the computed gains to the live line PID and report them
+static void finishAutotune(uint64_t currentTime)
+{
+    const AutotuneResult* result = Autotune_GetResult();
+    enum autotuneState state = Autotune_GetState();
+
+    if (state == AUTOTUNE_DONE)
     {
-        deltaTime = 0.001;
+        Pid_SetGains(&linePid, result->kp, result->ki, result->kd);
+        Pid_Reset(&linePid, currentTime);
+        gainScale = 1.0f;
+        (void)Telemetry_SendAutotune(state, result->ku, result->tu,
+                                     (int16_t)result->kp, (int16_t)result->ki, (int16_t)result->kd);
     }
+    else
+    {
+        (void)Telemetry_SendAutotune(state, 0.0f, 0.0f, 0, 0, 0);
+    }
+}
 
-    // ============================================================================
-    // PROPORTIONAL TERM: Reacts to current error
-    // ============================================================================
-    // If error = +1000 (line is 1000 units to the right):
-    //   pTerm = 40 × 1000 = 40000
-    //   → This will slow down right motor, speed up left → turn right ✓
-    //
-    // If error = -1000 (line is 1000 units to the left):
-    //   pTerm = 40 × (-1000) = -40000
-    //   → This will slow down left motor, speed up right → turn left ✓
-    
-    double pTerm = pidKp * error;
+// ===============================================================================
+// OSCILLATION BACK-OFF
+// ===============================================================================
+// The line error cycles around the line: make the car calmer and report it.
+// PID gains go down first (other controllers have no gains to scale), base speed
+// when the gains are at their floor. Backed off values last until the next start,
+// see restoreTuning().
+static void backOffOscillation(void)
+{
+    enum oscillationAction action = OSCILLATION_ACTION_NONE;
 
-    // ============================================================================
-    // INTEGRAL TERM: Accumulates error over time
-    // ============================================================================
-    // Adds up error × time to catch persistent biases
-    // Example: If robot consistently runs 100 units right:
-    //   integral grows: 100 + 100 + 100 + ... = large value
-    //   iTerm adds permanent left correction to compensate
-    
-    integral += error * deltaTime;
+    if ((Controller_GetActive() == pidControllerId) &&
+        (gainScale * OSCILLATION_BACKOFF >= OSCILLATION_MIN_GAIN_SCALE))
+    {
+        if (gainScale >= 1.0f)
+        {
+            tunedKp = Pid_GetKp(&linePid);
+            tunedKd = Pid_GetKd(&linePid);
+        }
+        gainScale *= OSCILLATION_BACKOFF;
+        Pid_SetGains(&linePid, Pid_GetKp(&linePid) * OSCILLATION_BACKOFF, Pid_GetKi(&linePid),
+                     Pid_GetKd(&linePid) * OSCILLATION_BACKOFF);
+        action = OSCILLATION_ACTION_GAINS;
+    }
+    else if (baseSpeed > OSCILLATION_MIN_SPEED)
+    {
+        baseSpeed = (uint16_t)((float)baseSpeed * OSCILLATION_BACKOFF);
+        if (baseSpeed < OSCILLATION_MIN_SPEED)
+        {
+            baseSpeed = OSCILLATION_MIN_SPEED;
+        }
+        SpeedGovernor_SetSpeedRange(&speedGovernor, baseSpeed, speedGovernor.maxSpeed * OSCILLATION_BACKOFF);
+        TrackMap_SetSpeedRange(baseSpeed, speedGovernor.maxSpeed);
+        action = OSCILLATION_ACTION_SPEED;
+    }
 
-    // Anti-windup: Limit integral to prevent excessive accumulation
-    // Without this limit, integral could grow huge during sharp turns
-    if (integral > 100.0)  integral = 100.0;
-    if (integral < -100.0) integral = -100.0;
+    (void)Telemetry_SendOscillation(action, OscillationDetector_GetFrequency(&oscillationDetector),
+                                    OscillationDetector_GetAmplitude(&oscillationDetector),
+                                    (int16_t)Pid_GetKp(&linePid), (int16_t)Pid_GetKd(&linePid), (int16_t)baseSpeed);
+}
 
-    double iTerm = pidKi * integral;
+// Undo the back-offs of the last run. Gains set during the run (ECHO commands 2..4,
+// auto-tuning) reset gainScale and are kept as they are.
+static void restoreTuning(void)
+{
+    if (gainScale < 1.0f)
+    {
+        Pid_SetGains(&linePid, tunedKp, Pid_GetKi(&linePid), tunedKd);
+        gainScale = 1.0f;
+    }
+    baseSpeed = tunedBaseSpeed;
+    SpeedGovernor_SetSpeedRange(&speedGovernor, baseSpeed, tunedMaxSpeed);
+    TrackMap_SetSpeedRange(baseSpeed, speedGovernor.maxSpeed);
+}
 
+// ===============================================================================
+// SYSTEM IDENTIFICATION
+// ===============================================================================
+// Capture state for the host tool, also the first frame of every download
+static bool sendSysidStatus(void)
+{
+    return Telemetry_SendSysid(Sysid_GetState(), Sysid_GetSignal(), Sysid_GetCount(),
+                               Sysid_GetSamplePeriodUs(), (int16_t)Sysid_GetAmplitude(), (int16_t)baseSpeed);
+}
 
-    // ============================================================================
-    // DERIVATIVE TERM: Reacts to rate of change
-    // ============================================================================
-    // Calculates how fast error is changing
-    // If error is decreasing (we're correcting successfully):
-    //   → Derivative is negative → reduces total correction (prevents overshoot)
-    // If error is increasing (we're going more off-track):
-    //   → Derivative is positive → increases total correction (aggressive fix)
-    //
-    // Example with Kd = 20:
-    //   Previous error = 1000, current error = 500, deltaTime = 0.01s
-    //   dTerm = 20 × (500 - 1000) / 0.01 = 20 × (-500) / 0.01 = -1,000,000
-    //   → Large negative D-term reduces correction (we're getting closer, don't overshoot!)
-    
-    double dTerm = pidKd * (error - lastError) / deltaTime;
+// ===============================================================================
+// LOST LINE RECOVERY
+// ===============================================================================
+// Report recovery result and restart control loops once the line is found again.
+// Returns true while the recovery drives the wheels instead of the controller
+// (also after a failed search, which stops the car).
+static bool recoverLine(uint8_t sensors, uint64_t currentTime)
+{
+    enum lineRecoveryEvent event = LineRecovery_Update(&lineRecovery, sensors, lastPosition, currentTime);
+    const LineRecoveryStats* stats = LineRecovery_GetStats(&lineRecovery);
 
-    // ============================================================================
-    // COMBINE ALL THREE TERMS
-    // ============================================================================
-    // Total correction = P + I + D
-    // P: reacts to current position
-    // I: corrects for persistent bias
-    // D: smooths the response and prevents oscillation
-    
-    double correction = pTerm + iTerm + dTerm;
+    switch (event)
+    {
+        case LINE_RECOVERY_EVENT_LOST:
+            // Relay experiment and identification capture are meaningless without the line
+            Autotune_Abort();
+            Sysid_Abort();
+            (void)Telemetry_SendEvent(TELEMETRY_EVENT_LINE_LOST, (lastPosition < 0.0f) ? -1 : 1);
+            break;
+        case LINE_RECOVERY_EVENT_REACQUIRED:
+            // Derivative and governor history are from before the loss
+            lastPosition = LinePosition_Get(sensors, lastPosition);
+            Pid_Reset(&linePid, currentTime);
+            Controller_Reset(currentTime);
+            LineEstimator_Reset(&lineEstimator, sensors, lastPosition, currentTime);
+            SpeedGovernor_Reset(&speedGovernor, currentTime);
+            Motion_Reset(&motion, currentTime);
+            OscillationDetector_Reset(&oscillationDetector, currentTime);
+            (void)Telemetry_SendRecovery(event, stats->recoveries, stats->failures,
+                                         stats->lastReacquireUs, stats->maxReacquireUs);
+            break;
+        case LINE_RECOVERY_EVENT_FAILED:
+            motorsEnabled = false;
+            Supervisor_SetArmed(false);
+            WheelSpeed_Stop();
+            (void)Telemetry_SendRecovery(event, stats->recoveries, stats->failures,
+                                         stats->lastReacquireUs, stats->maxReacquireUs);
+            break;
+        default:
+            break;
+    }
+
+    if (!LineRecovery_IsActive(&lineRecovery))
+    {
+        return false;
+    }
 
-    // Limit correction to prevent excessive steering
-    // MAX_CORRECTION = 1500, so correction is clamped to [-1500, +1500]
-    if (correction > maxCorrection)  correction = maxCorrection;
-    if (correction < -maxCorrection) correction = -maxCorrection;
+    int16_t leftSpeed;
+    int16_t rightSpeed;
+    LineRecovery_GetWheelTargets(&lineRecovery, &leftSpeed, &rightSpeed);
+    WheelSpeed_SetTarget(leftSpeed, rightSpeed);
 
-    // Update state variables for next iteration
-    lastError = error;
-    lastTime = currentTime;
+    controlSample.correction = 0;
+    controlSample.leftSpeed = leftSpeed;
+    controlSample.rightSpeed = rightSpeed;
+    return true;
+}
+
+// ===============================================================================
+// TRACK FEATURES
+// ===============================================================================
+// Distance travelled by the car centre in encoder counts
+static int32_t travelledDistance(void)
+{
+    return (Encoder_GetCount(WHEEL_LEFT) + Encoder_GetCount(WHEEL_RIGHT)) / 2;
+}
 
-    return (int16_t)correction;
+// Report every detected track feature with lap and segment timing
+static void reportTrackFeature(const TrackFeatureEvent* event)
+{
+    (void)Telemetry_SendTrackFeature((uint8_t)event->feature, event->lap, event->segment,
+                                     event->lapTime, event->lastLapTime);
 }
 
 // ===============================================================================
@@ -233,8 +457,29 @@ static void followLine(void)
     // Read 7 track sensors (returns 7-bit value)
     uint8_t sensors = Track_Read();
 
+    // Get current time for PID calculation
+    uint64_t currentTime = Timing_GetMicroseconds();
+
+    // Crossings, start/finish marks, junctions and line ends from the sensor history
+    TrackFeatures_Update(sensors, currentTime);
+
+    // Line lost for longer than a gap: brake and search instead of steering
+    if (lineRecoveryEnabled && recoverLine(sensors, currentTime))
+    {
+        return;
+    }
+
     // Calculate line position: -3000 (left) to +3000 (right), 0 = centered
-    double position = calculateLinePosition(sensors);
+    float position = calculateLinePosition(sensors);
+
+    // Continuous estimate is always tracked (pure pursuit needs it), it replaces
+    // the discrete sensor position only when enabled
+    float estimate = LineEstimator_Update(&lineEstimator, sensors, position, currentTime);
+    if (lineEstimatorEnabled)
+    {
+        position = estimate;
+    }
+    lastPosition = position;
 
     // ============================================================================
     // CRITICAL: Error Calculation
@@ -253,50 +498,95 @@ static void followLine(void)
     //   → Need to turn LEFT to center the line
     //   → Left motor slows down, right motor speeds up
     
-    double error = position - 0;  // Target position is 0 (center)
+    float error = position - 0;  // Target position is 0 (center)
 
-    // Get current time for PID calculation
-    uint32_t currentTime = Timing_GetMillisecongs();
+    // Learn the track on the first lap, plan speed ahead on the next ones
+    // (by encoder distance, by segment duration while the encoders are missing)
+    TrackMap_Update(error, travelledDistance(), currentTime);
+
+    // Limit cycle in the error: back off gains or speed (relay and excitation oscillate on purpose)
+    if (oscillationBackoffEnabled && !Autotune_IsRunning() && !Sysid_IsRunning() &&
+        OscillationDetector_Update(&oscillationDetector, error, currentTime))
+    {
+        backOffOscillation();
+    }
+
+    // Base speed adapts to the track when the governor is enabled, a learned map takes precedence
+    int16_t speed = baseSpeed;
+    if (!Autotune_IsRunning() && !Sysid_IsRunning())
+    {
+        if (TrackMap_IsPlanning())
+        {
+            speed = (int16_t)TrackMap_GetSpeed();
+        }
+        else if (speedGovernorEnabled)
+        {
+            speed = (int16_t)SpeedGovernor_Update(&speedGovernor, error, currentTime);
+        }
+    }
 
-    // Calculate steering correction using PID
-    int16_t correction = pidControl(error, currentTime);
+    ControllerInput input = {
+        .sensors  = sensors,
+        .position = error,
+        .estimate = estimate,
+        .velocity = LineEstimator_GetVelocity(&lineEstimator),
+        .speed    = (float)speed,
+        .now      = currentTime,
+    };
+
+    // Calculate steering correction with the active controller (relay while auto-tuning,
+    // excitation added on top during an identification capture)
+    int16_t correction;
+    if (Autotune_IsRunning())
+    {
+        correction = (int16_t)Autotune_Update(error, currentTime);
+        if (!Autotune_IsRunning())
+        {
+            finishAutotune(currentTime);
+            correction = (int16_t)Controller_Update(&input);
+        }
+    }
+    else
+    {
+        correction = (int16_t)Controller_Update(&input);
+        if (Sysid_IsRunning())
+        {
+            correction = (int16_t)Sysid_Update(error, (float)correction);
+            if (!Sysid_IsRunning())
+            {
+                (void)sendSysidStatus();
+            }
+        }
+    }
 
     // ============================================================================
-    // Apply differential steering:
+    // Apply steering through the motion layer:
     // ============================================================================
     //
-    // LEFT MOTOR  = BASE_SPEED - correction
-    // RIGHT MOTOR = BASE_SPEED + correction
+    // LEFT MOTOR  = centre * (1 + curvature)
+    // RIGHT MOTOR = centre * (1 - curvature), curvature = correction / speed
     //
     // WHY THIS WAY:
     // If correction is POSITIVE (line is to the right, need to turn right):
-    //   → Left motor:  BASE_SPEED - (+correction) = FASTER
-    //   → Right motor: BASE_SPEED + (+correction) = SLOWER
+    //   → Left motor FASTER, right motor SLOWER
     //   → Result: Robot turns RIGHT ✓
     //
-    // If correction is NEGATIVE (line is to the left, need to turn left):
-    //   → Left motor:  BASE_SPEED - (-correction) = SLOWER
-    //   → Right motor: BASE_SPEED + (-correction) = FASTER
-    //   → Result: Robot turns LEFT ✓
-    int16_t leftSpeed = 0;
-    int16_t rightSpeed = 0;
-
-    if (abs(correction) < tankCorrection) {
-        leftSpeed = baseSpeed + correction;
-        rightSpeed = baseSpeed - correction;
-    } else {
-        leftSpeed = (baseSpeed + abs(correction)) * sign(correction);
-        rightSpeed = -(baseSpeed + abs(correction)) * sign(correction);
-    }
-
-    // Constrain speeds to valid range
-    if (leftSpeed > 4000)   leftSpeed = 4000;
-    if (leftSpeed < -4000)  leftSpeed = -4000;
-    if (rightSpeed > 4000)  rightSpeed = 4000;
-    if (rightSpeed < -4000) rightSpeed = -4000;
-
-    // Set motor speeds: Motor_Move(left_front, left_back, right_front, right_back)
-    Motor_Move(-leftSpeed, -leftSpeed, -rightSpeed, -rightSpeed);
+    // Small corrections give plain differential steering (speed +- correction).
+    // Once the correction exceeds the speed the inner wheel reverses, so sharp
+    // corners turn into a pivot gradually instead of switching to a tank mode.
+    // Sides stay within +-4000 with the curvature kept.
+    MotionWheels wheels = Motion_Update(&motion, (float)speed,
+                                        Motion_CorrectionToCurvature((float)speed, (float)correction), currentTime);
+    int16_t leftSpeed = (int16_t)wheels.left;
+    int16_t rightSpeed = (int16_t)wheels.right;
+
+    // Command wheel speeds, the wheel speed loop drives the motors
+    WheelSpeed_SetTarget(leftSpeed, rightSpeed);
+
+    controlSample.position = (int16_t)(position * 1000.0f);
+    controlSample.correction = correction;
+    controlSample.leftSpeed = leftSpeed;
+    controlSample.rightSpeed = rightSpeed;
 }
 
 /* Implement ISR for I2C_1 */
@@ -319,10 +609,14 @@ ipc_msg_t ipcMsgForCM0 = {               /* IPC structure to be sent to CM0 */
 
 static void processIncomingIPCMessage(ipc_msg_t* msg);
 static void processCM4Command(enum cm4CommandList cmd);
-
-// Start flag
-bool startCar = false;
-bool motorsEnabled = false;
+static void enableMotors(void);
+static void ipcTask(void);
+static void controlTask(void);
+static void wheelsTask(void);
+static void ledsTask(void);
+static void telemetryTask(void);
+static void sysidTask(void);
+static uint32_t schedulerClock(void);
 
 int main(void)
 {
@@ -338,6 +632,9 @@ int main(void)
     NVIC_EnableIRQ(I2C_Main_SCB_IRQ_cfg.intrSrc);
     Cy_SCB_I2C_Enable(I2C_Main_HW);
 
+    // Drivers queue their transfers, the bus works from the I2C interrupt
+    I2cQueue_InitScb();
+
     // Enable global interrupts.
     __enable_irq();
 
@@ -347,8 +644,9 @@ int main(void)
     // Initialize SPI LED controller
     (void)Leds_Init();
 
-    // Initialize driver that controls motors
+    // Initialize driver that controls motors, linearized by the calibration tables in flash
     Motor_Init();
+    MotorCalibration_Init();
 
     // Initialize sound driver
     Sound_Init();
@@ -359,6 +657,16 @@ int main(void)
     //Initialize timing driver
     Timing_Init();
 
+    // Initialize wheel encoders and the wheel speed loop
+    Encoder_Init();
+    WheelSpeed_Init();
+
+    // Dead-reckoning pose from the encoders, integrated at SysTick rate
+    Odometry_Init();
+
+    // Battery voltage through the divider on A1 (P10[1]), sampled by the LED task
+    Battery_Init();
+
     // Turn on LEDs on PSoC6 board
     Cy_GPIO_Clr(LEDG_0_PORT, LEDG_0_NUM); //green LED
     Cy_GPIO_Clr(LEDR_0_PORT, LEDR_0_NUM); //red LED
@@ -391,8 +699,25 @@ int main(void)
     uint32_t timeout = Timing_GetMillisecongs();
     uint32_t cycle = 0;
 
-    // Initialize PID timer
-    lastTime = Timing_GetMillisecongs();
+    // Precompute line position of every sensor pattern
+    LinePosition_Init();
+    LineEstimator_Init(&lineEstimator, LINE_ESTIMATOR_ALPHA, LINE_ESTIMATOR_BETA);
+    LineRecovery_Init(&lineRecovery);
+    TrackFeatures_Init();
+    (void)TrackFeatures_Subscribe(reportTrackFeature);
+    TrackMap_Init();
+    TrackMap_SetSpeedRange(baseSpeed, SPEED_GOVERNOR_MAX_SPEED);
+    SpeedGovernor_Init(&speedGovernor, baseSpeed, SPEED_GOVERNOR_MAX_SPEED);
+    Motion_Init(&motion);
+    OscillationDetector_Init(&oscillationDetector);
+
+    // Initialize line following PID and its timer
+    Pid_Init(&linePid, PID_KP, PID_KI, PID_KD, PID_INTEGRAL_LIMIT, MAX_CORRECTION);
+    Pid_SetDerivativeFilter(&linePid, PID_DERIVATIVE_FILTER_US);
+    Pid_Reset(&linePid, Timing_GetMicroseconds());
+
+    // Register steering controllers, PID is active until ECHO command 20 selects another
+    initControllers();
 
     // Then execute remaining code
     Leds_FillSolidColor(0, 0, 0);
@@ -404,60 +729,198 @@ int main(void)
     }
 
     // MAIN LOOP
+    // Tasks are executed by the scheduler at fixed rates driven by SysTick.
+    // Order matters: the first task added has the highest priority.
+    Supervisor_Init(CONTROL_PERIOD_TICKS * 1000u, SUPERVISOR_SLACK_US);
+    Scheduler_Init(schedulerClock);
+    (void)Scheduler_AddTask("control", controlTask, CONTROL_PERIOD_TICKS);
+    (void)Scheduler_AddTask("wheels", wheelsTask, WHEELS_PERIOD_TICKS);
+    (void)Scheduler_AddTask("ipc", ipcTask, IPC_PERIOD_TICKS);
+    (void)Scheduler_AddTask("leds", ledsTask, LEDS_PERIOD_TICKS);
+    (void)Scheduler_AddTask("telemetry", telemetryTask, TELEMETRY_PERIOD_TICKS);
+    (void)Scheduler_AddTask("sysid", sysidTask, SYSID_PERIOD_TICKS);
+    Cy_SysTick_SetCallback(1, Scheduler_Tick);
+
     for(;;)
     {
-        // Check for new messages from CM0 core and process them. This is the most important task.
-        if (CM4_isDataAvailableFromCM0()) {
-            processIncomingIPCMessage(CM4_GetCM0Message());
+        Scheduler_Run();
+    }
+}
+
+// Check for new messages from CM0 core and process them.
+static void ipcTask(void)
+{
+    if (CM4_isDataAvailableFromCM0()) {
+        processIncomingIPCMessage(CM4_GetCM0Message());
+    }
+
+    // One-shot telemetry CM0 was too busy to take when it was sent
+    Telemetry_Flush();
+}
+
+// ========================================================================
+// LINE FOLLOWING - Execute PID control (only if motors enabled)
+// ========================================================================
+static void controlTask(void)
+{
+    Supervisor_Kick();
+
+    // Loop stalled and the supervisor stopped the motors, stay stopped until the next start
+    if (motorsEnabled && Supervisor_IsSafeStopped())
+    {
+        SupervisorStats stats;
+        Supervisor_GetStats(&stats);
+        motorsEnabled = false;
+        Supervisor_SetArmed(false);
+        Autotune_Abort();
+        Sysid_Abort();
+        (void)Telemetry_SendEvent(TELEMETRY_EVENT_SAFE_STOP, (int32_t)stats.maxLatenessUs);
+    }
+
+    if (MotorCalibration_IsRunning())
+    {
+        // Sweep drives the motors itself
+        if (!MotorCalibration_Update(Timing_GetMicroseconds()))
+        {
+            int16_t deadband[MOTOR_COUNT];
+            for (uint8_t motor = 0; motor < MOTOR_COUNT; motor++)
+            {
+                deadband[motor] = MotorCalibration_GetDeadband(motor);
+            }
+            (void)Telemetry_SendCalibration(MotorCalibration_GetState(), deadband,
+                                            MotorCalibration_GetFullScaleSpeed());
         }
- 
-        // ========================================================================
-        // LINE FOLLOWING - Execute PID control (only if motors enabled)
-        // ========================================================================
-        if (motorsEnabled)
+    }
+    else if (motorsEnabled)
+    {
+        followLine();
+    }
+    else
+    {
+        // Motors disabled - ensure they're stopped
+        WheelSpeed_Stop();
+    }
+}
+
+// Wheel speed loop - follow wheel speeds commanded by followLine
+static void wheelsTask(void)
+{
+    if (motorsEnabled)
+    {
+        // Lost line: short the motors for the brake phase, the wheel loop drives the search
+        if (lineRecoveryEnabled && (LineRecovery_GetState(&lineRecovery) == LINE_RECOVERY_BRAKE))
         {
-            followLine();
+            Motor_Brake();
         }
         else
         {
-            // Motors disabled - ensure they're stopped
-            Motor_Move(0, 0, 0, 0);
+            WheelSpeed_Update(Timing_GetMicroseconds());
         }
+    }
+}
 
+// Duplicate track sensor on Smart LEDs
+static void ledsTask(void)
+{
+    uint8_t track = Track_Read();
+    for (uint8_t i=0; i<7u; i++)
+    {
+        Leds_PutPixel(i,track & 0x01u ? 0x55u : 0x00u, 0x00u, 0x00u);
+        track = track >> 1;
+    }
 
-        // Blink Reg and blue LEDs based on timer
-        //if((Timing_GetMillisecongs() - timeout) > 1000u)
-        //{
-        //    if (cycle == 0u)
-        //    {
-        //        Leds_PutPixel(7u, 0x00u, 0x55u, 0x00u);
-        //        Leds_PutPixel(10u, 0x00u, 0x00u, 0x55u);
-        //        cycle++;
-        //    }
-        //    else
-        //    {
-        //        Leds_PutPixel(7u, 0x00u, 0x00u, 0x55u);
-        //        Leds_PutPixel(10u, 0x00u, 0x55u, 0x00u);
-        //        cycle = 0;
-        //    }
-        //    timeout = Timing_GetMillisecongs();
-        //}
-
-        // Duplicate track sensor on Smart LEDs
-        uint8_t track = Track_Read();
-        for (uint8_t i=0; i<7u; i++)
-        {
-            Leds_PutPixel(i,track & 0x01u ? 0x55u : 0x00u, 0x00u, 0x00u);
-            track = track >> 1;
-        }
+    // Battery divider shares the LED data wire: sample it before the refresh, while the
+    // strip is quiet, then keep motor authority constant as the pack discharges
+    uint64_t now = Timing_GetMicroseconds();
+    if (Leds_IsIdle())
+    {
+        Battery_Update(now);
+    }
+    Motor_SetScale(batteryCompensationEnabled ? Battery_GetMotorScale(now) : 1.0f);
 
+    Leds_Update();
+}
+
+// Report latest control loop state over BLE
+static void telemetryTask(void)
+{
+    static uint8_t count = 0;
 
-        Leds_Update();
+    if (motorsEnabled)
+    {
+        count++;
+        if (count >= TELEMETRY_COST_EVERY)
+        {
+            // Cost of the active controller, one frame per period fits the BLE relay
+            uint8_t id = Controller_GetActive();
+            const ControllerCost* cost = Controller_GetCost(id);
+            count = 0;
+            if (cost != NULL)
+            {
+                (void)Telemetry_SendControllerCost(id, cost->lastCycles, cost->maxCycles,
+                                                   Controller_GetMeanCycles(id));
+            }
+        }
+        else if (count == TELEMETRY_SUPERVISOR_AT)
+        {
+            SupervisorStats stats;
+            Supervisor_GetStats(&stats);
+            (void)Telemetry_SendSupervisor(stats.missed, stats.maxLatenessUs, stats.maxConsecutive,
+                                           stats.safeStopped, stats.watchdogReset);
+        }
+        else if (count == TELEMETRY_I2C_AT)
+        {
+            I2cQueue_Stats stats;
+            uint32_t lastUs;
+            uint32_t maxUs;
+            I2cQueue_GetStats(&stats);
+            Motor_GetBusTime(&lastUs, &maxUs);
+            (void)Telemetry_SendI2c((uint16_t)lastUs, (uint16_t)maxUs, stats.transactions, (uint16_t)stats.errors,
+                                    (uint16_t)stats.full, stats.maxDepth);
+        }
+        else if ((count & 1u) != 0u)
+        {
+            Odometry_Pose pose;
+            Odometry_GetPose(&pose);
+            (void)Telemetry_SendPose(pose.x, pose.y, pose.heading, pose.distance);
+        }
+        else
+        {
+            (void)Telemetry_SendControl(controlSample.position, controlSample.correction,
+                                        controlSample.leftSpeed, controlSample.rightSpeed);
+        }
+    }
+}
 
-        CyDelay(10);  // Reduced delay for faster PID loop (100Hz update rate)
+// Identification capture download, one frame per run. A frame CM0 has not taken
+// yet is tried again next run; frames lost on BLE are requested again by the host.
+static void sysidTask(void)
+{
+    if (sysidDownload.statusPending)
+    {
+        if (sendSysidStatus())
+        {
+            sysidDownload.statusPending = false;
+        }
+    }
+    else if (sysidDownload.next < sysidDownload.end)
+    {
+        uint16_t remaining = sysidDownload.end - sysidDownload.next;
+        uint8_t samples = (remaining >= 2u) ? 2u : 1u;
+        if (Telemetry_SendSysidData(sysidDownload.next, Sysid_GetSample(sysidDownload.next),
+                                    (uint8_t)(samples * SYSID_CHANNELS)))
+        {
+            sysidDownload.next += samples;
+        }
     }
 }
 
+// Scheduler statistics are measured in microseconds
+static uint32_t schedulerClock(void)
+{
+    return (uint32_t)Timing_GetMicroseconds();
+}
+
 static void processIncomingIPCMessage(ipc_msg_t* msg)
 {
     // In general, impossible situation, but never trust anyone.
@@ -495,14 +958,25 @@ static void processCM4Command(enum cm4CommandList cmd)
     {
         case CM4_COMMAND_START_CAR:
         {
-            startCar = true;
-            motorsEnabled = true;
+            enableMotors();
+            (void)Telemetry_SendEvent(TELEMETRY_EVENT_CAR_STARTED, 0);
             break;
         }
         case CM4_COMMAND_STOP_CAR:
         {
             motorsEnabled = false;
-            Motor_Move(0, 0, 0, 0);
+            Supervisor_SetArmed(false);
+            Autotune_Abort();
+            Sysid_Abort();
+            MotorCalibration_Abort();
+            WheelSpeed_Stop();
+            (void)Telemetry_SendEvent(TELEMETRY_EVENT_CAR_STOPPED, 0);
+
+            // Flash write blocks the CPU, so a newly learned map is saved only with motors stopped
+            if (TrackMap_IsDirty() && TrackMap_Save())
+            {
+                (void)Telemetry_SendEvent(TELEMETRY_EVENT_TRACK_MAP_SAVED, TrackMap_GetSegmentCount());
+            }
             break;
         }
         case CM4_COMMAND_ECHO:
@@ -519,23 +993,230 @@ static void processCM4Command(enum cm4CommandList cmd)
                 {
                     case 0:
                         baseSpeed = value;
+                        tunedBaseSpeed = baseSpeed;
+                        SpeedGovernor_SetSpeedRange(&speedGovernor, baseSpeed, speedGovernor.maxSpeed);
+                        TrackMap_SetSpeedRange(baseSpeed, speedGovernor.maxSpeed);
                         break;
                     case 1:
-                        maxCorrection = value;
+                        Pid_SetOutputLimit(&linePid, (float)value);
+                        PurePursuit_SetOutputLimit(&purePursuit, (float)value);
+                        LutController_SetOutputLimit(&lutController, (float)value);
                         break;
                     case 2:
-                        pidKp = (double)value;
+                        Pid_SetGains(&linePid, (float)value, Pid_GetKi(&linePid), Pid_GetKd(&linePid));
+                        gainScale = 1.0f;
                         break;
                     case 3:
-                        pidKd = (double)value;
+                        Pid_SetGains(&linePid, Pid_GetKp(&linePid), Pid_GetKi(&linePid), (float)value);
+                        gainScale = 1.0f;
                         break;
                     case 4:
-                        pidKi = (double)value;
+                        Pid_SetGains(&linePid, Pid_GetKp(&linePid), (float)value, Pid_GetKd(&linePid));
+                        gainScale = 1.0f;
                         break;
                     case 5:
-                        tankCorrection = (double)value;
+                        // Centre speed reduction with curvature x1000 (0 = plain differential steering)
+                        Motion_SetMixing(&motion, (float)value / 1000.0f, motion.maxCurvature);
+                        break;
+                    case 6: case 7: case 8: case 9: case 10: case 11: case 12:
+                        // Sensor weight x1000, sensor 0 (leftmost) is command 6
+                        LinePosition_SetWeight(command - 6u, (float)value / 1000.0f);
+                        break;
+                    case 13:
+                        LinePosition_SetNoLinePolicy((enum lineNoLinePolicy)value);
+                        break;
+                    case 14:
+                        lineEstimatorEnabled = (value != 0);
+                        break;
+                    case 15:
+                        // Closed loop needs the encoders
+                        WheelSpeed_SetClosedLoop((value != 0) && Encoder_IsAvailable());
+                        break;
+                    case 16:
+                        speedGovernorEnabled = (value != 0);
+                        break;
+                    case 17:
+                        tunedMaxSpeed = (float)value;
+                        SpeedGovernor_SetSpeedRange(&speedGovernor, baseSpeed, tunedMaxSpeed);
+                        TrackMap_SetSpeedRange(baseSpeed, speedGovernor.maxSpeed);
+                        break;
+                    case 18:
+                        SpeedGovernor_SetLimits(&speedGovernor, (float)value, speedGovernor.deceleration);
+                        break;
+                    case 19:
+                        // Deceleration x10 to fit int16
+                        SpeedGovernor_SetLimits(&speedGovernor, speedGovernor.acceleration, (float)value * 10.0f);
+                        break;
+                    case 20:
+                        if (Controller_Select((uint8_t)value, Timing_GetMicroseconds()))
+                        {
+                            (void)Telemetry_SendEvent(TELEMETRY_EVENT_CONTROLLER_SELECTED, value);
+                        }
+                        break;
+                    case 21:
+                        // Lookahead in mm
+                        PurePursuit_SetLookahead(&purePursuit, (float)value / 1000.0f);
+                        break;
+                    case 22:
+                        // Prediction time in ms
+                        PurePursuit_SetPredictTime(&purePursuit, (float)value / 1000.0f);
+                        break;
+                    case 23:
+                        LutController_SetCurve(&lutController, (float)value, lutController.cubicGain);
+                        break;
+                    case 24:
+                        LutController_SetCurve(&lutController, lutController.linearGain, (float)value);
                         break;
+                    case 25:
+                        LutController_SetKd(&lutController, (float)value);
+                        break;
+                    case 26:
+                        lineRecoveryEnabled = (value != 0);
+                        LineRecovery_Reset(&lineRecovery, Timing_GetMicroseconds());
+                        break;
+                    case 27:
+                        LineRecovery_SetSearch(&lineRecovery, value, lineRecovery.sweepTime);
+                        break;
+                    case 28:
+                        // First sweep time in ms
+                        LineRecovery_SetSearch(&lineRecovery, lineRecovery.searchSpeed, (uint32_t)value * 1000u);
+                        break;
+                    case 29:
+                        TrackMap_SetPlanning(value != 0);
+                        break;
+                    case 30:
+                        // Forget the learned track (flash write, only while stopped)
+                        if (!motorsEnabled)
+                        {
+                            (void)TrackMap_Clear();
+                        }
+                        break;
+                    case 31:
+                        WheelMixer_SetEnabled(value != 0);
+                        break;
+                    case 32:
+                        // Front share increase in tank turns x1000
+                        WheelMixer_SetTankSplit((float)value / 1000.0f);
+                        break;
+                    case 33:
+                        MotorCalibration_SetEnabled(value != 0);
+                        break;
+                    case 34:
+                        batteryCompensationEnabled = (value != 0);
+                        break;
+                    case 35:
+                        // Maximal curvature x100
+                        Motion_SetMixing(&motion, motion.speedReduction, (float)value / 100.0f);
+                        break;
+                    case 36:
+                        Motion_SetRateLimits(&motion, (float)value * 10.0f, motion.curvatureRate);
+                        break;
+                    case 37:
+                        Motion_SetRateLimits(&motion, motion.speedRate, (float)value);
+                        break;
+                    case 38:
+                        oscillationBackoffEnabled = (value != 0);
+                        OscillationDetector_Reset(&oscillationDetector, Timing_GetMicroseconds());
+                        break;
+                    case 39:
+                        // Minimal oscillation frequency x10 Hz
+                        OscillationDetector_SetThresholds(&oscillationDetector, (float)value / 10.0f,
+                                                          oscillationDetector.minAmplitude);
+                        break;
+                    case 40:
+                        // Minimal oscillation amplitude x1000 (line position units)
+                        OscillationDetector_SetThresholds(&oscillationDetector, oscillationDetector.minFrequency,
+                                                          (float)value / 1000.0f);
+                        break;
+                }
+            }
+            break;
+        }
+        case CM4_COMMAND_AUTOTUNE:
+        {
+            ipc_msg_t* msg = CM4_GetCM0Message();
+            int16_t relayAmplitude = 0;
+            enum autotuneRule rule = AUTOTUNE_RULE_PD;
+
+            if (msg->len >= 3)
+            {
+                relayAmplitude = (int16_t)((uint16_t)(msg->buffer[1]) | ((uint16_t)(msg->buffer[2]) << 8));
+            }
+            if (msg->len >= 4)
+            {
+                rule = (enum autotuneRule)msg->buffer[3];
+            }
+
+            // The relay experiment tunes the line PID and runs on the track, so start the car with it
+            Sysid_Abort();
+            (void)Controller_Select(pidControllerId, Timing_GetMicroseconds());
+            enableMotors();
+            Autotune_Start((float)relayAmplitude, rule, Timing_GetMicroseconds());
+            (void)Telemetry_SendEvent(TELEMETRY_EVENT_AUTOTUNE_STARTED, relayAmplitude);
+            break;
+        }
+        case CM4_COMMAND_CALIBRATE:
+        {
+            // Sweep runs with the car stopped (on a stand), from the control task, and measures with the encoders
+            if (!motorsEnabled && Encoder_IsAvailable())
+            {
+                startCar = true;
+                MotorCalibration_Start(Timing_GetMicroseconds());
+                (void)Telemetry_SendEvent(TELEMETRY_EVENT_CALIBRATION_STARTED, 0);
+            }
+            break;
+        }
+        case CM4_COMMAND_SYSID:
+        {
+            ipc_msg_t* msg = CM4_GetCM0Message();
+            uint8_t request = (msg->len >= 2) ? msg->buffer[1] : CM4_SYSID_START;
+
+            if (request == CM4_SYSID_START)
+            {
+                enum sysidSignal signal = SYSID_SIGNAL_CHIRP;
+                int16_t amplitude = 0;
+                if (msg->len >= 3)
+                {
+                    signal = (enum sysidSignal)msg->buffer[2];
+                }
+                if (msg->len >= 5)
+                {
+                    amplitude = (int16_t)((uint16_t)(msg->buffer[3]) | ((uint16_t)(msg->buffer[4]) << 8));
                 }
+
+                // Capture runs on the track, the active controller keeps the car on the line
+                Autotune_Abort();
+                sysidDownload.statusPending = false;
+                sysidDownload.end = sysidDownload.next;
+                enableMotors();
+                Sysid_Start(signal, (float)amplitude, CONTROL_PERIOD_TICKS * 1000u);
+                (void)Telemetry_SendEvent(TELEMETRY_EVENT_SYSID_STARTED, (int32_t)Sysid_GetAmplitude());
+            }
+            else if (request == CM4_SYSID_DOWNLOAD)
+            {
+                // Samples are sent only from a finished capture, the status frame tells the host when
+                uint16_t recorded = Sysid_IsRunning() ? 0u : Sysid_GetCount();
+                uint16_t first = 0u;
+                uint16_t samples = 0u;
+                if (msg->len >= 4)
+                {
+                    first = (uint16_t)(msg->buffer[2]) | ((uint16_t)(msg->buffer[3]) << 8);
+                }
+                if (msg->len >= 6)
+                {
+                    samples = (uint16_t)(msg->buffer[4]) | ((uint16_t)(msg->buffer[5]) << 8);
+                }
+                if (first > recorded)
+                {
+                    first = recorded;
+                }
+                if ((samples == 0u) || (samples > recorded - first))
+                {
+                    samples = recorded - first;
+                }
+                sysidDownload.next = first;
+                sysidDownload.end = first + samples;
+                sysidDownload.statusPending = true;
             }
             break;
         }
@@ -544,4 +1225,29 @@ static void processCM4Command(enum cm4CommandList cmd)
     }
 }
 
+// Start driving: clear state of all control loops
+static void enableMotors(void)
+{
+    uint64_t now = Timing_GetMicroseconds();
+
+    MotorCalibration_Abort();
+    Supervisor_Rearm();
+    Supervisor_SetArmed(true);
+    startCar = true;
+    motorsEnabled = true;
+    lastPosition = 0.0f;
+    restoreTuning();
+    Pid_Reset(&linePid, now);
+    Controller_Reset(now);
+    LineRecovery_Reset(&lineRecovery, now);
+    TrackFeatures_Reset(now);
+    TrackMap_Reset(travelledDistance(), now);
+    LineEstimator_Reset(&lineEstimator, 0u, 0.0f, now);
+    WheelSpeed_Reset(now);
+    Odometry_Reset(0.0f, 0.0f, 0.0f);
+    SpeedGovernor_Reset(&speedGovernor, now);
+    Motion_Reset(&motion, now);
+    OscillationDetector_Reset(&oscillationDetector, now);
+}
+
 /* [] END OF FILE */
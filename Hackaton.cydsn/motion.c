@@ -0,0 +1,106 @@
+/* ========================================
+ * motion.c
+ * ========================================
+ */
+
+#include "motion.h"
+
+static float absolute(float x)
+{
+    return (x < 0.0f) ? -x : x;
+}
+
+static float limit(float value, float min, float max)
+{
+    if (value > max)
+    {
+        return max;
+    }
+    if (value < min)
+    {
+        return min;
+    }
+    return value;
+}
+
+// Move current towards target by at most step
+static float approach(float current, float target, float step)
+{
+    return limit(target, current - step, current + step);
+}
+
+void Motion_Init(Motion* motion)
+{
+    motion->speedReduction = MOTION_SPEED_REDUCTION;
+    motion->maxCurvature = MOTION_MAX_CURVATURE;
+    motion->speedRate = MOTION_SPEED_RATE;
+    motion->curvatureRate = MOTION_CURVATURE_RATE;
+    Motion_Reset(motion, 0u);
+}
+
+void Motion_Reset(Motion* motion, uint64_t now)
+{
+    motion->speed = 0.0f;
+    motion->curvature = 0.0f;
+    motion->lastTime = now;
+    motion->started = false;
+}
+
+void Motion_SetMixing(Motion* motion, float speedReduction, float maxCurvature)
+{
+    motion->speedReduction = (speedReduction > 0.0f) ? speedReduction : 0.0f;
+    motion->maxCurvature = (maxCurvature > 0.0f) ? maxCurvature : 0.0f;
+}
+
+void Motion_SetRateLimits(Motion* motion, float speedRate, float curvatureRate)
+{
+    motion->speedRate = speedRate;
+    motion->curvatureRate = curvatureRate;
+}
+
+float Motion_CorrectionToCurvature(float speed, float correction)
+{
+    float reference = absolute(speed);
+    if (reference < MOTION_MIN_SPEED)
+    {
+        reference = MOTION_MIN_SPEED;
+    }
+    return correction / reference;
+}
+
+MotionWheels Motion_Update(Motion* motion, float speed, float curvature, uint64_t now)
+{
+    MotionWheels wheels;
+
+    curvature = limit(curvature, -motion->maxCurvature, motion->maxCurvature);
+
+    if (motion->started)
+    {
+        float dt = (float)(now - motion->lastTime) * 1.0e-6f;
+        motion->speed = approach(motion->speed, speed, motion->speedRate * dt);
+        motion->curvature = approach(motion->curvature, curvature, motion->curvatureRate * dt);
+    }
+    else
+    {
+        motion->speed = speed;
+        motion->curvature = curvature;
+        motion->started = true;
+    }
+    motion->lastTime = now;
+
+    float centre = motion->speed / (1.0f + motion->speedReduction * absolute(motion->curvature));
+    wheels.left = centre * (1.0f + motion->curvature);
+    wheels.right = centre * (1.0f - motion->curvature);
+
+    // Scale both sides together, clipping one of them would change the curvature
+    float largest = (absolute(wheels.left) > absolute(wheels.right)) ? absolute(wheels.left) : absolute(wheels.right);
+    if (largest > MOTION_MAX_WHEEL_SPEED)
+    {
+        float scale = MOTION_MAX_WHEEL_SPEED / largest;
+        wheels.left *= scale;
+        wheels.right *= scale;
+    }
+    return wheels;
+}
+
+/* [] END OF FILE */
@@ -0,0 +1,72 @@
+#ifndef MOTION_H
+#define MOTION_H
+
+#ifdef __cplusplus
+extern "C" {
+#endif
+
+#include <stdint.h>
+#include <stdbool.h>
+
+// Motion layer: (speed, curvature) commands to side wheel speeds.
+//
+// Curvature is normalised to the half track width, so a side moves at
+// centre * (1 + curvature) on the left and centre * (1 - curvature) on the right:
+//   0      straight
+//   +-1    pivot around the inner wheel (it stands still)
+//   large  inner wheel reverses, towards a spin on the spot
+// Positive curvature turns right, like a positive steering correction.
+// One formula covers the whole range, there is no switch into a separate
+// tank-turn mode, so the car passes through the pivot regime without chatter.
+//
+// Centre speed drops with curvature: centre = speed / (1 + speedReduction * |curvature|).
+// speedReduction 0 keeps the centre at speed (outer wheel speeds up, as plain
+// differential steering does); 1 keeps the outer wheel at speed.
+// When a side would exceed MOTION_MAX_WHEEL_SPEED both sides are scaled
+// together, so saturation never changes the curvature.
+//
+// Speed and curvature commands are rate limited (units per second) before mixing.
+
+#define MOTION_MAX_WHEEL_SPEED      (4000.0f)   // Motor units (WHEEL_SPEED_FULL_SCALE)
+#define MOTION_MIN_SPEED            (300.0f)    // Correction is turned to curvature against at least this speed
+#define MOTION_SPEED_REDUCTION      (0.0f)
+#define MOTION_MAX_CURVATURE        (20.0f)
+#define MOTION_SPEED_RATE           (40000.0f)  // Motor units per second
+#define MOTION_CURVATURE_RATE       (100.0f)    // Per second
+
+typedef struct
+{
+    float speedReduction;
+    float maxCurvature;
+    float speedRate;
+    float curvatureRate;
+
+    float speed;            // Rate limited commands
+    float curvature;
+    uint64_t lastTime;      // Microseconds
+    bool started;           // First command after reset is taken without rate limit
+} Motion;
+
+typedef struct
+{
+    float left;
+    float right;
+} MotionWheels;
+
+void Motion_Init(Motion* motion);
+void Motion_Reset(Motion* motion, uint64_t now);
+void Motion_SetMixing(Motion* motion, float speedReduction, float maxCurvature);
+void Motion_SetRateLimits(Motion* motion, float speedRate, float curvatureRate);
+
+// Steering correction of a controller (motor units, left = speed + correction
+// in plain differential steering) as curvature at the given speed
+float Motion_CorrectionToCurvature(float speed, float correction);
+
+// Rate limit the command and mix it to side wheel speeds
+MotionWheels Motion_Update(Motion* motion, float speed, float curvature, uint64_t now);
+
+#ifdef __cplusplus
+}
+#endif
+
+#endif /* MOTION_H */
@@ -0,0 +1,356 @@
+/* ========================================
+ * motor_calibration.c
+ * ========================================
+ */
+
+#include "motor_calibration.h"
+#include "wheel_mixer.h"
+#include "car.h"
+#include "project.h"
+#include <stddef.h>
+
+#define MOTOR_CALIBRATION_MAGIC (0x4C41434Du)   // "MCAL"
+
+// Motor seen by the encoder of each side (WHEEL_MIXER_ENCODER_FRONT tells the axle)
+#if (WHEEL_MIXER_ENCODER_FRONT != 0)
+#define MEASURED_LEFT   MOTOR_LEFT_FRONT
+#define MEASURED_RIGHT  MOTOR_RIGHT_FRONT
+#else
+#define MEASURED_LEFT   MOTOR_LEFT_REAR
+#define MEASURED_RIGHT  MOTOR_RIGHT_REAR
+#endif
+
+// Flash image of the tables, must fit one flash row
+typedef struct
+{
+    uint32_t magic;
+    float fullScaleSpeed;       // Encoder counts per second
+    int16_t duty[MOTOR_COUNT][MOTOR_CALIBRATION_POINTS];
+    uint32_t checksum;          // Bitwise inverted sum of all words before it
+} MotorCalibrationData;
+
+typedef union
+{
+    MotorCalibrationData data;
+    uint32_t words[CY_FLASH_SIZEOF_ROW / sizeof(uint32_t)];
+} MotorCalibrationRow;
+
+// Reserved row in the em_eeprom region, erased (no tables) when the firmware is programmed
+CY_SECTION(".cy_em_eeprom") CY_ALIGN(CY_FLASH_SIZEOF_ROW)
+static const volatile MotorCalibrationRow calibrationFlash = {0};
+
+static const uint8_t measuredMotor[ENCODER_COUNT] = { MEASURED_LEFT, MEASURED_RIGHT };
+
+static MotorCalibrationRow calibration;     // Working copy, also the flash write buffer
+static bool valid = false;
+static bool linearizationEnabled = true;
+static enum motorCalibrationState state = MOTOR_CALIBRATION_IDLE;
+
+// Sweep state
+static uint8_t step;
+static bool measuring;
+static uint64_t stepStartTime;
+static int32_t stepStartCount[ENCODER_COUNT];
+static float sweepSpeed[ENCODER_COUNT][MOTOR_CALIBRATION_STEPS + 1u];
+
+static uint32_t checksum(const MotorCalibrationRow* row)
+{
+    uint32_t sum = 0u;
+    for (uint32_t i = 0; i < (offsetof(MotorCalibrationData, checksum) / sizeof(uint32_t)); i++)
+    {
+        sum += row->words[i];
+    }
+    return ~sum;
+}
+
+static int stepDuty(uint8_t index)
+{
+    return (int)(((int32_t)index * MOTOR_CALIBRATION_FULL_SCALE) / (int32_t)MOTOR_CALIBRATION_STEPS);
+}
+
+static void install(void)
+{
+    Motor_SetLinearization((linearizationEnabled && valid) ? MotorCalibration_Linearize : NULL);
+}
+
+// Drive the measured motors with the same duty, the others stay still
+static void driveMeasured(int duty)
+{
+    int speed[MOTOR_COUNT] = {0, 0, 0, 0};
+    for (uint8_t encoder = 0; encoder < ENCODER_COUNT; encoder++)
+    {
+        speed[measuredMotor[encoder]] = duty;
+    }
+    Motor_MoveRaw(speed[MOTOR_LEFT_FRONT], speed[MOTOR_LEFT_REAR], speed[MOTOR_RIGHT_FRONT], speed[MOTOR_RIGHT_REAR]);
+}
+
+// Inverse table of one swept motor. Returns false if it never turned.
+static bool buildTable(const float* speed, float fullScale, int16_t* duty)
+{
+    uint8_t moving = 0;
+    for (uint8_t i = 1; i <= MOTOR_CALIBRATION_STEPS; i++)
+    {
+        if (speed[i] >= MOTOR_CALIBRATION_MIN_SPEED)
+        {
+            moving = i;
+            break;
+        }
+    }
+    if (moving == 0u)
+    {
+        return false;
+    }
+
+    // Deadband: extend the first moving segment of the curve down to zero speed
+    float deadband = (float)stepDuty(moving - 1u);
+    if ((moving < MOTOR_CALIBRATION_STEPS) && (speed[moving + 1u] > speed[moving]))
+    {
+        float slope = (float)(stepDuty(moving + 1u) - stepDuty(moving)) / (speed[moving + 1u] - speed[moving]);
+        float intercept = (float)stepDuty(moving) - speed[moving] * slope;
+        if ((intercept > deadband) && (intercept < (float)stepDuty(moving)))
+        {
+            deadband = intercept;
+        }
+    }
+    duty[0] = (int16_t)deadband;
+
+    // Walk the curve from (deadband, 0) through the moving steps
+    uint8_t upper = moving;
+    float lowerDuty = deadband;
+    float lowerSpeed = 0.0f;
+    for (uint8_t point = 1; point < MOTOR_CALIBRATION_POINTS; point++)
+    {
+        float wanted = fullScale * (float)point / (float)(MOTOR_CALIBRATION_POINTS - 1u);
+        while ((upper < MOTOR_CALIBRATION_STEPS) && (speed[upper] < wanted))
+        {
+            lowerDuty = (float)stepDuty(upper);
+            lowerSpeed = speed[upper];
+            upper++;
+        }
+
+        float span = speed[upper] - lowerSpeed;
+        float fraction = (span > 0.0f) ? (wanted - lowerSpeed) / span : 1.0f;
+        if (fraction > 1.0f)
+        {
+            fraction = 1.0f;
+        }
+        duty[point] = (int16_t)(lowerDuty + fraction * ((float)stepDuty(upper) - lowerDuty));
+    }
+    return true;
+}
+
+static bool finishSweep(void)
+{
+    MotorCalibrationData* data = &calibration.data;
+
+    // Speed never drops with more duty, measurement noise must not fold the table
+    float fullScale = 0.0f;
+    for (uint8_t encoder = 0; encoder < ENCODER_COUNT; encoder++)
+    {
+        float* speed = sweepSpeed[encoder];
+        for (uint8_t i = 1; i <= MOTOR_CALIBRATION_STEPS; i++)
+        {
+            if (speed[i] < speed[i - 1u])
+            {
+                speed[i] = speed[i - 1u];
+            }
+        }
+        float top = speed[MOTOR_CALIBRATION_STEPS];
+        if ((encoder == 0u) || (top < fullScale))
+        {
+            fullScale = top;
+        }
+    }
+    if (fullScale < MOTOR_CALIBRATION_MIN_SPEED)
+    {
+        return false;
+    }
+
+    for (uint8_t encoder = 0; encoder < ENCODER_COUNT; encoder++)
+    {
+        if (!buildTable(sweepSpeed[encoder], fullScale, data->duty[measuredMotor[encoder]]))
+        {
+            return false;
+        }
+    }
+
+    // Motors on the other axle share the table of their side
+    for (uint8_t point = 0; point < MOTOR_CALIBRATION_POINTS; point++)
+    {
+        data->duty[MOTOR_LEFT_FRONT + MOTOR_LEFT_REAR - MEASURED_LEFT][point] = data->duty[MEASURED_LEFT][point];
+        data->duty[MOTOR_RIGHT_FRONT + MOTOR_RIGHT_REAR - MEASURED_RIGHT][point] = data->duty[MEASURED_RIGHT][point];
+    }
+
+    data->magic = MOTOR_CALIBRATION_MAGIC;
+    data->fullScaleSpeed = fullScale;
+    data->checksum = checksum(&calibration);
+    valid = true;
+
+    // Blocks for a few tens of ms, motors are already stopped
+    return (Cy_Flash_WriteRow((uint32_t)(uintptr_t)&calibrationFlash, calibration.words) == CY_FLASH_DRV_SUCCESS);
+}
+
+void MotorCalibration_Init(void)
+{
+    for (uint32_t i = 0; i < (sizeof(calibration.words) / sizeof(uint32_t)); i++)
+    {
+        calibration.words[i] = calibrationFlash.words[i];
+    }
+
+    valid = (calibration.data.magic == MOTOR_CALIBRATION_MAGIC) &&
+            (calibration.data.checksum == checksum(&calibration));
+    state = MOTOR_CALIBRATION_IDLE;
+    install();
+}
+
+void MotorCalibration_Start(uint64_t now)
+{
+    // Sweep measures the raw motors
+    Motor_SetLinearization(NULL);
+    valid = false;
+
+    state = MOTOR_CALIBRATION_RUNNING;
+    step = 1;
+    measuring = false;
+    stepStartTime = now;
+    for (uint8_t encoder = 0; encoder < ENCODER_COUNT; encoder++)
+    {
+        sweepSpeed[encoder][0] = 0.0f;
+    }
+    driveMeasured(stepDuty(step));
+}
+
+void MotorCalibration_Abort(void)
+{
+    if (state != MOTOR_CALIBRATION_RUNNING)
+    {
+        return;
+    }
+    Motor_MoveRaw(0, 0, 0, 0);
+
+    // Old tables are still in flash
+    MotorCalibration_Init();
+}
+
+bool MotorCalibration_Update(uint64_t now)
+{
+    if (state != MOTOR_CALIBRATION_RUNNING)
+    {
+        return false;
+    }
+
+    uint64_t elapsed = now - stepStartTime;
+    if (!measuring)
+    {
+        if (elapsed >= MOTOR_CALIBRATION_SETTLE_US)
+        {
+            for (uint8_t encoder = 0; encoder < ENCODER_COUNT; encoder++)
+            {
+                stepStartCount[encoder] = Encoder_GetCount(encoder);
+            }
+            measuring = true;
+            stepStartTime = now;
+        }
+        return true;
+    }
+
+    if (elapsed < MOTOR_CALIBRATION_MEASURE_US)
+    {
+        return true;
+    }
+
+    // Direction of the wheels is of no interest, only how fast they turn
+    for (uint8_t encoder = 0; encoder < ENCODER_COUNT; encoder++)
+    {
+        int32_t counts = Encoder_GetCount(encoder) - stepStartCount[encoder];
+        if (counts < 0)
+        {
+            counts = -counts;
+        }
+        sweepSpeed[encoder][step] = (float)counts * 1.0e6f / (float)elapsed;
+    }
+
+    if (step < MOTOR_CALIBRATION_STEPS)
+    {
+        step++;
+        measuring = false;
+        stepStartTime = now;
+        driveMeasured(stepDuty(step));
+        return true;
+    }
+
+    Motor_MoveRaw(0, 0, 0, 0);
+    if (finishSweep())
+    {
+        state = MOTOR_CALIBRATION_DONE;
+        install();
+    }
+    else
+    {
+        // Keep whatever was in flash before
+        MotorCalibration_Init();
+        state = MOTOR_CALIBRATION_FAILED;
+    }
+    return false;
+}
+
+enum motorCalibrationState MotorCalibration_GetState(void)
+{
+    return state;
+}
+
+bool MotorCalibration_IsRunning(void)
+{
+    return (state == MOTOR_CALIBRATION_RUNNING);
+}
+
+void MotorCalibration_SetEnabled(bool enabled)
+{
+    linearizationEnabled = enabled;
+    if (state != MOTOR_CALIBRATION_RUNNING)
+    {
+        install();
+    }
+}
+
+bool MotorCalibration_IsValid(void)
+{
+    return valid;
+}
+
+int MotorCalibration_Linearize(uint8_t motor, int speed)
+{
+    if ((speed == 0) || (motor >= MOTOR_COUNT))
+    {
+        return speed;
+    }
+
+    const int16_t* duty = calibration.data.duty[motor];
+    int32_t magnitude = (speed < 0) ? -speed : speed;
+    int32_t scaled = magnitude * (int32_t)(MOTOR_CALIBRATION_POINTS - 1u);
+    int32_t index = scaled / MOTOR_CALIBRATION_FULL_SCALE;
+    int32_t result;
+
+    if (index >= (int32_t)(MOTOR_CALIBRATION_POINTS - 1u))
+    {
+        result = duty[MOTOR_CALIBRATION_POINTS - 1u];
+    }
+    else
+    {
+        int32_t fraction = scaled - index * MOTOR_CALIBRATION_FULL_SCALE;
+        result = duty[index] + ((duty[index + 1] - duty[index]) * fraction) / MOTOR_CALIBRATION_FULL_SCALE;
+    }
+    return (speed < 0) ? -(int)result : (int)result;
+}
+
+int16_t MotorCalibration_GetDeadband(uint8_t motor)
+{
+    return (valid && (motor < MOTOR_COUNT)) ? calibration.data.duty[motor][0] : 0;
+}
+
+float MotorCalibration_GetFullScaleSpeed(void)
+{
+    return valid ? calibration.data.fullScaleSpeed : 0.0f;
+}
+
+/* [] END OF FILE */
@@ -0,0 +1,74 @@
+#ifndef MOTOR_CALIBRATION_H
+#define MOTOR_CALIBRATION_H
+
+#ifdef __cplusplus
+extern "C" {
+#endif
+
+#include <stdint.h>
+#include <stdbool.h>
+
+// Motor characterization and linearization.
+//
+// Wheel speed is not linear in PCA9685 duty: nothing moves below a deadband and
+// the curve flattens towards full duty, differently for every motor. The
+// calibration sweep drives the motors with the car on a stand (wheels off the
+// ground) in MOTOR_CALIBRATION_STEPS duty steps and measures the encoder speed
+// of each step. From the curve an inverse table is built per motor:
+//   duty[0]      deadband, the duty where the wheel starts to turn
+//   duty[i]      duty giving i / (MOTOR_CALIBRATION_POINTS - 1) of the full scale speed
+// Full scale speed is the top speed of the slowest motor, so every motor reaches
+// it and all of them respond the same way to the same command.
+//
+// The tables are stored in the em_eeprom flash region and installed with
+// Motor_SetLinearization(), so Motor_Move() maps every command through them and
+// the wheel speed loop and steering controllers see a linear plant.
+//
+// Each side has one encoder. Motors on the other axle turn freely on the stand
+// and cannot be measured; they get the table of the measured motor of their side.
+// The sweep runs forward only, reverse uses the same table.
+
+#define MOTOR_CALIBRATION_POINTS        (17u)
+#define MOTOR_CALIBRATION_STEPS         (16u)
+#define MOTOR_CALIBRATION_FULL_SCALE    (4095)      // Motor_Move() range
+#define MOTOR_CALIBRATION_SETTLE_US     (300000u)   // Wait after a duty step before measuring
+#define MOTOR_CALIBRATION_MEASURE_US    (200000u)
+#define MOTOR_CALIBRATION_MIN_SPEED     (20.0f)     // Encoder counts per second, slower means standing
+
+enum motorCalibrationState
+{
+    MOTOR_CALIBRATION_IDLE      = 0,
+    MOTOR_CALIBRATION_RUNNING   = 1,
+    MOTOR_CALIBRATION_DONE      = 2,
+    MOTOR_CALIBRATION_FAILED    = 3,    // A motor did not turn or flash write failed
+};
+
+// Load tables from flash and install them when valid (call after Motor_Init())
+void MotorCalibration_Init(void);
+
+// Sweep drives the motors directly, nothing else may call Motor_Move() until it finishes
+void MotorCalibration_Start(uint64_t now);
+void MotorCalibration_Abort(void);
+
+// Call every control period while running. Stops the motors and saves the
+// tables when the sweep ends. Returns true while running.
+bool MotorCalibration_Update(uint64_t now);
+
+enum motorCalibrationState MotorCalibration_GetState(void);
+bool MotorCalibration_IsRunning(void);
+
+// Linearization is applied when enabled (default) and a table exists
+void MotorCalibration_SetEnabled(bool enabled);
+bool MotorCalibration_IsValid(void);
+
+// Map commanded speed of a motor to duty, the Motor_Linearization of Motor_Move()
+int MotorCalibration_Linearize(uint8_t motor, int speed);
+
+int16_t MotorCalibration_GetDeadband(uint8_t motor);
+float MotorCalibration_GetFullScaleSpeed(void);     // Encoder counts per second
+
+#ifdef __cplusplus
+}
+#endif
+
+#endif /* MOTOR_CALIBRATION_H */
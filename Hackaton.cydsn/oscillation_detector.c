@@ -0,0 +1,134 @@
+/* ========================================
+ * oscillation_detector.c
+ * ========================================
+ */
+
+#include "oscillation_detector.h"
+
+#define OSCILLATION_MIN_DELTA_TIME_US   (100u)
+#define OSCILLATION_MAX_DELTA_TIME_US   (100000u)
+
+#define HALF_PI     (1.5707963f)
+
+static float absolute(float x)
+{
+    return (x < 0.0f) ? -x : x;
+}
+
+void OscillationDetector_Init(OscillationDetector* detector)
+{
+    detector->hysteresis = OSCILLATION_HYSTERESIS;
+    OscillationDetector_SetThresholds(detector, OSCILLATION_MIN_FREQUENCY, OSCILLATION_MIN_AMPLITUDE);
+    OscillationDetector_Reset(detector, 0u);
+}
+
+void OscillationDetector_SetThresholds(OscillationDetector* detector, float minFrequency, float minAmplitude)
+{
+    detector->minFrequency = minFrequency;
+    detector->minAmplitude = minAmplitude;
+}
+
+void OscillationDetector_Reset(OscillationDetector* detector, uint64_t now)
+{
+    for (uint16_t i = 0; i < OSCILLATION_WINDOW; i++)
+    {
+        detector->crossingWindow[i] = 0u;
+        detector->errorWindow[i] = 0.0f;
+        detector->timeWindow[i] = 0.0f;
+    }
+    detector->crossings = 0u;
+    detector->errorSum = 0.0f;
+    detector->timeSum = 0.0f;
+    detector->index = 0u;
+    detector->count = 0u;
+    detector->side = 0;
+    detector->frequency = 0.0f;
+    detector->amplitude = 0.0f;
+    detector->lastTime = now;
+}
+
+bool OscillationDetector_Update(OscillationDetector* detector, float error, uint64_t now)
+{
+    uint64_t elapsed = now - detector->lastTime;
+    uint32_t deltaTimeUs = (elapsed > OSCILLATION_MAX_DELTA_TIME_US) ? OSCILLATION_MAX_DELTA_TIME_US : (uint32_t)elapsed;
+    if (deltaTimeUs < OSCILLATION_MIN_DELTA_TIME_US)
+    {
+        deltaTimeUs = OSCILLATION_MIN_DELTA_TIME_US;
+    }
+    float deltaTime = (float)deltaTimeUs * 1.0e-6f;
+    detector->lastTime = now;
+
+    // Zero crossing with hysteresis: the error has to reach the other side of the band
+    uint8_t crossing = 0u;
+    int8_t side = detector->side;
+    if (error > detector->hysteresis)
+    {
+        side = 1;
+    }
+    else if (error < -detector->hysteresis)
+    {
+        side = -1;
+    }
+    if ((detector->side != 0) && (side != detector->side))
+    {
+        crossing = 1u;
+    }
+    detector->side = side;
+
+    // Sliding window: replace the oldest sample in the running sums
+    uint16_t index = detector->index;
+    float absError = absolute(error);
+    detector->crossings = (uint16_t)(detector->crossings + crossing - detector->crossingWindow[index]);
+    detector->errorSum += absError - detector->errorWindow[index];
+    detector->timeSum += deltaTime - detector->timeWindow[index];
+    detector->crossingWindow[index] = crossing;
+    detector->errorWindow[index] = absError;
+    detector->timeWindow[index] = deltaTime;
+    detector->index = (uint16_t)((index + 1u) % OSCILLATION_WINDOW);
+    if (detector->count < OSCILLATION_WINDOW)
+    {
+        detector->count++;
+    }
+
+    // Recalculate the float sums once per window so rounding doesn't accumulate
+    if (detector->index == 0u)
+    {
+        detector->errorSum = 0.0f;
+        detector->timeSum = 0.0f;
+        for (uint16_t i = 0; i < OSCILLATION_WINDOW; i++)
+        {
+            detector->errorSum += detector->errorWindow[i];
+            detector->timeSum += detector->timeWindow[i];
+        }
+    }
+
+    detector->frequency = (detector->timeSum > 0.0f) ? 0.5f * (float)detector->crossings / detector->timeSum : 0.0f;
+    detector->amplitude = HALF_PI * detector->errorSum / (float)detector->count;
+
+    if ((detector->count < OSCILLATION_WINDOW) ||
+        (detector->frequency < detector->minFrequency) ||
+        (detector->amplitude < detector->minAmplitude))
+    {
+        return false;
+    }
+
+    // Report once, the next window has to fill with the reaction applied
+    float frequency = detector->frequency;
+    float amplitude = detector->amplitude;
+    OscillationDetector_Reset(detector, now);
+    detector->frequency = frequency;
+    detector->amplitude = amplitude;
+    return true;
+}
+
+float OscillationDetector_GetFrequency(const OscillationDetector* detector)
+{
+    return detector->frequency;
+}
+
+float OscillationDetector_GetAmplitude(const OscillationDetector* detector)
+{
+    return detector->amplitude;
+}
+
+/* [] END OF FILE */
@@ -0,0 +1,82 @@
+#ifndef OSCILLATION_DETECTOR_H
+#define OSCILLATION_DETECTOR_H
+
+#ifdef __cplusplus
+extern "C" {
+#endif
+
+#include <stdint.h>
+#include <stdbool.h>
+
+// Online limit cycle detection in the line position error.
+//
+// A badly tuned (or too fast) steering loop wobbles around the line. The
+// detector keeps a sliding window (OSCILLATION_WINDOW control periods) of
+// zero crossings and |error|, updated in O(1) every period:
+//   frequency = crossings / 2 / window time
+//   amplitude = mean |error| * pi / 2      (peak of a sine with that mean)
+// A crossing counts only when the error passes the other side of +-hysteresis,
+// so sensor noise around the centre is not a crossing. Sustained oscillation
+// is reported when the window is full and both frequency and amplitude are
+// above their thresholds; the window is cleared then, so the next report
+// comes after one more full window with the new gains (cooldown).
+//
+// What to do about it is up to the caller: main_cm4.c scales the line PID
+// Kp and Kd by OSCILLATION_BACKOFF (down to OSCILLATION_MIN_GAIN_SCALE of the
+// tuned gains), then base speed down to OSCILLATION_MIN_SPEED.
+
+#define OSCILLATION_WINDOW          (256u)      // Samples, 512 ms at 500 Hz control rate
+
+#define OSCILLATION_HYSTERESIS      (0.2f)      // Line position units
+#define OSCILLATION_MIN_FREQUENCY   (2.0f)      // Hz
+#define OSCILLATION_MIN_AMPLITUDE   (0.6f)      // Line position units
+
+#define OSCILLATION_BACKOFF         (0.8f)      // Gain or speed factor per detection
+#define OSCILLATION_MIN_GAIN_SCALE  (0.4f)      // Kp, Kd are not backed off below this share of the tuned gains
+#define OSCILLATION_MIN_SPEED       (400u)      // Base speed is not backed off below this (motor units)
+
+enum oscillationAction
+{
+    OSCILLATION_ACTION_NONE     = 0,    // Gains and speed at their limits, only reported
+    OSCILLATION_ACTION_GAINS    = 1,    // Line PID Kp, Kd scaled down
+    OSCILLATION_ACTION_SPEED    = 2,    // Base speed scaled down
+};
+
+typedef struct
+{
+    float hysteresis;
+    float minFrequency;
+    float minAmplitude;
+
+    uint8_t crossingWindow[OSCILLATION_WINDOW];     // 1 = sign change in this sample
+    float errorWindow[OSCILLATION_WINDOW];          // |error|
+    float timeWindow[OSCILLATION_WINDOW];           // Time step in seconds
+    uint16_t crossings;
+    float errorSum;
+    float timeSum;
+    uint16_t index;
+    uint16_t count;
+
+    int8_t side;            // -1 / +1 side of the hysteresis band the error was last on, 0 = none yet
+    float frequency;        // Last window, Hz
+    float amplitude;        // Last window, line position units
+    uint64_t lastTime;      // Microseconds
+} OscillationDetector;
+
+void OscillationDetector_Init(OscillationDetector* detector);
+void OscillationDetector_SetThresholds(OscillationDetector* detector, float minFrequency, float minAmplitude);
+
+// Clear the window, time steps count from now (microseconds)
+void OscillationDetector_Reset(OscillationDetector* detector, uint64_t now);
+
+// Feed line error measured at time now. Returns true once per detected oscillation.
+bool OscillationDetector_Update(OscillationDetector* detector, float error, uint64_t now);
+
+float OscillationDetector_GetFrequency(const OscillationDetector* detector);
+float OscillationDetector_GetAmplitude(const OscillationDetector* detector);
+
+#ifdef __cplusplus
+}
+#endif
+
+#endif /* OSCILLATION_DETECTOR_H */
@@ -0,0 +1,153 @@
+/* ========================================
+ * pid.c
+ * ========================================
+ */
+
+#include "pid.h"
+
+#if (PID_IMPLEMENTATION == PID_IMPL_Q16)
+
+// Saturate 64-bit intermediate result to Q16.16 range
+static int32_t saturate(int64_t x)
+{
+    if (x > INT32_MAX)
+        return INT32_MAX;
+    else if (x < INT32_MIN)
+        return INT32_MIN;
+    else
+        return (int32_t)x;
+}
+
+static pid_value_t add(pid_value_t a, pid_value_t b)
+{
+    return saturate((int64_t)a + b);
+}
+
+static pid_value_t multiply(pid_value_t a, pid_value_t b)
+{
+    return saturate(((int64_t)a * b) >> 16);
+}
+
+#else
+
+static pid_value_t add(pid_value_t a, pid_value_t b)
+{
+    return a + b;
+}
+
+static pid_value_t multiply(pid_value_t a, pid_value_t b)
+{
+    return a * b;
+}
+
+#endif
+
+static pid_value_t clamp(pid_value_t x, pid_value_t limit)
+{
+    if (x > limit)
+        return limit;
+    else if (x < -limit)
+        return -limit;
+    else
+        return x;
+}
+
+void Pid_Init(Pid* pid, float kp, float ki, float kd, float integralLimit, float outputLimit)
+{
+    Pid_SetGains(pid, kp, ki, kd);
+    pid->integralLimit = PID_FROM_FLOAT(integralLimit);
+    pid->outputLimit = PID_FROM_FLOAT(outputLimit);
+    pid->derivativeFilterUs = 0u;
+    Pid_Reset(pid, 0u);
+}
+
+void Pid_SetGains(Pid* pid, float kp, float ki, float kd)
+{
+    pid->kp = PID_FROM_FLOAT(kp);
+    pid->ki = PID_FROM_FLOAT(ki);
+    pid->kd = PID_FROM_FLOAT(kd);
+}
+
+void Pid_SetOutputLimit(Pid* pid, float outputLimit)
+{
+    pid->outputLimit = PID_FROM_FLOAT(outputLimit);
+}
+
+void Pid_SetDerivativeFilter(Pid* pid, uint32_t timeConstantUs)
+{
+    pid->derivativeFilterUs = timeConstantUs;
+}
+
+void Pid_Reset(Pid* pid, uint64_t now)
+{
+    pid->lastError = 0;
+    pid->integral = 0;
+    pid->derivative = 0;
+    pid->lastTime = now;
+}
+
+pid_value_t Pid_Update(Pid* pid, pid_value_t error, uint64_t now)
+{
+    uint64_t elapsed = now - pid->lastTime;
+    uint32_t deltaTimeUs = (elapsed > PID_MAX_DELTA_TIME_US) ? PID_MAX_DELTA_TIME_US : (uint32_t)elapsed;
+    if (deltaTimeUs < PID_MIN_DELTA_TIME_US)
+    {
+        deltaTimeUs = PID_MIN_DELTA_TIME_US;
+    }
+
+#if (PID_IMPLEMENTATION == PID_IMPL_Q16)
+    // dt in seconds as Q16.16: deltaTimeUs * 65536 / 1e6, 68719 / 2^20 ~= 0.065536
+    pid_value_t deltaTime = (pid_value_t)(((uint64_t)deltaTimeUs * 68719u) >> 20);
+    // 1/dt in Hz as Q24.8, one 32-bit division
+    uint32_t rate = (1000000u << 8) / deltaTimeUs;
+    pid_value_t derivative = saturate((((int64_t)error - pid->lastError) * rate) >> 8);
+    // Filter weight dt / (tau + dt) as Q16.16
+    pid_value_t weight = (pid_value_t)(((uint64_t)deltaTimeUs << 16) / ((uint64_t)pid->derivativeFilterUs + deltaTimeUs));
+#else
+    pid_value_t deltaTime = (pid_value_t)deltaTimeUs * 1.0e-6f;
+    pid_value_t derivative = (error - pid->lastError) / deltaTime;
+    pid_value_t weight = (pid_value_t)deltaTimeUs / (pid_value_t)(pid->derivativeFilterUs + deltaTimeUs);
+#endif
+
+    if (pid->derivativeFilterUs == 0u)
+    {
+        pid->derivative = derivative;
+    }
+    else
+    {
+        pid->derivative = add(pid->derivative, multiply(weight, add(derivative, -pid->derivative)));
+    }
+
+    pid->integral = clamp(add(pid->integral, multiply(error, deltaTime)), pid->integralLimit);
+
+    pid_value_t output = add(add(multiply(pid->kp, error),
+                                 multiply(pid->ki, pid->integral)),
+                             multiply(pid->kd, pid->derivative));
+
+    pid->lastError = error;
+    pid->lastTime = now;
+
+    return clamp(output, pid->outputLimit);
+}
+
+float Pid_GetKp(const Pid* pid)
+{
+    return PID_TO_FLOAT(pid->kp);
+}
+
+float Pid_GetKi(const Pid* pid)
+{
+    return PID_TO_FLOAT(pid->ki);
+}
+
+float Pid_GetKd(const Pid* pid)
+{
+    return PID_TO_FLOAT(pid->kd);
+}
+
+float Pid_GetLastError(const Pid* pid)
+{
+    return PID_TO_FLOAT(pid->lastError);
+}
+
+/* [] END OF FILE */
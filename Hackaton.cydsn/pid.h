@@ -0,0 +1,81 @@
+#ifndef PID_H
+#define PID_H
+
+#ifdef __cplusplus
+extern "C" {
+#endif
+
+#include <stdint.h>
+#include <stdbool.h>
+
+// Reusable PID controller. Each controlled quantity owns its own Pid instance.
+//
+// The arithmetic is selected at compile time with PID_IMPLEMENTATION:
+//   PID_IMPL_FLOAT - single precision float, uses the CM4 FPU (default)
+//   PID_IMPL_Q16   - Q16.16 fixed point, no floating point in Pid_Update()
+// Both avoid double precision, which is emulated in software on CM4.
+
+#define PID_IMPL_FLOAT  (0)
+#define PID_IMPL_Q16    (1)
+
+#ifndef PID_IMPLEMENTATION
+#define PID_IMPLEMENTATION  PID_IMPL_FLOAT
+#endif
+
+#if (PID_IMPLEMENTATION == PID_IMPL_Q16)
+typedef int32_t pid_value_t;                                    // Q16.16
+#define PID_FROM_FLOAT(x)   ((pid_value_t)((x) * 65536.0f))
+#define PID_TO_FLOAT(x)     ((float)(x) * (1.0f / 65536.0f))
+#define PID_FROM_INT(x)     ((pid_value_t)(x) * 65536)
+#define PID_TO_INT(x)       ((int32_t)((x) / 65536))
+#else
+typedef float pid_value_t;
+#define PID_FROM_FLOAT(x)   ((pid_value_t)(x))
+#define PID_TO_FLOAT(x)     ((float)(x))
+#define PID_FROM_INT(x)     ((pid_value_t)(x))
+#define PID_TO_INT(x)       ((int32_t)(x))
+#endif
+
+// Time step limits. Shorter steps are stretched (first iteration), longer ones are cut (after a pause).
+#define PID_MIN_DELTA_TIME_US   (100u)
+#define PID_MAX_DELTA_TIME_US   (100000u)
+
+typedef struct
+{
+    pid_value_t kp;
+    pid_value_t ki;
+    pid_value_t kd;
+    pid_value_t integralLimit;  // Anti-windup: |integral| <= integralLimit
+    pid_value_t outputLimit;    // |output| <= outputLimit
+    uint32_t derivativeFilterUs;// Time constant of the low-pass on the D term, 0 = none
+    pid_value_t lastError;
+    pid_value_t integral;
+    pid_value_t derivative;     // Filtered error rate
+    uint64_t lastTime;          // Microseconds
+} Pid;
+
+void Pid_Init(Pid* pid, float kp, float ki, float kd, float integralLimit, float outputLimit);
+void Pid_SetGains(Pid* pid, float kp, float ki, float kd);
+void Pid_SetOutputLimit(Pid* pid, float outputLimit);
+
+// First-order low-pass on the error rate. A step of the error then gives a D
+// term of kd * step / (timeConstant + dt) instead of kd * step / dt, so gains
+// tuned at a slow loop rate keep their effect when the loop runs faster.
+void Pid_SetDerivativeFilter(Pid* pid, uint32_t timeConstantUs);
+
+// Clear integral and error history. now is the timestamp of the next time step start (microseconds).
+void Pid_Reset(Pid* pid, uint64_t now);
+
+// Compute controller output for error measured at time now (microseconds)
+pid_value_t Pid_Update(Pid* pid, pid_value_t error, uint64_t now);
+
+float Pid_GetKp(const Pid* pid);
+float Pid_GetKi(const Pid* pid);
+float Pid_GetKd(const Pid* pid);
+float Pid_GetLastError(const Pid* pid);
+
+#ifdef __cplusplus
+}
+#endif
+
+#endif /* PID_H */
@@ -0,0 +1,57 @@
+/* ========================================
+ * pure_pursuit.c
+ * ========================================
+ */
+
+#include "pure_pursuit.h"
+
+#define PURE_PURSUIT_MIN_LOOKAHEAD  (0.010f)
+
+void PurePursuit_Init(PurePursuit* pursuit, float lookahead, float predictTime, float outputLimit)
+{
+    PurePursuit_SetLookahead(pursuit, lookahead);
+    PurePursuit_SetPredictTime(pursuit, predictTime);
+    pursuit->minSpeed = PURE_PURSUIT_MIN_SPEED;
+    pursuit->outputLimit = outputLimit;
+}
+
+void PurePursuit_SetLookahead(PurePursuit* pursuit, float lookahead)
+{
+    pursuit->lookahead = (lookahead > PURE_PURSUIT_MIN_LOOKAHEAD) ? lookahead : PURE_PURSUIT_MIN_LOOKAHEAD;
+}
+
+void PurePursuit_SetPredictTime(PurePursuit* pursuit, float predictTime)
+{
+    pursuit->predictTime = (predictTime > 0.0f) ? predictTime : 0.0f;
+}
+
+void PurePursuit_SetOutputLimit(PurePursuit* pursuit, float outputLimit)
+{
+    pursuit->outputLimit = outputLimit;
+}
+
+float PurePursuit_Update(const PurePursuit* pursuit, float position, float velocity, float speed)
+{
+    // Lateral offset of the goal point in metres
+    float y = (position + velocity * pursuit->predictTime) * PURE_PURSUIT_SENSOR_PITCH;
+    float curvature = 2.0f * y / (pursuit->lookahead * pursuit->lookahead + y * y);
+
+    if (speed < pursuit->minSpeed)
+    {
+        speed = pursuit->minSpeed;
+    }
+
+    float correction = speed * curvature * PURE_PURSUIT_HALF_TRACK;
+    if (correction > pursuit->outputLimit)
+    {
+        correction = pursuit->outputLimit;
+    }
+    else if (correction < -pursuit->outputLimit)
+    {
+        correction = -pursuit->outputLimit;
+    }
+
+    return correction;
+}
+
+/* [] END OF FILE */
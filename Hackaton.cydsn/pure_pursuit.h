@@ -0,0 +1,49 @@
+#ifndef PURE_PURSUIT_H
+#define PURE_PURSUIT_H
+
+#ifdef __cplusplus
+extern "C" {
+#endif
+
+#include <stdint.h>
+#include <stdbool.h>
+
+// Pure pursuit steering on the estimated line position.
+//
+// The goal point is the line under the sensor bar, lookahead metres in front of
+// the wheel axle, shifted by where the line will be after predictTime at the
+// current lateral velocity. The arc through the goal point has curvature
+//   k = 2 * y / (L^2 + y^2)
+// and a differential drive follows it when the wheel speed difference is
+//   correction = speed * k * halfTrack
+// so, unlike the PID, steering scales with forward speed. Speed is never taken
+// below minSpeed so the car still turns towards the line when starting.
+
+#define PURE_PURSUIT_SENSOR_PITCH   (0.010f)    // Metres between neighbouring track sensors (1 position unit)
+#define PURE_PURSUIT_LOOKAHEAD      (0.080f)    // Metres from the wheel axle to the sensor bar
+#define PURE_PURSUIT_HALF_TRACK     (0.070f)    // Metres from the car centre to a wheel
+#define PURE_PURSUIT_PREDICT_TIME   (0.030f)    // Seconds of lateral velocity added to the goal point
+#define PURE_PURSUIT_MIN_SPEED      (800.0f)    // Motor units
+
+typedef struct
+{
+    float lookahead;        // Metres
+    float predictTime;      // Seconds
+    float minSpeed;         // Motor units
+    float outputLimit;      // |correction| <= outputLimit
+} PurePursuit;
+
+void PurePursuit_Init(PurePursuit* pursuit, float lookahead, float predictTime, float outputLimit);
+void PurePursuit_SetLookahead(PurePursuit* pursuit, float lookahead);
+void PurePursuit_SetPredictTime(PurePursuit* pursuit, float predictTime);
+void PurePursuit_SetOutputLimit(PurePursuit* pursuit, float outputLimit);
+
+// Steering correction for line position (position units), its velocity (units/s)
+// and forward speed (motor units)
+float PurePursuit_Update(const PurePursuit* pursuit, float position, float velocity, float speed);
+
+#ifdef __cplusplus
+}
+#endif
+
+#endif /* PURE_PURSUIT_H */
@@ -0,0 +1,153 @@
+/* ========================================
+ * scheduler.c
+ * ========================================
+ */
+
+#include "scheduler.h"
+#include <stddef.h>
+
+typedef struct
+{
+    const char* name;
+    Scheduler_TaskFunction function;
+    uint32_t period;          // In ticks
+    uint32_t nextRelease;     // Tick number of the next release
+    Scheduler_TaskStats stats;
+} Scheduler_Task;
+
+static Scheduler_Task tasks[SCHEDULER_MAX_TASKS];
+static uint8_t taskCount = 0;
+
+static Scheduler_ClockFunction clockSource = NULL;
+
+// Written by Scheduler_Tick() only
+static volatile uint32_t ticks = 0;
+static volatile uint32_t lastTickTime = 0;
+// Clock units per tick, measured from the two most recent ticks
+static volatile uint32_t tickDuration = 0;
+
+static uint32_t readClock(void)
+{
+    return (clockSource != NULL) ? clockSource() : 0u;
+}
+
+void Scheduler_Init(Scheduler_ClockFunction clock)
+{
+    clockSource = clock;
+    taskCount = 0;
+    ticks = 0;
+    tickDuration = 0;
+    lastTickTime = readClock();
+}
+
+uint8_t Scheduler_AddTask(const char* name, Scheduler_TaskFunction function, uint32_t periodTicks)
+{
+    if ((taskCount >= SCHEDULER_MAX_TASKS) || (function == NULL))
+    {
+        return SCHEDULER_INVALID_TASK;
+    }
+    if (periodTicks == 0u)
+    {
+        periodTicks = 1u;
+    }
+
+    Scheduler_Task* task = &tasks[taskCount];
+    task->name = name;
+    task->function = function;
+    task->period = periodTicks;
+    task->nextRelease = ticks + periodTicks;
+    task->stats = (Scheduler_TaskStats){0};
+
+    return taskCount++;
+}
+
+void Scheduler_Tick(void)
+{
+    uint32_t now = readClock();
+    tickDuration = now - lastTickTime;
+    lastTickTime = now;
+    ticks++;
+}
+
+void Scheduler_Run(void)
+{
+    for (uint8_t i = 0; i < taskCount; i++)
+    {
+        Scheduler_Task* task = &tasks[i];
+        uint32_t tickNow;
+        uint32_t tickTime;
+        uint32_t tickLength;
+
+        // Tick counter and its timestamp are updated from the ISR, re-read until consistent
+        do
+        {
+            tickNow = ticks;
+            tickTime = lastTickTime;
+            tickLength = tickDuration;
+        } while (tickNow != ticks);
+
+        if ((int32_t)(tickNow - task->nextRelease) < 0)
+        {
+            continue;
+        }
+
+        // Release time is the timestamp of the tick the task became due on
+        uint32_t releaseTime = tickTime - (tickNow - task->nextRelease) * tickLength;
+        uint32_t start = readClock();
+
+        task->function();
+
+        uint32_t end = readClock();
+
+        task->stats.runs++;
+        task->stats.lastJitter = start - releaseTime;
+        if (task->stats.lastJitter > task->stats.maxJitter)
+        {
+            task->stats.maxJitter = task->stats.lastJitter;
+        }
+        task->stats.lastExecTime = end - start;
+        if (task->stats.lastExecTime > task->stats.maxExecTime)
+        {
+            task->stats.maxExecTime = task->stats.lastExecTime;
+        }
+
+        // Skip releases that already passed instead of running the task back-to-back
+        task->nextRelease += task->period;
+        tickNow = ticks;
+        while ((int32_t)(tickNow - task->nextRelease) >= 0)
+        {
+            task->nextRelease += task->period;
+            task->stats.overruns++;
+        }
+    }
+}
+
+const Scheduler_TaskStats* Scheduler_GetTaskStats(uint8_t taskId)
+{
+    return (taskId < taskCount) ? &tasks[taskId].stats : NULL;
+}
+
+const char* Scheduler_GetTaskName(uint8_t taskId)
+{
+    return (taskId < taskCount) ? tasks[taskId].name : NULL;
+}
+
+uint8_t Scheduler_GetTaskCount(void)
+{
+    return taskCount;
+}
+
+void Scheduler_ResetStats(void)
+{
+    for (uint8_t i = 0; i < taskCount; i++)
+    {
+        tasks[i].stats = (Scheduler_TaskStats){0};
+    }
+}
+
+uint32_t Scheduler_GetTicks(void)
+{
+    return ticks;
+}
+
+/* [] END OF FILE */
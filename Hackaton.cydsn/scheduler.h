@@ -0,0 +1,65 @@
+#ifndef SCHEDULER_H
+#define SCHEDULER_H
+
+#ifdef __cplusplus
+extern "C" {
+#endif
+
+#include <stdint.h>
+#include <stdbool.h>
+
+// Cooperative fixed-rate scheduler for the CM4 main loop.
+//
+// A periodic interrupt (SysTick on the car, anything on the host) calls
+// Scheduler_Tick(). The main loop calls Scheduler_Run(), which executes every
+// task whose release tick has been reached, in the order tasks were added.
+// Tasks never preempt each other, so the first task added has the highest
+// priority (put the control loop first).
+//
+// Timing statistics are measured with the clock passed to Scheduler_Init().
+// Any monotonic 32-bit counter works (milliseconds, microseconds, simulated
+// time on the host); all reported times are in units of that clock.
+
+#define SCHEDULER_MAX_TASKS      (8u)
+#define SCHEDULER_INVALID_TASK   (0xFFu)
+
+typedef void (*Scheduler_TaskFunction)(void);
+typedef uint32_t (*Scheduler_ClockFunction)(void);
+
+typedef struct
+{
+    uint32_t runs;          // Number of executions
+    uint32_t overruns;      // Releases skipped because the task was still late by a full period
+    uint32_t lastJitter;    // Start time minus release time of the last execution
+    uint32_t maxJitter;     // Worst start lateness seen
+    uint32_t lastExecTime;  // Execution time of the last run
+    uint32_t maxExecTime;   // Worst execution time seen
+} Scheduler_TaskStats;
+
+// Reset the task table. clock is used to timestamp releases and measure tasks.
+void Scheduler_Init(Scheduler_ClockFunction clock);
+
+// Register a task that runs every periodTicks scheduler ticks (>= 1).
+// Returns task id or SCHEDULER_INVALID_TASK when the table is full.
+uint8_t Scheduler_AddTask(const char* name, Scheduler_TaskFunction function, uint32_t periodTicks);
+
+// Advance scheduler time by one tick. Safe to call from an interrupt.
+void Scheduler_Tick(void);
+
+// Run all released tasks once. Call this from the main loop as often as possible.
+void Scheduler_Run(void);
+
+// Read/clear statistics of a task
+const Scheduler_TaskStats* Scheduler_GetTaskStats(uint8_t taskId);
+const char* Scheduler_GetTaskName(uint8_t taskId);
+uint8_t Scheduler_GetTaskCount(void);
+void Scheduler_ResetStats(void);
+
+// Ticks elapsed since Scheduler_Init()
+uint32_t Scheduler_GetTicks(void);
+
+#ifdef __cplusplus
+}
+#endif
+
+#endif /* SCHEDULER_H */
@@ -0,0 +1,128 @@
+/* ========================================
+ * speed_governor.c
+ * ========================================
+ */
+
+#include "speed_governor.h"
+
+#define SPEED_GOVERNOR_MIN_DELTA_TIME_US    (100u)
+#define SPEED_GOVERNOR_MAX_DELTA_TIME_US    (100000u)
+
+static float absolute(float x)
+{
+    return (x < 0.0f) ? -x : x;
+}
+
+void SpeedGovernor_Init(SpeedGovernor* governor, float minSpeed, float maxSpeed)
+{
+    SpeedGovernor_SetSpeedRange(governor, minSpeed, maxSpeed);
+    SpeedGovernor_SetGains(governor, SPEED_GOVERNOR_ERROR_GAIN, SPEED_GOVERNOR_RATE_GAIN);
+    SpeedGovernor_SetLimits(governor, SPEED_GOVERNOR_ACCELERATION, SPEED_GOVERNOR_DECELERATION);
+    SpeedGovernor_Reset(governor, 0u);
+}
+
+void SpeedGovernor_SetSpeedRange(SpeedGovernor* governor, float minSpeed, float maxSpeed)
+{
+    governor->minSpeed = minSpeed;
+    governor->maxSpeed = (maxSpeed > minSpeed) ? maxSpeed : minSpeed;
+}
+
+void SpeedGovernor_SetGains(SpeedGovernor* governor, float errorGain, float rateGain)
+{
+    governor->errorGain = errorGain;
+    governor->rateGain = rateGain;
+}
+
+void SpeedGovernor_SetLimits(SpeedGovernor* governor, float acceleration, float deceleration)
+{
+    governor->acceleration = acceleration;
+    governor->deceleration = deceleration;
+}
+
+void SpeedGovernor_Reset(SpeedGovernor* governor, uint64_t now)
+{
+    for (uint8_t i = 0; i < SPEED_GOVERNOR_WINDOW; i++)
+    {
+        governor->errorWindow[i] = 0.0f;
+        governor->rateWindow[i] = 0.0f;
+    }
+    governor->errorSum = 0.0f;
+    governor->rateSum = 0.0f;
+    governor->index = 0;
+    governor->count = 0;
+    governor->lastError = 0.0f;
+    governor->speed = governor->minSpeed;
+    governor->lastTime = now;
+}
+
+float SpeedGovernor_Update(SpeedGovernor* governor, float error, uint64_t now)
+{
+    uint64_t elapsed = now - governor->lastTime;
+    uint32_t deltaTimeUs = (elapsed > SPEED_GOVERNOR_MAX_DELTA_TIME_US) ? SPEED_GOVERNOR_MAX_DELTA_TIME_US : (uint32_t)elapsed;
+    if (deltaTimeUs < SPEED_GOVERNOR_MIN_DELTA_TIME_US)
+    {
+        deltaTimeUs = SPEED_GOVERNOR_MIN_DELTA_TIME_US;
+    }
+    float deltaTime = (float)deltaTimeUs * 1.0e-6f;
+
+    float absError = absolute(error);
+    float absRate = (governor->count > 0u) ? absolute(error - governor->lastError) / deltaTime : 0.0f;
+    governor->lastError = error;
+    governor->lastTime = now;
+
+    // Sliding window: replace the oldest sample in the running sums
+    governor->errorSum += absError - governor->errorWindow[governor->index];
+    governor->rateSum += absRate - governor->rateWindow[governor->index];
+    governor->errorWindow[governor->index] = absError;
+    governor->rateWindow[governor->index] = absRate;
+    governor->index = (governor->index + 1u) % SPEED_GOVERNOR_WINDOW;
+    if (governor->count < SPEED_GOVERNOR_WINDOW)
+    {
+        governor->count++;
+    }
+
+    // Recalculate the sums once per window so float rounding doesn't accumulate
+    if (governor->index == 0u)
+    {
+        governor->errorSum = 0.0f;
+        governor->rateSum = 0.0f;
+        for (uint8_t i = 0; i < SPEED_GOVERNOR_WINDOW; i++)
+        {
+            governor->errorSum += governor->errorWindow[i];
+            governor->rateSum += governor->rateWindow[i];
+        }
+    }
+
+    float meanError = governor->errorSum / (float)governor->count;
+    float meanRate = governor->rateSum / (float)governor->count;
+
+    float target = governor->maxSpeed - governor->errorGain * meanError - governor->rateGain * meanRate;
+    if (target < governor->minSpeed)
+    {
+        target = governor->minSpeed;
+    }
+    else if (target > governor->maxSpeed)
+    {
+        target = governor->maxSpeed;
+    }
+
+    // Acceleration / deceleration limits
+    float maxIncrease = governor->acceleration * deltaTime;
+    float maxDecrease = governor->deceleration * deltaTime;
+    if (target > governor->speed + maxIncrease)
+    {
+        governor->speed += maxIncrease;
+    }
+    else if (target < governor->speed - maxDecrease)
+    {
+        governor->speed -= maxDecrease;
+    }
+    else
+    {
+        governor->speed = target;
+    }
+
+    return governor->speed;
+}
+
+/* [] END OF FILE */
@@ -0,0 +1,64 @@
+#ifndef SPEED_GOVERNOR_H
+#define SPEED_GOVERNOR_H
+
+#ifdef __cplusplus
+extern "C" {
+#endif
+
+#include <stdint.h>
+#include <stdbool.h>
+
+// Adaptive base speed for line following.
+//
+// Mean |error| and mean |error rate| over a sliding window tell how curvy the
+// track under the car is. The governor goes up to maxSpeed on straights and
+// slows down towards minSpeed when the error or its rate grows:
+//   target = maxSpeed - errorGain * mean|error| - rateGain * mean|error rate|
+// The output follows the target with separate acceleration and deceleration
+// limits (deceleration is usually allowed to be much faster).
+
+#define SPEED_GOVERNOR_WINDOW       (32u)       // Samples, 64 ms at 500 Hz control rate
+
+#define SPEED_GOVERNOR_MAX_SPEED    (2000.0f)   // Motor units
+#define SPEED_GOVERNOR_ERROR_GAIN   (600.0f)    // Speed drop per unit of mean |error|
+#define SPEED_GOVERNOR_RATE_GAIN    (40.0f)     // Speed drop per unit/s of mean |error rate|
+#define SPEED_GOVERNOR_ACCELERATION (2000.0f)   // Motor units per second
+#define SPEED_GOVERNOR_DECELERATION (20000.0f)  // Motor units per second
+
+typedef struct
+{
+    float minSpeed;
+    float maxSpeed;
+    float errorGain;
+    float rateGain;
+    float acceleration;
+    float deceleration;
+
+    float errorWindow[SPEED_GOVERNOR_WINDOW];   // |error|
+    float rateWindow[SPEED_GOVERNOR_WINDOW];    // |error rate|
+    float errorSum;
+    float rateSum;
+    uint8_t index;
+    uint8_t count;
+
+    float lastError;
+    float speed;
+    uint64_t lastTime;      // Microseconds
+} SpeedGovernor;
+
+void SpeedGovernor_Init(SpeedGovernor* governor, float minSpeed, float maxSpeed);
+void SpeedGovernor_SetSpeedRange(SpeedGovernor* governor, float minSpeed, float maxSpeed);
+void SpeedGovernor_SetGains(SpeedGovernor* governor, float errorGain, float rateGain);
+void SpeedGovernor_SetLimits(SpeedGovernor* governor, float acceleration, float deceleration);
+
+// Clear the window and start again from minSpeed at time now (microseconds)
+void SpeedGovernor_Reset(SpeedGovernor* governor, uint64_t now);
+
+// Feed line error measured at time now, returns base speed to drive with
+float SpeedGovernor_Update(SpeedGovernor* governor, float error, uint64_t now);
+
+#ifdef __cplusplus
+}
+#endif
+
+#endif /* SPEED_GOVERNOR_H */
@@ -0,0 +1,154 @@
+/* ========================================
+ * supervisor.c
+ * ========================================
+ */
+
+#include "supervisor.h"
+#include "car.h"
+#include "project.h"
+
+static const cy_stc_sysint_t watchdogIrqConfig =
+{
+    .intrSrc = srss_interrupt_IRQn,
+    .intrPriority = 0u,
+};
+
+static uint32_t period;
+static uint32_t deadline;
+
+// Shared with the SysTick callback
+static volatile bool armed = false;
+static volatile bool alive = false;
+static volatile uint32_t lastKick;
+static volatile uint32_t nextDeadline;
+static SupervisorStats stats;
+
+static void updateLateness(uint32_t interval)
+{
+    if ((interval > period) && ((interval - period) > stats.maxLatenessUs))
+    {
+        stats.maxLatenessUs = interval - period;
+    }
+}
+
+static void supervisor_handler(void)
+{
+    uint32_t now = (uint32_t)Timing_GetMicroseconds();
+
+    if (!armed || ((int32_t)(now - nextDeadline) < 0))
+    {
+        return;
+    }
+
+    // One more period passed without a kick
+    nextDeadline += period;
+    stats.missed++;
+    if (stats.consecutive < UINT8_MAX)
+    {
+        stats.consecutive++;
+    }
+    if (stats.consecutive > stats.maxConsecutive)
+    {
+        stats.maxConsecutive = stats.consecutive;
+    }
+    updateLateness(now - lastKick);
+
+    if (!stats.safeStopped && (stats.consecutive >= SUPERVISOR_MAX_MISSED))
+    {
+        stats.safeStopped = true;
+        Motor_EmergencyStop();
+    }
+}
+
+static void watchdog_handler(void)
+{
+    if (alive)
+    {
+        alive = false;
+        Cy_WDT_ClearInterrupt();
+    }
+    else
+    {
+        // Leave the match unserviced, the WDT resets the MCU if no kick comes
+        Cy_WDT_MaskInterrupt();
+    }
+}
+
+void Supervisor_Init(uint32_t periodUs, uint32_t slackUs)
+{
+    period = periodUs;
+    deadline = periodUs + slackUs;
+
+    stats = (SupervisorStats){0};
+    stats.watchdogReset = ((Cy_SysLib_GetResetReason() & CY_SYSLIB_RESET_HWWDT) != 0u);
+    Cy_SysLib_ClearResetReason();
+
+    lastKick = (uint32_t)Timing_GetMicroseconds();
+    nextDeadline = lastKick + deadline;
+    alive = true;
+    Cy_SysTick_SetCallback(SUPERVISOR_SYSTICK_CALLBACK, supervisor_handler);
+
+    Cy_WDT_Init();
+    Cy_WDT_SetIgnoreBits(SUPERVISOR_WDT_IGNORE_BITS);
+    Cy_WDT_UnmaskInterrupt();
+    (void)Cy_SysInt_Init(&watchdogIrqConfig, watchdog_handler);
+    NVIC_EnableIRQ(watchdogIrqConfig.intrSrc);
+    Cy_WDT_Enable();
+    Cy_WDT_Lock();
+}
+
+void Supervisor_Kick(void)
+{
+    uint32_t interruptState = Cy_SysLib_EnterCriticalSection();
+    uint32_t now = (uint32_t)Timing_GetMicroseconds();
+
+    if (armed)
+    {
+        updateLateness(now - lastKick);
+    }
+    lastKick = now;
+    nextDeadline = now + deadline;
+    stats.consecutive = 0;
+    alive = true;
+
+    // A late kick after an unserviced match brings the WDT interrupt back
+    Cy_WDT_UnmaskInterrupt();
+
+    Cy_SysLib_ExitCriticalSection(interruptState);
+}
+
+void Supervisor_SetArmed(bool enabled)
+{
+    uint32_t interruptState = Cy_SysLib_EnterCriticalSection();
+
+    // Deadlines count from now, time spent disarmed is not lateness
+    lastKick = (uint32_t)Timing_GetMicroseconds();
+    nextDeadline = lastKick + deadline;
+    stats.consecutive = 0;
+    armed = enabled;
+
+    Cy_SysLib_ExitCriticalSection(interruptState);
+}
+
+void Supervisor_Rearm(void)
+{
+    uint32_t interruptState = Cy_SysLib_EnterCriticalSection();
+    stats.safeStopped = false;
+    stats.consecutive = 0;
+    Motor_Unlock();
+    Cy_SysLib_ExitCriticalSection(interruptState);
+}
+
+bool Supervisor_IsSafeStopped(void)
+{
+    return stats.safeStopped;
+}
+
+void Supervisor_GetStats(SupervisorStats* copy)
+{
+    uint32_t interruptState = Cy_SysLib_EnterCriticalSection();
+    *copy = stats;
+    Cy_SysLib_ExitCriticalSection(interruptState);
+}
+
+/* [] END OF FILE */
@@ -0,0 +1,61 @@
+#ifndef SUPERVISOR_H
+#define SUPERVISOR_H
+
+#ifdef __cplusplus
+extern "C" {
+#endif
+
+#include <stdint.h>
+#include <stdbool.h>
+
+// Control loop deadline supervisor and watchdog.
+//
+// The control task calls Supervisor_Kick() every period. A SysTick callback
+// (1 kHz) checks that the next kick comes within period + slack. Every period
+// without a kick after that deadline is a missed deadline; misses and the worst
+// lateness are counted while armed (motors enabled). SUPERVISOR_MAX_MISSED
+// consecutive misses stop the motors with Motor_EmergencyStop(): polled I2C
+// from the interrupt, independent of the driver the stalled loop may be stuck
+// in. Motors stay locked until Supervisor_Rearm().
+//
+// The hardware WDT backs this up for stalls the SysTick check cannot handle
+// (interrupts disabled, SysTick stuck). Its interrupt is serviced only when the
+// loop kicked since the previous match; otherwise it is left pending and the WDT
+// resets the MCU on the third unserviced match. Motor_Init() starts with all
+// outputs off after such a reset.
+
+#define SUPERVISOR_SYSTICK_CALLBACK (3u)
+#define SUPERVISOR_MAX_MISSED       (5u)
+#define SUPERVISOR_WDT_IGNORE_BITS  (5u)    // WDT match every 2^11 ILO cycles (~64 ms), reset after ~190 ms without kicks
+
+typedef struct
+{
+    uint32_t missed;            // Deadlines missed since Supervisor_Init()
+    uint32_t maxLatenessUs;     // Worst time past a period between two kicks
+    uint8_t consecutive;        // Deadlines missed since the last kick
+    uint8_t maxConsecutive;
+    bool safeStopped;           // Motors were stopped by the supervisor
+    bool watchdogReset;         // Last MCU reset came from the WDT
+} SupervisorStats;
+
+// Start deadline checks and the WDT. Kicks must follow from now on.
+void Supervisor_Init(uint32_t periodUs, uint32_t slackUs);
+
+// Control loop heartbeat, also feeds the WDT
+void Supervisor_Kick(void);
+
+// Deadlines are checked only while armed (motors enabled)
+void Supervisor_SetArmed(bool enabled);
+
+// Unlock motors after a safe stop
+void Supervisor_Rearm(void);
+bool Supervisor_IsSafeStopped(void);
+
+// Consistent copy of the statistics
+void Supervisor_GetStats(SupervisorStats* stats);
+
+#ifdef __cplusplus
+}
+#endif
+
+#endif /* SUPERVISOR_H */
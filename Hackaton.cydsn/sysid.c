@@ -0,0 +1,156 @@
+/* ========================================
+ * sysid.c
+ * ========================================
+ */
+
+#include "sysid.h"
+#include <math.h>
+
+#define TWO_PI          (6.2831853f)
+#define PRBS_SEED       (0x1FFu)
+
+static enum sysidState state = SYSID_IDLE;
+static enum sysidSignal signalType = SYSID_SIGNAL_CHIRP;
+static float amplitude;
+static uint32_t samplePeriodUs;
+
+static int16_t capture[SYSID_SAMPLES][SYSID_CHANNELS];
+static uint16_t count;
+static uint8_t decimation;      // Control periods until the next sample
+
+// Chirp: frequency grows by a constant factor every control period
+static float phase;
+static float phaseStep;         // Radians per control period at the current frequency
+static float phaseGrowth;
+
+// PRBS: shift register and periods left on the current bit
+static uint16_t lfsr;
+static uint8_t hold;
+
+static int16_t saturate(float value)
+{
+    if (value > 32767.0f)
+    {
+        return 32767;
+    }
+    if (value < -32768.0f)
+    {
+        return -32768;
+    }
+    return (int16_t)value;
+}
+
+static float nextExcitation(void)
+{
+    if (signalType == SYSID_SIGNAL_PRBS)
+    {
+        if (hold == 0u)
+        {
+            uint16_t bit = ((lfsr >> 8) ^ (lfsr >> 4)) & 0x01u;
+            lfsr = (uint16_t)(((lfsr << 1) | bit) & 0x1FFu);
+            hold = SYSID_PRBS_HOLD;
+        }
+        hold--;
+        return (lfsr & 0x01u) ? amplitude : -amplitude;
+    }
+
+    float excitation = amplitude * sinf(phase);
+    phase += phaseStep;
+    if (phase > TWO_PI)
+    {
+        phase -= TWO_PI;
+    }
+    phaseStep *= phaseGrowth;
+    return excitation;
+}
+
+void Sysid_Start(enum sysidSignal signal, float excitationAmplitude, uint32_t periodUs)
+{
+    signalType = (signal == SYSID_SIGNAL_PRBS) ? SYSID_SIGNAL_PRBS : SYSID_SIGNAL_CHIRP;
+    amplitude = (excitationAmplitude > 0.0f) ? excitationAmplitude : SYSID_AMPLITUDE;
+    samplePeriodUs = periodUs * SYSID_DECIMATION;
+    count = 0u;
+    decimation = 0u;
+
+    float periods = (float)SYSID_SAMPLES * (float)SYSID_DECIMATION;
+    phase = 0.0f;
+    phaseStep = TWO_PI * SYSID_CHIRP_START_HZ * (float)periodUs * 1.0e-6f;
+    phaseGrowth = powf(SYSID_CHIRP_END_HZ / SYSID_CHIRP_START_HZ, 1.0f / periods);
+
+    lfsr = PRBS_SEED;
+    hold = 0u;
+
+    state = SYSID_RUNNING;
+}
+
+void Sysid_Abort(void)
+{
+    if (state == SYSID_RUNNING)
+    {
+        state = SYSID_ABORTED;
+    }
+}
+
+enum sysidState Sysid_GetState(void)
+{
+    return state;
+}
+
+bool Sysid_IsRunning(void)
+{
+    return state == SYSID_RUNNING;
+}
+
+enum sysidSignal Sysid_GetSignal(void)
+{
+    return signalType;
+}
+
+float Sysid_GetAmplitude(void)
+{
+    return amplitude;
+}
+
+float Sysid_Update(float error, float correction)
+{
+    if (state != SYSID_RUNNING)
+    {
+        return correction;
+    }
+
+    float excitation = nextExcitation();
+    float command = correction + excitation;
+
+    if (decimation == 0u)
+    {
+        capture[count][SYSID_CHANNEL_POSITION] = saturate(error * 1000.0f);
+        capture[count][SYSID_CHANNEL_COMMAND] = saturate(command);
+        capture[count][SYSID_CHANNEL_EXCITATION] = saturate(excitation);
+        count++;
+        decimation = SYSID_DECIMATION;
+        if (count >= SYSID_SAMPLES)
+        {
+            state = SYSID_DONE;
+        }
+    }
+    decimation--;
+
+    return command;
+}
+
+uint16_t Sysid_GetCount(void)
+{
+    return count;
+}
+
+uint32_t Sysid_GetSamplePeriodUs(void)
+{
+    return samplePeriodUs;
+}
+
+const int16_t* Sysid_GetSample(uint16_t index)
+{
+    return capture[index];
+}
+
+/* [] END OF FILE */
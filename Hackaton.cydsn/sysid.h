@@ -0,0 +1,82 @@
+#ifndef SYSID_H
+#define SYSID_H
+
+#ifdef __cplusplus
+extern "C" {
+#endif
+
+#include <stdint.h>
+#include <stdbool.h>
+
+// System identification of the steering plant (correction to line position).
+//
+// While running, an excitation is added on top of the steering correction of the
+// active controller and every SYSID_DECIMATION-th control period one sample is
+// recorded into a RAM buffer:
+//   position    line error x1000
+//   command     correction sent to the motion layer (controller output + excitation)
+//   excitation  the added signal
+// The loop stays closed, so the car keeps following the line during the capture;
+// the amplitude has to leave enough steering for that. Signals:
+//   SYSID_SIGNAL_CHIRP  sine sweeping exponentially from SYSID_CHIRP_START_HZ to
+//                       SYSID_CHIRP_END_HZ over the whole capture
+//   SYSID_SIGNAL_PRBS   +-amplitude from a 9-bit LFSR (x^9 + x^5 + 1), every bit
+//                       held SYSID_PRBS_HOLD control periods
+// The capture stops when the buffer is full. tools/sysid.py downloads it
+// (TELEMETRY_FRAME_SYSID_DATA), fits a low-order model and recommends gains.
+
+#define SYSID_SAMPLES           (2048u)     // 12 KB, 8.2 s at the default rate
+#define SYSID_DECIMATION        (2u)        // Control periods per sample, 4 ms at 500 Hz
+#define SYSID_AMPLITUDE         (300.0f)    // Motor units
+#define SYSID_CHIRP_START_HZ    (0.2f)
+#define SYSID_CHIRP_END_HZ      (8.0f)
+#define SYSID_PRBS_HOLD         (10u)       // Control periods per bit, 20 ms at 500 Hz
+
+enum sysidState
+{
+    SYSID_IDLE      = 0,
+    SYSID_RUNNING   = 1,
+    SYSID_DONE      = 2,
+    SYSID_ABORTED   = 3,    // Stopped early, the samples recorded so far are kept
+};
+
+enum sysidSignal
+{
+    SYSID_SIGNAL_CHIRP  = 0,
+    SYSID_SIGNAL_PRBS   = 1,
+};
+
+enum sysidChannel
+{
+    SYSID_CHANNEL_POSITION      = 0,
+    SYSID_CHANNEL_COMMAND       = 1,
+    SYSID_CHANNEL_EXCITATION    = 2,
+    SYSID_CHANNELS              = 3,
+};
+
+// Start a capture. amplitude 0 selects SYSID_AMPLITUDE, periodUs is the control period.
+void Sysid_Start(enum sysidSignal signal, float amplitude, uint32_t periodUs);
+void Sysid_Abort(void);
+
+enum sysidState Sysid_GetState(void);
+bool Sysid_IsRunning(void);
+enum sysidSignal Sysid_GetSignal(void);
+float Sysid_GetAmplitude(void);
+
+// Add excitation to the controller correction for line error measured this
+// control period and record the sample. Returns the correction to apply.
+// Call every control period while Sysid_IsRunning().
+float Sysid_Update(float error, float correction);
+
+// Recorded samples, valid when not running
+uint16_t Sysid_GetCount(void);
+uint32_t Sysid_GetSamplePeriodUs(void);
+
+// SYSID_CHANNELS values of sample index, following samples are contiguous
+const int16_t* Sysid_GetSample(uint16_t index);
+
+#ifdef __cplusplus
+}
+#endif
+
+#endif /* SYSID_H */
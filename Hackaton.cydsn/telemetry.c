@@ -0,0 +1,285 @@
+/* ========================================
+ * telemetry.c
+ * ========================================
+ */
+
+#include "telemetry.h"
+#include "car.h"
+#include "cm4_common.h"
+
+// Message must stay untouched until CM0 releases it, so it is not shared with other senders
+static ipc_msg_t telemetryMsg = {
+    .clientId = IPC_CM4_TO_CM0_CLIENT_ID,
+    .userCode = IPC_USR_CODE_CMD,
+    .intrMask = CY_SYS_CYPIPE_INTR_MASK,
+    .buffer   = {},
+    .len      = 0
+};
+
+// Posted frames waiting for CM0, header included
+static uint8_t pendingFrames[TELEMETRY_PENDING_FRAMES][TELEMETRY_MAX_FRAME_SIZE];
+static uint8_t pendingLength[TELEMETRY_PENDING_FRAMES];
+static uint8_t pendingTail = 0;
+static uint8_t pendingCount = 0;
+
+// Header and payload into frame, returns the frame size
+static uint8_t buildFrame(uint8_t* frame, uint8_t frameType, const uint8_t* payload, uint8_t len)
+{
+    frame[0] = frameType;
+    (void)Telemetry_PutU32(&frame[1], (uint32_t)Timing_GetMicroseconds());
+    memcpy(&frame[TELEMETRY_HEADER_SIZE], payload, len);
+    return TELEMETRY_HEADER_SIZE + len;
+}
+
+// Hand a frame already in telemetryMsg to CM0
+static bool sendMessage(uint8_t frameSize)
+{
+    // [0] tells CM0 to relay the rest of the buffer as a notification
+    telemetryMsg.buffer[0] = CM0_SHARED_BLE_NTF_RELAY;
+    telemetryMsg.len = 1u + frameSize;
+
+    return CM4_SendCM0Message(&telemetryMsg);
+}
+
+uint8_t Telemetry_PutU16(uint8_t* buffer, uint16_t value)
+{
+    buffer[0] = (uint8_t)(value & 0xFFu);
+    buffer[1] = (uint8_t)(value >> 8);
+    return 2u;
+}
+
+uint8_t Telemetry_PutU32(uint8_t* buffer, uint32_t value)
+{
+    for (uint8_t byte_n = 0; byte_n < 4u; byte_n++)
+    {
+        buffer[byte_n] = (uint8_t)((value >> (8u * byte_n)) & 0xFFu);
+    }
+    return 4u;
+}
+
+uint8_t Telemetry_PutFloat(uint8_t* buffer, float value)
+{
+    uint32_t raw;
+    memcpy(&raw, &value, sizeof(raw));
+    return Telemetry_PutU32(buffer, raw);
+}
+
+void Telemetry_Flush(void)
+{
+    while ((pendingCount > 0u) && CM4_IsCM0Ready())
+    {
+        memcpy(&telemetryMsg.buffer[1], pendingFrames[pendingTail], pendingLength[pendingTail]);
+        if (!sendMessage(pendingLength[pendingTail]))
+        {
+            // IPC refused, try again on the next flush
+            return;
+        }
+        pendingTail = (uint8_t)((pendingTail + 1u) % TELEMETRY_PENDING_FRAMES);
+        pendingCount--;
+    }
+}
+
+uint8_t Telemetry_GetPendingCount(void)
+{
+    return pendingCount;
+}
+
+bool Telemetry_SendFrame(uint8_t frameType, const uint8_t* payload, uint8_t len)
+{
+    if (len > TELEMETRY_MAX_PAYLOAD_SIZE)
+    {
+        return false;
+    }
+
+    // Posted frames first, a periodic one never overtakes them
+    Telemetry_Flush();
+    if ((pendingCount > 0u) || !CM4_IsCM0Ready())
+    {
+        return false;
+    }
+
+    return sendMessage(buildFrame(&telemetryMsg.buffer[1], frameType, payload, len));
+}
+
+bool Telemetry_PostFrame(uint8_t frameType, const uint8_t* payload, uint8_t len)
+{
+    if (len > TELEMETRY_MAX_PAYLOAD_SIZE)
+    {
+        return false;
+    }
+
+    Telemetry_Flush();
+    if ((pendingCount == 0u) && CM4_IsCM0Ready() &&
+        sendMessage(buildFrame(&telemetryMsg.buffer[1], frameType, payload, len)))
+    {
+        return true;
+    }
+    if (pendingCount >= TELEMETRY_PENDING_FRAMES)
+    {
+        return false;
+    }
+
+    uint8_t head = (uint8_t)((pendingTail + pendingCount) % TELEMETRY_PENDING_FRAMES);
+    pendingLength[head] = buildFrame(pendingFrames[head], frameType, payload, len);
+    pendingCount++;
+    return true;
+}
+
+bool Telemetry_SendEvent(uint8_t event, int32_t argument)
+{
+    uint8_t payload[5];
+    payload[0] = event;
+    (void)Telemetry_PutU32(&payload[1], (uint32_t)argument);
+    return Telemetry_PostFrame(TELEMETRY_FRAME_EVENT, payload, sizeof(payload));
+}
+
+bool Telemetry_SendControl(int16_t position, int16_t correction, int16_t leftSpeed, int16_t rightSpeed)
+{
+    uint8_t payload[8];
+    uint8_t len = 0;
+    len += Telemetry_PutU16(&payload[len], (uint16_t)position);
+    len += Telemetry_PutU16(&payload[len], (uint16_t)correction);
+    len += Telemetry_PutU16(&payload[len], (uint16_t)leftSpeed);
+    len += Telemetry_PutU16(&payload[len], (uint16_t)rightSpeed);
+    return Telemetry_SendFrame(TELEMETRY_FRAME_CONTROL, payload, len);
+}
+
+bool Telemetry_SendAutotune(uint8_t state, float ku, float tu, int16_t kp, int16_t ki, int16_t kd)
+{
+    uint8_t payload[15];
+    uint8_t len = 0;
+    payload[len++] = state;
+    len += Telemetry_PutFloat(&payload[len], ku);
+    len += Telemetry_PutFloat(&payload[len], tu);
+    len += Telemetry_PutU16(&payload[len], (uint16_t)kp);
+    len += Telemetry_PutU16(&payload[len], (uint16_t)ki);
+    len += Telemetry_PutU16(&payload[len], (uint16_t)kd);
+    return Telemetry_PostFrame(TELEMETRY_FRAME_AUTOTUNE, payload, len);
+}
+
+bool Telemetry_SendControllerCost(uint8_t controller, uint32_t lastCycles, uint32_t maxCycles, uint32_t meanCycles)
+{
+    uint8_t payload[13];
+    uint8_t len = 0;
+    payload[len++] = controller;
+    len += Telemetry_PutU32(&payload[len], lastCycles);
+    len += Telemetry_PutU32(&payload[len], maxCycles);
+    len += Telemetry_PutU32(&payload[len], meanCycles);
+    return Telemetry_SendFrame(TELEMETRY_FRAME_CONTROLLER, payload, len);
+}
+
+bool Telemetry_SendRecovery(uint8_t event, uint16_t recoveries, uint16_t failures, uint32_t lastTimeUs, uint32_t maxTimeUs)
+{
+    uint8_t payload[13];
+    uint8_t len = 0;
+    payload[len++] = event;
+    len += Telemetry_PutU16(&payload[len], recoveries);
+    len += Telemetry_PutU16(&payload[len], failures);
+    len += Telemetry_PutU32(&payload[len], lastTimeUs);
+    len += Telemetry_PutU32(&payload[len], maxTimeUs);
+    return Telemetry_PostFrame(TELEMETRY_FRAME_RECOVERY, payload, len);
+}
+
+bool Telemetry_SendTrackFeature(uint8_t feature, uint16_t lap, uint8_t segment, uint32_t lapTimeUs, uint32_t lastLapTimeUs)
+{
+    uint8_t payload[12];
+    uint8_t len = 0;
+    payload[len++] = feature;
+    len += Telemetry_PutU16(&payload[len], lap);
+    payload[len++] = segment;
+    len += Telemetry_PutU32(&payload[len], lapTimeUs);
+    len += Telemetry_PutU32(&payload[len], lastLapTimeUs);
+    return Telemetry_PostFrame(TELEMETRY_FRAME_FEATURE, payload, len);
+}
+
+bool Telemetry_SendPose(float x, float y, float heading, float distance)
+{
+    uint8_t payload[10];
+    uint8_t len = 0;
+    len += Telemetry_PutU16(&payload[len], (uint16_t)(int16_t)(x * 1000.0f));
+    len += Telemetry_PutU16(&payload[len], (uint16_t)(int16_t)(y * 1000.0f));
+    len += Telemetry_PutU16(&payload[len], (uint16_t)(int16_t)(heading * 1000.0f));
+    len += Telemetry_PutU32(&payload[len], (uint32_t)(int32_t)(distance * 1000.0f));
+    return Telemetry_SendFrame(TELEMETRY_FRAME_POSE, payload, len);
+}
+
+bool Telemetry_SendCalibration(uint8_t state, const int16_t deadband[], float fullScaleSpeed)
+{
+    uint8_t payload[13];
+    uint8_t len = 0;
+    payload[len++] = state;
+    for (uint8_t motor = 0; motor < MOTOR_COUNT; motor++)
+    {
+        len += Telemetry_PutU16(&payload[len], (uint16_t)deadband[motor]);
+    }
+    len += Telemetry_PutFloat(&payload[len], fullScaleSpeed);
+    return Telemetry_PostFrame(TELEMETRY_FRAME_CALIBRATION, payload, len);
+}
+
+bool Telemetry_SendSupervisor(uint32_t missed, uint32_t maxLatenessUs, uint8_t maxConsecutive, bool safeStopped, bool watchdogReset)
+{
+    uint8_t payload[10];
+    uint8_t len = 0;
+    len += Telemetry_PutU32(&payload[len], missed);
+    len += Telemetry_PutU32(&payload[len], maxLatenessUs);
+    payload[len++] = maxConsecutive;
+    payload[len++] = (safeStopped ? 0x01u : 0x00u) | (watchdogReset ? 0x02u : 0x00u);
+    return Telemetry_SendFrame(TELEMETRY_FRAME_SUPERVISOR, payload, len);
+}
+
+bool Telemetry_SendOscillation(uint8_t action, float frequency, float amplitude, int16_t kp, int16_t kd, int16_t baseSpeed)
+{
+    uint8_t payload[15];
+    uint8_t len = 0;
+    payload[len++] = action;
+    len += Telemetry_PutFloat(&payload[len], frequency);
+    len += Telemetry_PutFloat(&payload[len], amplitude);
+    len += Telemetry_PutU16(&payload[len], (uint16_t)kp);
+    len += Telemetry_PutU16(&payload[len], (uint16_t)kd);
+    len += Telemetry_PutU16(&payload[len], (uint16_t)baseSpeed);
+    return Telemetry_PostFrame(TELEMETRY_FRAME_OSCILLATION, payload, len);
+}
+
+bool Telemetry_SendSysid(uint8_t state, uint8_t signal, uint16_t samples, uint32_t samplePeriodUs, int16_t amplitude, int16_t baseSpeed)
+{
+    uint8_t payload[12];
+    uint8_t len = 0;
+    payload[len++] = state;
+    payload[len++] = signal;
+    len += Telemetry_PutU16(&payload[len], samples);
+    len += Telemetry_PutU32(&payload[len], samplePeriodUs);
+    len += Telemetry_PutU16(&payload[len], (uint16_t)amplitude);
+    len += Telemetry_PutU16(&payload[len], (uint16_t)baseSpeed);
+    return Telemetry_SendFrame(TELEMETRY_FRAME_SYSID, payload, len);
+}
+
+bool Telemetry_SendSysidData(uint16_t index, const int16_t values[], uint8_t count)
+{
+    uint8_t payload[14];
+    uint8_t len = 0;
+    if (count > 6u)
+    {
+        count = 6u;
+    }
+    len += Telemetry_PutU16(&payload[len], index);
+    for (uint8_t i = 0; i < count; i++)
+    {
+        len += Telemetry_PutU16(&payload[len], (uint16_t)values[i]);
+    }
+    return Telemetry_SendFrame(TELEMETRY_FRAME_SYSID_DATA, payload, len);
+}
+
+bool Telemetry_SendI2c(uint16_t lastMotorUs, uint16_t maxMotorUs, uint32_t transactions, uint16_t errors, uint16_t full, uint8_t maxDepth)
+{
+    uint8_t payload[13];
+    uint8_t len = 0;
+    len += Telemetry_PutU16(&payload[len], lastMotorUs);
+    len += Telemetry_PutU16(&payload[len], maxMotorUs);
+    len += Telemetry_PutU32(&payload[len], transactions);
+    len += Telemetry_PutU16(&payload[len], errors);
+    len += Telemetry_PutU16(&payload[len], full);
+    payload[len++] = maxDepth;
+    return Telemetry_SendFrame(TELEMETRY_FRAME_I2C, payload, len);
+}
+
+/* [] END OF FILE */
@@ -0,0 +1,93 @@
+#ifndef TELEMETRY_H
+#define TELEMETRY_H
+
+#ifdef __cplusplus
+extern "C" {
+#endif
+
+#include <stdint.h>
+#include <stdbool.h>
+
+// Telemetry frames are relayed by CM0 to the NUS TX characteristic (CM0_SHARED_BLE_NTF_RELAY).
+// Every frame starts with a 5 byte header, all fields are little-endian:
+//   [0]    frame type (enum telemetryFrameType)
+//   [1..4] timestamp, lower 32 bits of Timing_GetMicroseconds()
+// Frames are kept within the default BLE MTU (20 bytes of payload).
+//
+// CM0 takes one frame at a time. Periodic frames (control, pose, cost,
+// supervisor, I2C) are dropped while it is busy, the next period brings fresh
+// ones. One-shot frames (events, autotune, recovery, track feature,
+// calibration, oscillation) are posted: they wait in a small queue, stamped
+// with the time they were posted, and go out ahead of any periodic frame as
+// soon as CM0 is free. Telemetry_Flush() shall be called often (IPC task).
+
+#define TELEMETRY_HEADER_SIZE       (5u)
+#define TELEMETRY_MAX_FRAME_SIZE    (20u)
+#define TELEMETRY_MAX_PAYLOAD_SIZE  (TELEMETRY_MAX_FRAME_SIZE - TELEMETRY_HEADER_SIZE)
+#define TELEMETRY_PENDING_FRAMES    (8u)    // One-shot frames waiting for CM0
+
+enum telemetryFrameType
+{
+    TELEMETRY_FRAME_EVENT   = 0x01,   // [5] event id, [6..9] int32 argument
+    TELEMETRY_FRAME_CONTROL = 0x02,   // [5..6] position x1000, [7..8] correction, [9..10] left speed, [11..12] right speed
+    TELEMETRY_FRAME_AUTOTUNE = 0x03,  // [5] enum autotuneState, [6..9] Ku (float), [10..13] Tu in s (float), [14..19] Kp, Ki, Kd (int16)
+    TELEMETRY_FRAME_CONTROLLER = 0x04,// [5] active controller id, [6..9] last, [10..13] max, [14..17] mean update cost in CPU cycles
+    TELEMETRY_FRAME_RECOVERY = 0x05,  // [5] enum lineRecoveryEvent, [6..7] recoveries, [8..9] failures, [10..13] last, [14..17] max time to reacquire in us
+    TELEMETRY_FRAME_FEATURE = 0x06,   // [5] enum trackFeature, [6..7] lap, [8] segment, [9..12] time since lap start, [13..16] last lap time in us
+    TELEMETRY_FRAME_POSE = 0x07,      // [5..6] x, [7..8] y in mm, [9..10] heading in mrad, [11..14] distance in mm (int32)
+    TELEMETRY_FRAME_CALIBRATION = 0x08,// [5] enum motorCalibrationState, [6..13] deadband duty of motors 1..4 (int16), [14..17] full scale speed in counts/s (float)
+    TELEMETRY_FRAME_SUPERVISOR = 0x09,// [5..8] missed control deadlines, [9..12] worst lateness in us, [13] most consecutive misses, [14] flags: bit 0 safe stop, bit 1 watchdog reset
+    TELEMETRY_FRAME_OSCILLATION = 0x0A,// [5] enum oscillationAction, [6..9] frequency in Hz, [10..13] amplitude (float), [14..15] Kp, [16..17] Kd, [18..19] base speed (int16)
+    TELEMETRY_FRAME_SYSID = 0x0B,     // [5] enum sysidState, [6] enum sysidSignal, [7..8] samples recorded, [9..12] sample period in us, [13..14] amplitude, [15..16] base speed (int16)
+    TELEMETRY_FRAME_SYSID_DATA = 0x0C,// [5..6] index of the first sample, then 1 or 2 samples of position x1000, command, excitation (int16)
+    TELEMETRY_FRAME_I2C = 0x0D,       // [5..6] last, [7..8] worst motor update bus time in us, [9..12] I2C transactions, [13..14] errors, [15..16] submissions refused for a full queue, [17] deepest queue
+};
+
+enum telemetryEvent
+{
+    TELEMETRY_EVENT_CAR_STARTED = 0x01,
+    TELEMETRY_EVENT_CAR_STOPPED = 0x02,
+    TELEMETRY_EVENT_AUTOTUNE_STARTED = 0x03,    // argument: relay amplitude
+    TELEMETRY_EVENT_CONTROLLER_SELECTED = 0x04, // argument: controller id
+    TELEMETRY_EVENT_LINE_LOST = 0x05,           // argument: side the line was last seen on, -1 left, +1 right
+    TELEMETRY_EVENT_TRACK_MAP_SAVED = 0x06,     // argument: number of segments written to flash
+    TELEMETRY_EVENT_CALIBRATION_STARTED = 0x07,
+    TELEMETRY_EVENT_SAFE_STOP = 0x08,           // argument: worst control loop lateness in us
+    TELEMETRY_EVENT_SYSID_STARTED = 0x09,       // argument: excitation amplitude
+};
+
+// Send a raw frame. Returns false (frame dropped) if CM0 has not consumed the previous one yet
+// or posted frames are still waiting.
+bool Telemetry_SendFrame(uint8_t frameType, const uint8_t* payload, uint8_t len);
+
+// Send a raw frame, or queue it until CM0 is free. Returns false (frame dropped) if the queue is full.
+bool Telemetry_PostFrame(uint8_t frameType, const uint8_t* payload, uint8_t len);
+
+// Pass posted frames to CM0 while it is free
+void Telemetry_Flush(void);
+uint8_t Telemetry_GetPendingCount(void);
+
+bool Telemetry_SendEvent(uint8_t event, int32_t argument);
+bool Telemetry_SendControl(int16_t position, int16_t correction, int16_t leftSpeed, int16_t rightSpeed);
+bool Telemetry_SendAutotune(uint8_t state, float ku, float tu, int16_t kp, int16_t ki, int16_t kd);
+bool Telemetry_SendControllerCost(uint8_t controller, uint32_t lastCycles, uint32_t maxCycles, uint32_t meanCycles);
+bool Telemetry_SendRecovery(uint8_t event, uint16_t recoveries, uint16_t failures, uint32_t lastTimeUs, uint32_t maxTimeUs);
+bool Telemetry_SendTrackFeature(uint8_t feature, uint16_t lap, uint8_t segment, uint32_t lapTimeUs, uint32_t lastLapTimeUs);
+bool Telemetry_SendPose(float x, float y, float heading, float distance);   // Metres and radians
+bool Telemetry_SendCalibration(uint8_t state, const int16_t deadband[], float fullScaleSpeed);
+bool Telemetry_SendSupervisor(uint32_t missed, uint32_t maxLatenessUs, uint8_t maxConsecutive, bool safeStopped, bool watchdogReset);
+bool Telemetry_SendOscillation(uint8_t action, float frequency, float amplitude, int16_t kp, int16_t kd, int16_t baseSpeed);
+bool Telemetry_SendSysid(uint8_t state, uint8_t signal, uint16_t samples, uint32_t samplePeriodUs, int16_t amplitude, int16_t baseSpeed);
+bool Telemetry_SendSysidData(uint16_t index, const int16_t values[], uint8_t count);   // count values of whole samples, up to 6
+bool Telemetry_SendI2c(uint16_t lastMotorUs, uint16_t maxMotorUs, uint32_t transactions, uint16_t errors, uint16_t full, uint8_t maxDepth);
+
+// Little-endian helpers for building frame payloads
+uint8_t Telemetry_PutU16(uint8_t* buffer, uint16_t value);
+uint8_t Telemetry_PutU32(uint8_t* buffer, uint32_t value);
+uint8_t Telemetry_PutFloat(uint8_t* buffer, float value);   // IEEE 754 single, little-endian
+
+#ifdef __cplusplus
+}
+#endif
+
+#endif /* TELEMETRY_H */
@@ -0,0 +1,231 @@
+/* ========================================
+ * track_features.c
+ * ========================================
+ */
+
+#include "track_features.h"
+#include "line_position.h"
+#include <stddef.h>
+
+// Pattern classes, one history register each
+#define CLASS_FULL      (0x01u)     // 0x7F
+#define CLASS_EMPTY     (0x02u)     // 0x00
+#define CLASS_MARK      (0x04u)     // Line on the centre sensor, other runs narrow at an edge
+#define CLASS_BRANCH    (0x08u)     // Run of 4+ sensors touching an edge, or other split patterns
+
+#define FULL_PATTERN    ((uint8_t)(LINE_PATTERN_COUNT - 1u))
+#define EDGE_SENSORS    ((uint8_t)(0x01u | (1u << (LINE_SENSOR_COUNT - 1u))))
+#define CENTRE_SENSOR   ((uint8_t)(1u << (LINE_SENSOR_COUNT / 2u)))
+#define WIDE_MIN_SENSORS (4u)
+
+// Run of exactly n ones ending at the newest bit: bits 0..n-1 set, bit n clear.
+// Matches once per run, on the tick the run reaches length n.
+#define RUN_MASK(n)     ((1u << ((n) + 1u)) - 1u)
+#define RUN_VALUE(n)    ((1u << (n)) - 1u)
+#define RUN_STARTS(n, history)  (((history) & RUN_MASK(n)) == RUN_VALUE(n))
+// Run of at least n ones that ended on the newest bit: bit 0 clear, bits 1..n set
+#define RUN_ENDED(n, history)   (((history) & ((RUN_VALUE(n) << 1) | 1u)) == (RUN_VALUE(n) << 1))
+
+#define GUARD_MASK      ((1u << TRACK_CROSSING_GUARD_TICKS) - 1u)
+
+static uint8_t patternClass[LINE_PATTERN_COUNT];
+
+static uint32_t fullHistory;
+static uint32_t emptyHistory;
+static uint32_t markHistory;
+static uint32_t branchHistory;
+
+static TrackFeatures_Callback subscribers[TRACK_MAX_SUBSCRIBERS];
+static uint8_t subscriberCount = 0;
+
+static bool lapStarted;
+static uint16_t lapCount;
+static uint64_t lapStartTime;
+static uint32_t lastLapTime;
+static TrackSegment segments[TRACK_MAX_SEGMENTS];
+static uint8_t segmentCount;
+
+static uint8_t countBits(uint8_t value)
+{
+    uint8_t count = 0;
+    for (; value != 0u; value &= (uint8_t)(value - 1u))
+    {
+        count++;
+    }
+    return count;
+}
+
+// Every run is either the line (on the centre sensor) or a narrow group at an edge
+static bool isSideMark(uint8_t pattern)
+{
+    if ((pattern & CENTRE_SENSOR) == 0u)
+    {
+        return false;
+    }
+    for (uint8_t rest = pattern; rest != 0u; )
+    {
+        // Adding the lowest set bit clears the run it starts
+        uint8_t lowest = rest & (uint8_t)-rest;
+        uint8_t run = rest & (uint8_t)~(uint8_t)(rest + lowest);
+        if (((run & CENTRE_SENSOR) == 0u) &&
+            (((run & EDGE_SENSORS) == 0u) || (countBits(run) > TRACK_MARKER_MAX_SENSORS)))
+        {
+            return false;
+        }
+        rest &= (uint8_t)~run;
+    }
+    return true;
+}
+
+static uint8_t classify(uint8_t pattern)
+{
+    if (pattern == 0u)
+    {
+        return CLASS_EMPTY;
+    }
+    if (pattern == FULL_PATTERN)
+    {
+        return CLASS_FULL;
+    }
+
+    // Active sensor whose lower neighbour is inactive starts a run
+    uint8_t runs = countBits(pattern & (uint8_t)~(pattern << 1));
+    if (runs > 1u)
+    {
+        return isSideMark(pattern) ? CLASS_MARK : CLASS_BRANCH;
+    }
+    if ((countBits(pattern) >= WIDE_MIN_SENSORS) && ((pattern & EDGE_SENSORS) != 0u))
+    {
+        return CLASS_BRANCH;
+    }
+    return 0u;
+}
+
+static void publish(enum trackFeature feature, uint64_t now)
+{
+    TrackFeatureEvent event;
+
+    if (feature == TRACK_FEATURE_START_FINISH)
+    {
+        if (lapStarted)
+        {
+            lastLapTime = (uint32_t)(now - lapStartTime);
+            lapCount++;
+        }
+        lapStarted = true;
+        lapStartTime = now;
+        segmentCount = 0;
+    }
+
+    uint32_t lapTime = lapStarted ? (uint32_t)(now - lapStartTime) : 0u;
+    if (segmentCount < TRACK_MAX_SEGMENTS)
+    {
+        segments[segmentCount].feature = feature;
+        segments[segmentCount].lapTime = lapTime;
+        segmentCount++;
+    }
+
+    event.feature = feature;
+    event.lap = lapCount;
+    event.segment = segmentCount - 1u;
+    event.time = now;
+    event.lapTime = lapTime;
+    event.lastLapTime = lastLapTime;
+
+    for (uint8_t i = 0; i < subscriberCount; i++)
+    {
+        subscribers[i](&event);
+    }
+}
+
+void TrackFeatures_Init(void)
+{
+    for (uint16_t pattern = 0; pattern < LINE_PATTERN_COUNT; pattern++)
+    {
+        patternClass[pattern] = classify((uint8_t)pattern);
+    }
+    subscriberCount = 0;
+    TrackFeatures_Reset(0u);
+}
+
+void TrackFeatures_Reset(uint64_t now)
+{
+    fullHistory = 0u;
+    emptyHistory = 0u;
+    markHistory = 0u;
+    branchHistory = 0u;
+
+    lapStarted = false;
+    lapCount = 0;
+    lapStartTime = now;
+    lastLapTime = 0u;
+    segmentCount = 0;
+}
+
+bool TrackFeatures_Subscribe(TrackFeatures_Callback callback)
+{
+    if ((callback == NULL) || (subscriberCount >= TRACK_MAX_SUBSCRIBERS))
+    {
+        return false;
+    }
+    subscribers[subscriberCount++] = callback;
+    return true;
+}
+
+void TrackFeatures_Update(uint8_t sensors, uint64_t now)
+{
+    uint8_t flags = patternClass[sensors & FULL_PATTERN];
+
+    fullHistory = (fullHistory << 1) | ((flags & CLASS_FULL) ? 1u : 0u);
+    emptyHistory = (emptyHistory << 1) | ((flags & CLASS_EMPTY) ? 1u : 0u);
+    markHistory = (markHistory << 1) | ((flags & CLASS_MARK) ? 1u : 0u);
+    branchHistory = (branchHistory << 1) | ((flags & CLASS_BRANCH) ? 1u : 0u);
+
+    if (RUN_STARTS(TRACK_CROSSING_TICKS, fullHistory))
+    {
+        publish(TRACK_FEATURE_CROSSING, now);
+    }
+    if (RUN_STARTS(TRACK_LINE_END_TICKS, emptyHistory))
+    {
+        publish(TRACK_FEATURE_LINE_END, now);
+    }
+
+    // A crossing entered at an angle shows branch or mark patterns around the full one.
+    // Marks and junctions are decided when their run ends, so a full pattern just
+    // before or inside the run (within the guard window) vetoes them. A fork shows
+    // branch patterns before a mark-like one, they veto the mark the same way.
+    if ((fullHistory & GUARD_MASK) != 0u)
+    {
+        return;
+    }
+    if (RUN_ENDED(TRACK_MARKER_TICKS, markHistory) && ((branchHistory & GUARD_MASK) == 0u))
+    {
+        publish(TRACK_FEATURE_START_FINISH, now);
+    }
+    if (RUN_ENDED(TRACK_JUNCTION_TICKS, branchHistory))
+    {
+        publish(TRACK_FEATURE_JUNCTION, now);
+    }
+}
+
+uint16_t TrackFeatures_GetLapCount(void)
+{
+    return lapCount;
+}
+
+uint32_t TrackFeatures_GetLastLapTime(void)
+{
+    return lastLapTime;
+}
+
+uint8_t TrackFeatures_GetSegmentCount(void)
+{
+    return segmentCount;
+}
+
+const TrackSegment* TrackFeatures_GetSegment(uint8_t index)
+{
+    return (index < segmentCount) ? &segments[index] : NULL;
+}
+
+/* [] END OF FILE */
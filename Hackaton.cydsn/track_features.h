@@ -0,0 +1,94 @@
+#ifndef TRACK_FEATURES_H
+#define TRACK_FEATURES_H
+
+#ifdef __cplusplus
+extern "C" {
+#endif
+
+#include <stdint.h>
+#include <stdbool.h>
+
+// Track feature detector and lap counter.
+//
+// Every sensor pattern is classified once into a few classes (table built at
+// init). Each class keeps a bit-packed history, one bit per Update() call, in a
+// 32-bit shift register, so a feature is matched with a shift, a mask and a
+// compare per tick:
+//   crossing         full-width pattern (0x7F)
+//   start/finish     side mark: the line stays under the centre sensor while narrow
+//                    groups of active sensors appear at the edge of the bar
+//   junction         branch: wide pattern touching one edge (T), or a line split
+//                    into groups that leave the centre sensor dark (Y fork)
+//   line end         run of empty patterns (0x00)
+// Features are confirmed after a run of TRACK_*_TICKS calls (ticks of the control
+// loop, 2 ms at 500 Hz). Start/finish marks count laps; features between two
+// marks split the lap into segments that are timestamped from the lap start.
+//
+// A Y fork splits from the middle of the line, so its branches leave the centre
+// dark before they reach the edges; any branch pattern within the guard window
+// vetoes a mark. A fork still counts as a lap when the car tracks one branch
+// exactly under the centre sensor and the other separates at the edge of the
+// bar without an interior gap first: keep marks away from forks on the track.
+// Other modules subscribe to feature events with TrackFeatures_Subscribe().
+
+#define TRACK_CROSSING_TICKS        (3u)    // Full pattern run that makes a crossing
+#define TRACK_MARKER_TICKS          (3u)    // Side mark run that makes a start/finish mark
+#define TRACK_MARKER_MAX_SENSORS    (2u)    // Widest group of a side mark
+#define TRACK_JUNCTION_TICKS        (4u)    // Branch pattern run that makes a junction
+#define TRACK_LINE_END_TICKS        (25u)   // Empty run that makes a line end, < 32
+#define TRACK_CROSSING_GUARD_TICKS  (16u)   // Marks and branches this close to a full pattern belong to a crossing,
+                                            // marks this close to a branch belong to a fork
+
+#define TRACK_MAX_SEGMENTS          (32u)   // Features remembered per lap
+#define TRACK_MAX_SUBSCRIBERS       (4u)
+
+enum trackFeature
+{
+    TRACK_FEATURE_CROSSING      = 1,
+    TRACK_FEATURE_START_FINISH  = 2,
+    TRACK_FEATURE_JUNCTION      = 3,
+    TRACK_FEATURE_LINE_END      = 4,
+};
+
+typedef struct
+{
+    enum trackFeature feature;
+    uint16_t lap;           // Completed laps when the feature was seen
+    uint8_t segment;        // Index of the segment this feature starts within the lap
+    uint64_t time;          // Microseconds, when the feature was confirmed
+    uint32_t lapTime;       // Microseconds since lap start (0 before the first start/finish mark)
+    uint32_t lastLapTime;   // Duration of the last completed lap, 0 if none
+} TrackFeatureEvent;
+
+typedef struct
+{
+    enum trackFeature feature;  // Feature that starts the segment
+    uint32_t lapTime;           // Microseconds since lap start
+} TrackSegment;
+
+typedef void (*TrackFeatures_Callback)(const TrackFeatureEvent* event);
+
+// Build classification table and clear subscribers
+void TrackFeatures_Init(void);
+
+// Clear history, laps and segments at time now
+void TrackFeatures_Reset(uint64_t now);
+
+// Register a callback for all feature events. Returns false when the table is full.
+bool TrackFeatures_Subscribe(TrackFeatures_Callback callback);
+
+// Feed Track_Read() pattern once per control tick
+void TrackFeatures_Update(uint8_t sensors, uint64_t now);
+
+uint16_t TrackFeatures_GetLapCount(void);
+uint32_t TrackFeatures_GetLastLapTime(void);
+
+// Segments of the current lap, cleared at every start/finish mark (which starts segment 0)
+uint8_t TrackFeatures_GetSegmentCount(void);
+const TrackSegment* TrackFeatures_GetSegment(uint8_t index);
+
+#ifdef __cplusplus
+}
+#endif
+
+#endif /* TRACK_FEATURES_H */
@@ -0,0 +1,457 @@
+/* ========================================
+ * track_map.c
+ * ========================================
+ */
+
+#include "track_map.h"
+#include "project.h"
+#include <stddef.h>
+
+#define TRACK_MAP_MAGIC     (0x50414D54u)   // "TMAP"
+
+// Flash image of the map, must fit one flash row
+typedef struct
+{
+    uint32_t magic;
+    uint8_t count;              // Segments used
+    uint8_t useDistance;        // Encoders worked on the learning lap
+    uint16_t reserved;
+    uint32_t lapTime;           // Milliseconds
+    uint32_t lapDistance;       // Encoder counts
+    TrackMapSegment segments[TRACK_MAP_MAX_SEGMENTS];
+    uint32_t checksum;          // Bitwise inverted sum of all words before it
+} TrackMapData;
+
+typedef union
+{
+    TrackMapData data;
+    uint32_t words[CY_FLASH_SIZEOF_ROW / sizeof(uint32_t)];
+} TrackMapRow;
+
+// Reserved row in the em_eeprom region, erased (invalid map) when the firmware is programmed.
+// Read through volatile so the compiler doesn't fold the initial zeros into the code.
+CY_SECTION(".cy_em_eeprom") CY_ALIGN(CY_FLASH_SIZEOF_ROW)
+static const volatile TrackMapRow trackMapFlash = {0};
+
+static TrackMapRow map;         // Working copy, also the flash write buffer
+static enum trackMapState state = TRACK_MAP_EMPTY;
+static bool dirty = false;
+static bool planningEnabled = false;
+static bool planning = false;   // Map is synchronised with this lap
+
+static float minSpeed = 1000.0f;
+static float maxSpeed = 2000.0f;
+static float plannedSpeed = 0.0f;
+
+// Progress along the lap, in stored distance units or milliseconds
+static uint32_t segmentStart[TRACK_MAP_MAX_SEGMENTS + 1u];
+static uint32_t brakeLookahead;
+static uint32_t exitLead;
+static uint8_t segmentIndex;
+
+static uint64_t lapStartTime;
+static int32_t lapStartDistance;
+static int32_t lastDistance;
+static uint64_t lastTime;
+
+// Learning state
+static uint64_t segmentStartTime;
+static int32_t segmentStartDistance;
+static uint64_t sliceStartTime;
+static float sliceErrorSum;
+static uint16_t sliceSamples;
+
+static uint32_t checksum(const TrackMapRow* row)
+{
+    uint32_t sum = 0u;
+    for (uint32_t i = 0; i < (offsetof(TrackMapData, checksum) / sizeof(uint32_t)); i++)
+    {
+        sum += row->words[i];
+    }
+    return ~sum;
+}
+
+static float curvatureSpeed(uint8_t curvature)
+{
+    switch (curvature)
+    {
+        case TRACK_CURVATURE_STRAIGHT:
+            return maxSpeed;
+        case TRACK_CURVATURE_GENTLE:
+            return 0.5f * (minSpeed + maxSpeed);
+        default:
+            return minSpeed;
+    }
+}
+
+static uint8_t classify(float meanError)
+{
+    if (meanError >= TRACK_MAP_SHARP_ERROR)
+    {
+        return TRACK_CURVATURE_SHARP;
+    }
+    if (meanError >= TRACK_MAP_GENTLE_ERROR)
+    {
+        return TRACK_CURVATURE_GENTLE;
+    }
+    return TRACK_CURVATURE_STRAIGHT;
+}
+
+static uint32_t progress(int32_t distance, uint64_t now)
+{
+    if (map.data.useDistance)
+    {
+        int32_t travelled = distance - lapStartDistance;
+        return (travelled > 0) ? (uint32_t)travelled / TRACK_MAP_DISTANCE_SCALE : 0u;
+    }
+    return (uint32_t)((now - lapStartTime) / 1000u);
+}
+
+// Cumulative segment starts and look-ahead windows in progress units
+static void prepare(void)
+{
+    TrackMapData* data = &map.data;
+    uint32_t start = 0u;
+
+    for (uint8_t i = 0; i < data->count; i++)
+    {
+        segmentStart[i] = start;
+        start += data->useDistance ? data->segments[i].distance : data->segments[i].duration;
+    }
+    segmentStart[data->count] = start;
+
+    // Look-ahead is given in time, convert with the mean speed of the learning lap
+    uint32_t lapTime = (data->lapTime > 0u) ? data->lapTime : 1u;
+    brakeLookahead = (uint32_t)(((uint64_t)start * TRACK_MAP_BRAKE_LOOKAHEAD_MS) / lapTime);
+    exitLead = (uint32_t)(((uint64_t)start * TRACK_MAP_EXIT_LEAD_MS) / lapTime);
+}
+
+// Returns false when the table is full, the last segment then simply grows
+static bool openSegment(uint8_t feature, uint64_t now)
+{
+    TrackMapData* data = &map.data;
+
+    if (data->count >= TRACK_MAP_MAX_SEGMENTS)
+    {
+        return false;
+    }
+
+    TrackMapSegment* segment = &data->segments[data->count++];
+    segment->duration = 0u;
+    segment->distance = 0u;
+    segment->curvature = TRACK_CURVATURE_UNKNOWN;
+    segment->feature = feature;
+    segmentStartTime = now;
+    segmentStartDistance = lastDistance;
+    return true;
+}
+
+static void closeSegment(uint64_t now)
+{
+    TrackMapData* data = &map.data;
+    if (data->count == 0u)
+    {
+        return;
+    }
+
+    TrackMapSegment* segment = &data->segments[data->count - 1u];
+    uint64_t duration = (now - segmentStartTime) / 1000u;
+    int32_t distance = (lastDistance - segmentStartDistance) / TRACK_MAP_DISTANCE_SCALE;
+    segment->duration = (duration > UINT16_MAX) ? UINT16_MAX : (uint16_t)duration;
+    segment->distance = (distance < 0) ? 0u : ((distance > UINT16_MAX) ? UINT16_MAX : (uint16_t)distance);
+    if (segment->curvature == TRACK_CURVATURE_UNKNOWN)
+    {
+        segment->curvature = TRACK_CURVATURE_STRAIGHT;
+    }
+}
+
+static void startLearning(uint64_t now)
+{
+    map.data.count = 0;
+    state = TRACK_MAP_LEARNING;
+    planning = false;
+    sliceStartTime = now;
+    sliceErrorSum = 0.0f;
+    sliceSamples = 0;
+    (void)openSegment(TRACK_FEATURE_START_FINISH, now);
+}
+
+static void finishLearning(uint64_t now)
+{
+    TrackMapData* data = &map.data;
+
+    closeSegment(now);
+    data->magic = TRACK_MAP_MAGIC;
+    data->lapTime = (uint32_t)((now - lapStartTime) / 1000u);
+    data->lapDistance = (lastDistance > lapStartDistance) ? (uint32_t)(lastDistance - lapStartDistance) : 0u;
+    data->useDistance = (data->lapDistance >= TRACK_MAP_MIN_LAP_DISTANCE) ? 1u : 0u;
+    data->checksum = checksum(&map);
+
+    prepare();
+    state = TRACK_MAP_READY;
+    dirty = true;
+}
+
+// Move to the segment started by this feature, the nearest one around the current position
+static void synchronise(uint8_t feature, uint32_t position)
+{
+    const TrackMapData* data = &map.data;
+    uint32_t bestDistance = UINT32_MAX;
+    uint8_t best = segmentIndex;
+
+    for (uint8_t i = 1; i < data->count; i++)
+    {
+        if (data->segments[i].feature != feature)
+        {
+            continue;
+        }
+        uint32_t distance = (segmentStart[i] > position) ? segmentStart[i] - position : position - segmentStart[i];
+        if (distance < bestDistance)
+        {
+            bestDistance = distance;
+            best = i;
+        }
+    }
+
+    if (bestDistance != UINT32_MAX)
+    {
+        // Shift lap start so that progress equals the start of the matched segment
+        int32_t shift = (int32_t)segmentStart[best] - (int32_t)position;
+        if (data->useDistance)
+        {
+            lapStartDistance -= shift * TRACK_MAP_DISTANCE_SCALE;
+        }
+        else
+        {
+            lapStartTime -= (int64_t)shift * 1000;
+        }
+        segmentIndex = best;
+    }
+}
+
+static void onTrackFeature(const TrackFeatureEvent* event)
+{
+    uint64_t now = event->time;
+
+    if (event->feature == TRACK_FEATURE_START_FINISH)
+    {
+        if (state == TRACK_MAP_LEARNING)
+        {
+            finishLearning(now);
+        }
+        else if (state == TRACK_MAP_EMPTY)
+        {
+            lapStartTime = now;
+            lapStartDistance = lastDistance;
+            startLearning(now);
+            return;
+        }
+
+        lapStartTime = now;
+        lapStartDistance = lastDistance;
+        segmentIndex = 0;
+        planning = (state == TRACK_MAP_READY);
+        return;
+    }
+
+    if (state == TRACK_MAP_LEARNING)
+    {
+        closeSegment(now);
+        (void)openSegment((uint8_t)event->feature, now);
+    }
+    else if (planning)
+    {
+        synchronise((uint8_t)event->feature, progress(lastDistance, now));
+    }
+}
+
+void TrackMap_Init(void)
+{
+    for (uint32_t i = 0; i < (sizeof(map.words) / sizeof(uint32_t)); i++)
+    {
+        map.words[i] = trackMapFlash.words[i];
+    }
+
+    if ((map.data.magic == TRACK_MAP_MAGIC) && (map.data.count <= TRACK_MAP_MAX_SEGMENTS) &&
+        (map.data.checksum == checksum(&map)))
+    {
+        prepare();
+        state = TRACK_MAP_READY;
+    }
+    else
+    {
+        map.data.count = 0;
+        state = TRACK_MAP_EMPTY;
+    }
+    dirty = false;
+
+    (void)TrackFeatures_Subscribe(onTrackFeature);
+    TrackMap_Reset(0, 0u);
+}
+
+void TrackMap_Reset(int32_t distance, uint64_t now)
+{
+    // An unfinished learning lap is thrown away
+    if (state == TRACK_MAP_LEARNING)
+    {
+        map.data.count = 0;
+        state = TRACK_MAP_EMPTY;
+    }
+    planning = false;
+    segmentIndex = 0;
+    lapStartTime = now;
+    lapStartDistance = distance;
+    lastDistance = distance;
+    lastTime = now;
+    plannedSpeed = minSpeed;
+}
+
+void TrackMap_SetSpeedRange(float min, float max)
+{
+    minSpeed = min;
+    maxSpeed = (max > min) ? max : min;
+}
+
+void TrackMap_SetPlanning(bool enabled)
+{
+    planningEnabled = enabled;
+}
+
+void TrackMap_Update(float error, int32_t distance, uint64_t now)
+{
+    uint64_t elapsed = now - lastTime;
+    lastDistance = distance;
+    lastTime = now;
+
+    if (state == TRACK_MAP_LEARNING)
+    {
+        sliceErrorSum += (error < 0.0f) ? -error : error;
+        sliceSamples++;
+
+        if ((now - sliceStartTime) >= TRACK_MAP_SLICE_US)
+        {
+            uint8_t curvature = classify(sliceErrorSum / (float)sliceSamples);
+            TrackMapSegment* segment = &map.data.segments[map.data.count - 1u];
+
+            if (segment->curvature == TRACK_CURVATURE_UNKNOWN)
+            {
+                segment->curvature = curvature;
+            }
+            else if (segment->curvature != curvature)
+            {
+                closeSegment(now);
+                if (openSegment(0u, now))
+                {
+                    map.data.segments[map.data.count - 1u].curvature = curvature;
+                }
+                else if (curvature > segment->curvature)
+                {
+                    // Merged into the last segment, keep the slower class
+                    segment->curvature = curvature;
+                }
+            }
+
+            sliceStartTime = now;
+            sliceErrorSum = 0.0f;
+            sliceSamples = 0;
+        }
+        return;
+    }
+
+    if (!planning)
+    {
+        return;
+    }
+
+    const TrackMapData* data = &map.data;
+    uint32_t position = progress(distance, now);
+
+    while ((segmentIndex + 1u < data->count) && (position >= segmentStart[segmentIndex + 1u]))
+    {
+        segmentIndex++;
+    }
+
+    // Close to the end of a segment the next one decides (accelerate early out of corners)
+    uint8_t first = segmentIndex;
+    uint32_t end = segmentStart[segmentIndex + 1u];
+    if ((first + 1u < data->count) && (position + exitLead >= end) &&
+        (curvatureSpeed(data->segments[first + 1u].curvature) > curvatureSpeed(data->segments[first].curvature)))
+    {
+        first++;
+    }
+
+    // Slowest segment within the braking look-ahead (brake before corners)
+    float target = curvatureSpeed(data->segments[first].curvature);
+    for (uint8_t i = first + 1u; (i < data->count) && (segmentStart[i] <= position + brakeLookahead); i++)
+    {
+        float speed = curvatureSpeed(data->segments[i].curvature);
+        if (speed < target)
+        {
+            target = speed;
+        }
+    }
+
+    // Braking is immediate, acceleration is limited
+    float maxIncrease = TRACK_MAP_ACCELERATION * (float)elapsed * 1.0e-6f;
+    plannedSpeed = (target > plannedSpeed + maxIncrease) ? plannedSpeed + maxIncrease : target;
+}
+
+bool TrackMap_IsPlanning(void)
+{
+    return planningEnabled && planning;
+}
+
+float TrackMap_GetSpeed(void)
+{
+    return plannedSpeed;
+}
+
+enum trackMapState TrackMap_GetState(void)
+{
+    return state;
+}
+
+uint8_t TrackMap_GetSegmentCount(void)
+{
+    return (state == TRACK_MAP_EMPTY) ? 0u : map.data.count;
+}
+
+const TrackMapSegment* TrackMap_GetSegment(uint8_t index)
+{
+    return (index < TrackMap_GetSegmentCount()) ? &map.data.segments[index] : NULL;
+}
+
+bool TrackMap_IsDirty(void)
+{
+    return dirty;
+}
+
+bool TrackMap_Save(void)
+{
+    if (state != TRACK_MAP_READY)
+    {
+        return false;
+    }
+
+    if (Cy_Flash_WriteRow((uint32_t)(uintptr_t)&trackMapFlash, map.words) != CY_FLASH_DRV_SUCCESS)
+    {
+        return false;
+    }
+    dirty = false;
+    return true;
+}
+
+bool TrackMap_Clear(void)
+{
+    for (uint32_t i = 0; i < (sizeof(map.words) / sizeof(uint32_t)); i++)
+    {
+        map.words[i] = 0u;
+    }
+    state = TRACK_MAP_EMPTY;
+    planning = false;
+    dirty = false;
+
+    return (Cy_Flash_WriteRow((uint32_t)(uintptr_t)&trackMapFlash, map.words) == CY_FLASH_DRV_SUCCESS);
+}
+
+/* [] END OF FILE */
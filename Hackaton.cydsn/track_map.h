@@ -0,0 +1,93 @@
+#ifndef TRACK_MAP_H
+#define TRACK_MAP_H
+
+#ifdef __cplusplus
+extern "C" {
+#endif
+
+#include <stdint.h>
+#include <stdbool.h>
+#include "track_features.h"
+
+// Track learning and look-ahead speed planning.
+//
+// Learning starts at a start/finish mark and lasts one lap. The lap is cut into
+// segments at every track feature and wherever the curvature class changes.
+// Curvature class comes from the mean |line error| over TRACK_MAP_SLICE_US
+// slices. Each segment keeps its duration, its length in encoder counts and its
+// class. The map is written to the em_eeprom flash region (TrackMap_Save()), so
+// it is loaded again after a power cycle.
+//
+// On later laps the car knows where it is from the distance (or, without
+// encoders, the time) since the start/finish mark, re-synchronised on every track
+// feature. Planned speed is the class speed of the current segment, lowered to
+// the speed of any slower segment starting within TRACK_MAP_BRAKE_LOOKAHEAD_MS
+// (brake before corners), and raised to the next segment's speed during the last
+// TRACK_MAP_EXIT_LEAD_MS of a corner (accelerate early onto straights).
+
+#define TRACK_MAP_MAX_SEGMENTS      (64u)
+#define TRACK_MAP_SLICE_US          (100000u)   // Curvature is classified every 100 ms while learning
+#define TRACK_MAP_GENTLE_ERROR      (0.3f)      // Mean |error| from which a slice is a gentle corner
+#define TRACK_MAP_SHARP_ERROR       (1.0f)      // Mean |error| from which a slice is a sharp corner
+#define TRACK_MAP_DISTANCE_SCALE    (16)        // Encoder counts per stored distance unit
+#define TRACK_MAP_MIN_LAP_DISTANCE  (1000)      // Encoder counts, shorter laps mean encoders are missing
+#define TRACK_MAP_BRAKE_LOOKAHEAD_MS (300u)
+#define TRACK_MAP_EXIT_LEAD_MS      (100u)
+#define TRACK_MAP_ACCELERATION      (4000.0f)   // Motor units per second, planned speed rises at most this fast
+
+enum trackCurvature
+{
+    TRACK_CURVATURE_STRAIGHT    = 0,
+    TRACK_CURVATURE_GENTLE      = 1,
+    TRACK_CURVATURE_SHARP       = 2,
+    TRACK_CURVATURE_UNKNOWN     = 0xFF,
+};
+
+enum trackMapState
+{
+    TRACK_MAP_EMPTY     = 0,
+    TRACK_MAP_LEARNING  = 1,
+    TRACK_MAP_READY     = 2,
+};
+
+typedef struct
+{
+    uint16_t duration;      // Milliseconds on the learning lap
+    uint16_t distance;      // Encoder counts / TRACK_MAP_DISTANCE_SCALE
+    uint8_t curvature;      // enum trackCurvature
+    uint8_t feature;        // enum trackFeature that starts the segment, 0 = curvature change
+} TrackMapSegment;
+
+// Load the map from flash and subscribe to track features (call after TrackFeatures_Init())
+void TrackMap_Init(void);
+
+// New run: wait for a start/finish mark before learning or planning
+void TrackMap_Reset(int32_t distance, uint64_t now);
+
+// Speeds used for straights (max) and sharp corners (min), gentle corners get the middle
+void TrackMap_SetSpeedRange(float minSpeed, float maxSpeed);
+
+// Planned speed is used only when enabled (a map is learned either way)
+void TrackMap_SetPlanning(bool enabled);
+
+// Feed line error and travelled distance (encoder counts, forward) once per control tick
+void TrackMap_Update(float error, int32_t distance, uint64_t now);
+
+// True when a learned map drives the speed on this lap
+bool TrackMap_IsPlanning(void);
+float TrackMap_GetSpeed(void);
+
+enum trackMapState TrackMap_GetState(void);
+uint8_t TrackMap_GetSegmentCount(void);
+const TrackMapSegment* TrackMap_GetSegment(uint8_t index);
+
+// Flash persistence. Writing blocks for a few tens of ms, do it with motors stopped.
+bool TrackMap_IsDirty(void);
+bool TrackMap_Save(void);
+bool TrackMap_Clear(void);
+
+#ifdef __cplusplus
+}
+#endif
+
+#endif /* TRACK_MAP_H */
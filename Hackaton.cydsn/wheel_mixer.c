@@ -0,0 +1,177 @@
+/* ========================================
+ * wheel_mixer.c
+ * ========================================
+ */
+
+#include "wheel_mixer.h"
+#include "wheel_speed.h"
+#include "car.h"
+
+// Motors are mounted so that negative duty drives the car forward
+#define WHEEL_MOTOR_DIRECTION   (-1)
+
+// Spinning encoder wheel moves drive away from its own axle
+#if (WHEEL_MIXER_ENCODER_FRONT != 0)
+#define SLIP_SHIFT_SIGN         (-1.0f)
+#else
+#define SLIP_SHIFT_SIGN         (1.0f)
+#endif
+
+static bool mixerEnabled = false;
+static float tankSplit = WHEEL_MIXER_TANK_SPLIT;
+static float slipShift[WHEEL_COUNT];
+static bool slipping[WHEEL_COUNT];
+
+static int absolute(int x)
+{
+    return (x < 0) ? -x : x;
+}
+
+// How much the sides turn against each other: 1 when equal and opposite, 0 when
+// one side stands or both go the same way. Fades out below WHEEL_MIXER_TANK_MIN_DUTY.
+static float pivotShare(int left, int right)
+{
+    int largest = (absolute(left) > absolute(right)) ? absolute(left) : absolute(right);
+    if (((left * right) >= 0) || (largest == 0))
+    {
+        return 0.0f;
+    }
+
+    float share = (float)absolute(left * right) / ((float)largest * (float)largest);
+    if (largest < WHEEL_MIXER_TANK_MIN_DUTY)
+    {
+        share *= (float)largest / (float)WHEEL_MIXER_TANK_MIN_DUTY;
+    }
+    return share;
+}
+
+static float clampDuty(float duty)
+{
+    if (duty > (float)WHEEL_SPEED_FULL_SCALE)
+        return (float)WHEEL_SPEED_FULL_SCALE;
+    else if (duty < -(float)WHEEL_SPEED_FULL_SCALE)
+        return -(float)WHEEL_SPEED_FULL_SCALE;
+    else
+        return duty;
+}
+
+// Split the duty of a side between its motors. A motor that would go past full
+// scale passes the excess to the other one, so the side total is kept until
+// both run at full scale.
+static void splitSide(int16_t duty, float shift, int* front, int* rear)
+{
+    float frontDuty = (float)duty * (1.0f + shift);
+    float rearDuty = (float)duty * (1.0f - shift);
+
+    rearDuty += frontDuty - clampDuty(frontDuty);
+    frontDuty += rearDuty - clampDuty(rearDuty);
+
+    *front = (int)clampDuty(frontDuty);
+    *rear = (int)clampDuty(rearDuty);
+}
+
+// Adapt traction shift of one side from commanded and measured speed
+static void updateSlip(uint8_t wheel, int16_t target, float speed)
+{
+    bool spinning = false;
+
+    // Same direction only: a wheel reversing is not judged
+    if ((absolute(target) >= WHEEL_MIXER_SLIP_MIN_TARGET) && ((float)target * speed > 0.0f))
+    {
+        float ratio = speed / (float)target;
+        spinning = (ratio > 1.0f + WHEEL_MIXER_SLIP_THRESHOLD);
+    }
+    slipping[wheel] = spinning;
+
+    float shift = slipShift[wheel];
+    if (spinning)
+    {
+        shift += SLIP_SHIFT_SIGN * WHEEL_MIXER_SLIP_STEP;
+    }
+    else if (shift > WHEEL_MIXER_RECOVERY_STEP)
+    {
+        shift -= WHEEL_MIXER_RECOVERY_STEP;
+    }
+    else if (shift < -WHEEL_MIXER_RECOVERY_STEP)
+    {
+        shift += WHEEL_MIXER_RECOVERY_STEP;
+    }
+    else
+    {
+        shift = 0.0f;
+    }
+
+    if (shift > WHEEL_MIXER_MAX_SHIFT)
+    {
+        shift = WHEEL_MIXER_MAX_SHIFT;
+    }
+    else if (shift < -WHEEL_MIXER_MAX_SHIFT)
+    {
+        shift = -WHEEL_MIXER_MAX_SHIFT;
+    }
+    slipShift[wheel] = shift;
+}
+
+void WheelMixer_Init(void)
+{
+    mixerEnabled = false;
+    tankSplit = WHEEL_MIXER_TANK_SPLIT;
+    WheelMixer_Reset();
+}
+
+void WheelMixer_Reset(void)
+{
+    for (uint8_t wheel_n = 0; wheel_n < WHEEL_COUNT; wheel_n++)
+    {
+        slipShift[wheel_n] = 0.0f;
+        slipping[wheel_n] = false;
+    }
+}
+
+void WheelMixer_SetEnabled(bool enabled)
+{
+    mixerEnabled = enabled;
+    WheelMixer_Reset();
+}
+
+void WheelMixer_SetTankSplit(float split)
+{
+    tankSplit = split;
+}
+
+void WheelMixer_Apply(const int16_t duty[], const int16_t target[], const float speed[])
+{
+    int front[WHEEL_COUNT];
+    int rear[WHEEL_COUNT];
+
+    float tankShift = tankSplit * pivotShare(duty[WHEEL_LEFT], duty[WHEEL_RIGHT]);
+
+    for (uint8_t wheel_n = 0; wheel_n < WHEEL_COUNT; wheel_n++)
+    {
+        float shift = 0.0f;
+
+        if (mixerEnabled)
+        {
+            updateSlip(wheel_n, target[wheel_n], speed[wheel_n]);
+            shift = slipShift[wheel_n] + tankShift;
+        }
+
+        splitSide(duty[wheel_n], shift, &front[wheel_n], &rear[wheel_n]);
+    }
+
+    // Motor_Move(left_front, left_back, right_front, right_back)
+    Motor_Move(WHEEL_MOTOR_DIRECTION * front[WHEEL_LEFT], WHEEL_MOTOR_DIRECTION * rear[WHEEL_LEFT],
+               WHEEL_MOTOR_DIRECTION * front[WHEEL_RIGHT], WHEEL_MOTOR_DIRECTION * rear[WHEEL_RIGHT]);
+}
+
+float WheelMixer_GetSlipShift(uint8_t wheel)
+{
+    return (wheel < WHEEL_COUNT) ? slipShift[wheel] : 0.0f;
+}
+
+bool WheelMixer_IsSlipping(uint8_t wheel)
+{
+    return (wheel < WHEEL_COUNT) ? slipping[wheel] : false;
+}
+
+/* [] END OF FILE */
@@ -0,0 +1,57 @@
+#ifndef WHEEL_MIXER_H
+#define WHEEL_MIXER_H
+
+#ifdef __cplusplus
+extern "C" {
+#endif
+
+#include <stdint.h>
+#include <stdbool.h>
+
+// Per-wheel mixing and traction control.
+//
+// The wheel speed loop produces one duty per side. The mixer splits it between
+// the front and rear motor of that side:
+//   front = duty * (1 + shift), rear = duty * (1 - shift)
+// so the total drive of the side stays the same and only its distribution changes.
+// When one motor would pass full scale the excess goes to the other one.
+// The mixer is off by default (ECHO 31): both motors of a side get its duty.
+//
+// shift has two parts:
+//   - pivot turns (sides driven in opposite directions) move drive to the front
+//     axle, so the car pivots closer to the rear axle and scrubs less. The shift
+//     grows smoothly up to WHEEL_MIXER_TANK_SPLIT for equal and opposite sides,
+//   - traction control: each side has one encoder, on the axle given by
+//     WHEEL_MIXER_ENCODER_FRONT. When that wheel turns faster than commanded by
+//     more than WHEEL_MIXER_SLIP_THRESHOLD it is spinning, drive is moved to the
+//     other axle step by step and returns slowly once grip is back.
+
+#define WHEEL_MIXER_ENCODER_FRONT       (0)         // 1 when encoders are on the front wheels
+#define WHEEL_MIXER_TANK_SPLIT          (0.3f)      // Front share increase in tank turns
+#define WHEEL_MIXER_TANK_MIN_DUTY       (300)       // Pivot shift fades out when both sides are slower than this
+#define WHEEL_MIXER_SLIP_THRESHOLD      (0.25f)     // Measured / commanded - 1 above which the wheel spins
+#define WHEEL_MIXER_SLIP_MIN_TARGET     (200)       // Slip is not judged below this commanded speed
+#define WHEEL_MIXER_SLIP_STEP           (0.05f)     // Shift change per update while spinning
+#define WHEEL_MIXER_RECOVERY_STEP       (0.01f)     // Shift change per update with grip
+#define WHEEL_MIXER_MAX_SHIFT           (0.6f)
+
+void WheelMixer_Init(void);
+void WheelMixer_Reset(void);
+
+// Disabled mixer drives both motors of a side with the same duty
+void WheelMixer_SetEnabled(bool enabled);
+void WheelMixer_SetTankSplit(float split);
+
+// Mix side duties to four motors and call Motor_Move(). target and speed are
+// the commanded and measured side speeds in motor units (WHEEL_LEFT/WHEEL_RIGHT order).
+void WheelMixer_Apply(const int16_t duty[], const int16_t target[], const float speed[]);
+
+// Traction control part of the shift of a side, positive = drive moved to the front
+float WheelMixer_GetSlipShift(uint8_t wheel);
+bool WheelMixer_IsSlipping(uint8_t wheel);
+
+#ifdef __cplusplus
+}
+#endif
+
+#endif /* WHEEL_MIXER_H */
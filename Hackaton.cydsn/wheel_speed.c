@@ -0,0 +1,180 @@
+/* ========================================
+ * wheel_speed.c
+ * ========================================
+ */
+
+#include "wheel_speed.h"
+#include "car.h"
+#include "pid.h"
+#include "wheel_mixer.h"
+
+typedef struct
+{
+    Pid pid;
+    int16_t target;
+    int16_t duty;
+    float speed;            // Measured, motor units
+    int32_t lastCount;
+} wheelState;
+
+static wheelState wheels[WHEEL_COUNT];
+static uint64_t lastUpdateTime;
+static bool closedLoop = false;
+
+// Encoder counts per second to motor units
+static float countsToSpeed(float countsPerSecond)
+{
+    return countsPerSecond * ((float)WHEEL_SPEED_FULL_SCALE / WHEEL_COUNTS_PER_SECOND_MAX);
+}
+
+static float measureSpeed(wheelState* wheel, uint8_t encoder, uint32_t deltaTimeUs)
+{
+    int32_t count = Encoder_GetCount(encoder);
+    int32_t deltaCount = count - wheel->lastCount;
+    wheel->lastCount = count;
+
+    // High speed: enough counts in the update period for a good resolution
+    if ((deltaCount >= WHEEL_COUNT_METHOD_MIN) || (deltaCount <= -WHEEL_COUNT_METHOD_MIN))
+    {
+        return countsToSpeed((float)deltaCount * 1.0e6f / (float)deltaTimeUs);
+    }
+
+    // Low speed: time between phase A edges
+    uint32_t period = Encoder_GetPulsePeriod(encoder);
+    uint32_t sinceEdge = Encoder_GetTimeSinceEdge(encoder);
+    if ((period == 0u) || (sinceEdge > WHEEL_STALL_TIMEOUT_US))
+    {
+        return 0.0f;
+    }
+
+    // Wheel is slowing down if the current period already lasts longer than the last full one
+    if (sinceEdge > period)
+    {
+        period = sinceEdge;
+    }
+
+    float speed = countsToSpeed((float)ENCODER_COUNTS_PER_PULSE * 1.0e6f / (float)period);
+
+    // Period has no sign, take direction from the counter (or keep the last one when no count arrived)
+    if ((deltaCount < 0) || ((deltaCount == 0) && (wheel->speed < 0.0f)))
+    {
+        speed = -speed;
+    }
+    return speed;
+}
+
+static int16_t clampDuty(float duty)
+{
+    if (duty > (float)WHEEL_SPEED_FULL_SCALE)
+        return WHEEL_SPEED_FULL_SCALE;
+    else if (duty < -(float)WHEEL_SPEED_FULL_SCALE)
+        return -WHEEL_SPEED_FULL_SCALE;
+    else
+        return (int16_t)duty;
+}
+
+void WheelSpeed_Init(void)
+{
+    for (uint8_t wheel_n = 0; wheel_n < WHEEL_COUNT; wheel_n++)
+    {
+        Pid_Init(&wheels[wheel_n].pid, WHEEL_KP, WHEEL_KI, WHEEL_KD, WHEEL_INTEGRAL_LIMIT, WHEEL_SPEED_FULL_SCALE);
+    }
+    WheelMixer_Init();
+    WheelSpeed_Reset(0u);
+}
+
+void WheelSpeed_Reset(uint64_t now)
+{
+    for (uint8_t wheel_n = 0; wheel_n < WHEEL_COUNT; wheel_n++)
+    {
+        wheelState* wheel = &wheels[wheel_n];
+        Pid_Reset(&wheel->pid, now);
+        wheel->target = 0;
+        wheel->duty = 0;
+        wheel->speed = 0.0f;
+        wheel->lastCount = Encoder_GetCount(wheel_n);
+    }
+    WheelMixer_Reset();
+    lastUpdateTime = now;
+}
+
+void WheelSpeed_SetClosedLoop(bool enabled)
+{
+    closedLoop = enabled;
+}
+
+bool WheelSpeed_IsClosedLoop(void)
+{
+    return closedLoop;
+}
+
+void WheelSpeed_SetGains(float kp, float ki, float kd)
+{
+    for (uint8_t wheel_n = 0; wheel_n < WHEEL_COUNT; wheel_n++)
+    {
+        Pid_SetGains(&wheels[wheel_n].pid, kp, ki, kd);
+    }
+}
+
+void WheelSpeed_SetTarget(int16_t left, int16_t right)
+{
+    wheels[WHEEL_LEFT].target = left;
+    wheels[WHEEL_RIGHT].target = right;
+}
+
+void WheelSpeed_Update(uint64_t now)
+{
+    uint32_t deltaTimeUs = (uint32_t)(now - lastUpdateTime);
+    lastUpdateTime = now;
+    if (deltaTimeUs == 0u)
+    {
+        deltaTimeUs = 1u;
+    }
+
+    int16_t duty[WHEEL_COUNT];
+    int16_t target[WHEEL_COUNT];
+    float speed[WHEEL_COUNT];
+
+    for (uint8_t wheel_n = 0; wheel_n < WHEEL_COUNT; wheel_n++)
+    {
+        wheelState* wheel = &wheels[wheel_n];
+        wheel->speed = measureSpeed(wheel, wheel_n, deltaTimeUs);
+
+        if (closedLoop)
+        {
+            // Target is the feed-forward duty, PID adds what is missing
+            float error = (float)wheel->target - wheel->speed;
+            pid_value_t correction = Pid_Update(&wheel->pid, PID_FROM_FLOAT(error), now);
+            wheel->duty = clampDuty((float)wheel->target + PID_TO_FLOAT(correction));
+        }
+        else
+        {
+            wheel->duty = wheel->target;
+        }
+
+        duty[wheel_n] = wheel->duty;
+        target[wheel_n] = wheel->target;
+        speed[wheel_n] = wheel->speed;
+    }
+
+    // Split side duty between front and rear motors (traction control)
+    WheelMixer_Apply(duty, target, speed);
+}
+
+void WheelSpeed_Stop(void)
+{
+    WheelSpeed_SetTarget(0, 0);
+    for (uint8_t wheel_n = 0; wheel_n < WHEEL_COUNT; wheel_n++)
+    {
+        wheels[wheel_n].duty = 0;
+    }
+    WheelMixer_Reset();
+    Motor_Move(0, 0, 0, 0);
+}
+
+int16_t WheelSpeed_GetSpeed(uint8_t wheel)
+{
+    return (wheel < WHEEL_COUNT) ? (int16_t)wheels[wheel].speed : 0;
+}
+
+/* [] END OF FILE */
@@ -0,0 +1,62 @@
+#ifndef WHEEL_SPEED_H
+#define WHEEL_SPEED_H
+
+#ifdef __cplusplus
+extern "C" {
+#endif
+
+#include <stdint.h>
+#include <stdbool.h>
+
+// Inner wheel speed loop: one speed PID per side, measured by the wheel encoders.
+//
+// Speeds are in motor units: WHEEL_SPEED_FULL_SCALE is the speed the wheel reaches
+// with full Motor_Move() duty, so targets can be used as open-loop duty directly
+// (feed-forward) and the PID only corrects the difference.
+//
+// Velocity is measured two ways and the better one is used:
+//   - pulse period (phase A capture) at low speed, where few counts arrive per period
+//   - count difference over the update period at high speed
+
+#define WHEEL_LEFT                  (0u)
+#define WHEEL_RIGHT                 (1u)
+#define WHEEL_COUNT                 (2u)
+
+#define WHEEL_SPEED_FULL_SCALE      (4000)      // Motor units, matches Motor_Move() range used by followLine
+#define WHEEL_COUNTS_PER_SECOND_MAX (20000.0f)  // Encoder counts per second at full duty
+#define WHEEL_COUNT_METHOD_MIN      (8)         // Counts per update above which the count method is used
+#define WHEEL_STALL_TIMEOUT_US      (100000u)   // No encoder edge for this long = wheel stopped
+
+#define WHEEL_KP                    (0.8f)
+#define WHEEL_KI                    (8.0f)
+#define WHEEL_KD                    (0.0f)
+#define WHEEL_INTEGRAL_LIMIT        (200.0f)
+
+void WheelSpeed_Init(void);
+
+// Clear measurement history and PID state (e.g. when motors are enabled)
+void WheelSpeed_Reset(uint64_t now);
+
+// Closed loop needs encoders. When disabled targets are written as duty (open loop).
+void WheelSpeed_SetClosedLoop(bool enabled);
+bool WheelSpeed_IsClosedLoop(void);
+
+void WheelSpeed_SetGains(float kp, float ki, float kd);
+
+// Set target speed of both sides in motor units, positive = forward
+void WheelSpeed_SetTarget(int16_t left, int16_t right);
+
+// Measure speed, run PIDs and drive motors. Call it at a fixed rate.
+void WheelSpeed_Update(uint64_t now);
+
+// Stop motors and hold targets at 0
+void WheelSpeed_Stop(void);
+
+// Latest measured speed in motor units
+int16_t WheelSpeed_GetSpeed(uint8_t wheel);
+
+#ifdef __cplusplus
+}
+#endif
+
+#endif /* WHEEL_SPEED_H */
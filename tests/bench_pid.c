@@ -0,0 +1,153 @@
+/* ========================================
+ * bench_pid.c
+ * ========================================
+ */
+
+// Line PID against the double implementation it replaced: same output on a
+// recorded-like error sequence, and cost per update on the host. Built once per
+// PID_IMPLEMENTATION. Host timings only compare the variants with each other;
+// the CM4 has a single precision FPU, so double there is emulated in software.
+
+#include "test.h"
+#include "pid.h"
+#include <stdlib.h>
+#include <time.h>
+
+#define KP              (500.0)
+#define KI              (5.0)
+#define KD              (20.0)
+#define INTEGRAL_LIMIT  (100.0)
+#define OUTPUT_LIMIT    (2000.0)
+#define STEPS           (20000u)
+#define ROUNDS          (100u)
+
+#if (PID_IMPLEMENTATION == PID_IMPL_Q16)
+#define NAME            "Q16.16"
+#define TOLERANCE       (1.0)       // Counts of the +-2000 output range
+#else
+#define NAME            "float"
+#define TOLERANCE       (0.01)
+#endif
+
+// Old pidControl() of main_cm4.c, without the final cast to int16_t
+typedef struct
+{
+    double lastError;
+    double integral;
+    uint64_t lastTime;
+} DoublePid;
+
+static double doublePidControl(DoublePid* pid, double error, uint64_t currentTime)
+{
+    double deltaTime = (double)(currentTime - pid->lastTime) / 1000000.0;
+    if (deltaTime < 0.0001)
+    {
+        deltaTime = 0.0001;
+    }
+
+    pid->integral += error * deltaTime;
+    if (pid->integral > INTEGRAL_LIMIT)  pid->integral = INTEGRAL_LIMIT;
+    if (pid->integral < -INTEGRAL_LIMIT) pid->integral = -INTEGRAL_LIMIT;
+
+    double correction = KP * error + KI * pid->integral + KD * (error - pid->lastError) / deltaTime;
+    if (correction > OUTPUT_LIMIT)  correction = OUTPUT_LIMIT;
+    if (correction < -OUTPUT_LIMIT) correction = -OUTPUT_LIMIT;
+
+    pid->lastError = error;
+    pid->lastTime = currentTime;
+    return correction;
+}
+
+// Line positions the sensor can report, drifting like a car weaving on the track
+static const float positions[] = { -3.0f, -2.5f, -2.0f, -1.5f, -1.0f, -0.5f, 0.0f, 0.75f, 1.5f, 2.0f, 2.5f, 3.0f, 3.5f };
+#define POSITION_COUNT  (sizeof(positions) / sizeof(positions[0]))
+
+static float errors[STEPS];
+static uint64_t times[STEPS];
+
+static void makeSequence(void)
+{
+    int index = (int)(POSITION_COUNT / 2u);
+    uint64_t now = 0;
+
+    srand(1u);
+    for (uint32_t i = 0; i < STEPS; i++)
+    {
+        // Hold a pattern a few periods, then move one pattern either way
+        if ((rand() % 4) == 0)
+        {
+            index += ((rand() % 2) == 0) ? -1 : 1;
+            index = (index < 0) ? 0 : ((index >= (int)POSITION_COUNT) ? (int)POSITION_COUNT - 1 : index);
+        }
+        // 2 ms period with scheduler jitter
+        now += 2000u + (uint64_t)(rand() % 200);
+        errors[i] = positions[index];
+        times[i] = now;
+    }
+}
+
+static double seconds(void)
+{
+    struct timespec time;
+    clock_gettime(CLOCK_MONOTONIC, &time);
+    return (double)time.tv_sec + (double)time.tv_nsec * 1.0e-9;
+}
+
+int main(void)
+{
+    static pid_value_t output[STEPS];
+    static double reference[STEPS];
+    volatile double sink = 0.0;
+    Pid pid;
+    DoublePid doublePid;
+
+    makeSequence();
+
+    // Accuracy
+    Pid_Init(&pid, (float)KP, (float)KI, (float)KD, (float)INTEGRAL_LIMIT, (float)OUTPUT_LIMIT);
+    Pid_Reset(&pid, 0u);
+    doublePid = (DoublePid){ 0 };
+    double maxDifference = 0.0;
+    for (uint32_t i = 0; i < STEPS; i++)
+    {
+        output[i] = Pid_Update(&pid, PID_FROM_FLOAT(errors[i]), times[i]);
+        reference[i] = doublePidControl(&doublePid, errors[i], times[i]);
+        double difference = fabs(PID_TO_FLOAT(output[i]) - reference[i]);
+        if (difference > maxDifference)
+        {
+            maxDifference = difference;
+        }
+    }
+    CHECK(maxDifference <= TOLERANCE);
+
+    // Cost, same inputs for both
+    double start = seconds();
+    for (uint32_t round = 0; round < ROUNDS; round++)
+    {
+        Pid_Reset(&pid, 0u);
+        for (uint32_t i = 0; i < STEPS; i++)
+        {
+            sink += PID_TO_FLOAT(Pid_Update(&pid, PID_FROM_FLOAT(errors[i]), times[i]));
+        }
+    }
+    double pidNs = (seconds() - start) * 1.0e9 / (ROUNDS * STEPS);
+
+    start = seconds();
+    for (uint32_t round = 0; round < ROUNDS; round++)
+    {
+        doublePid = (DoublePid){ 0 };
+        for (uint32_t i = 0; i < STEPS; i++)
+        {
+            sink += doublePidControl(&doublePid, errors[i], times[i]);
+        }
+    }
+    double doubleNs = (seconds() - start) * 1.0e9 / (ROUNDS * STEPS);
+
+    printf("bench_pid: %s %.1f ns/update, double %.1f ns/update, max difference %.4f\n",
+           NAME, pidNs, doubleNs, maxDifference);
+    (void)sink;
+
+    return testResult("bench_pid (" NAME ")");
+}
+
+/* [] END OF FILE */
@@ -0,0 +1,38 @@
+#ifndef TEST_H
+#define TEST_H
+
+// Minimal checks for the host tests, every test program returns non-zero on failure
+
+#include <stdio.h>
+#include <math.h>
+
+static int testFailures = 0;
+
+#define CHECK(condition) \
+    do { \
+        if (!(condition)) \
+        { \
+            printf("%s:%d: CHECK(%s) failed\n", __FILE__, __LINE__, #condition); \
+            testFailures++; \
+        } \
+    } while (0)
+
+#define CHECK_NEAR(value, expected, tolerance) \
+    do { \
+        double checkValue = (value); \
+        double checkExpected = (expected); \
+        if (fabs(checkValue - checkExpected) > (tolerance)) \
+        { \
+            printf("%s:%d: %s = %g, expected %g +- %g\n", __FILE__, __LINE__, #value, \
+                   checkValue, checkExpected, (double)(tolerance)); \
+            testFailures++; \
+        } \
+    } while (0)
+
+static inline int testResult(const char* name)
+{
+    printf("%s: %s\n", name, (testFailures == 0) ? "OK" : "FAILED");
+    return (testFailures == 0) ? 0 : 1;
+}
+
+#endif /* TEST_H */
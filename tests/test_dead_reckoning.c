@@ -0,0 +1,119 @@
+/* ========================================
+ * test_dead_reckoning.c
+ * ========================================
+ */
+
+// Odometry integration at the SysTick rate: a driven circle closes, straight
+// lines stay straight, turning in place does not move the car
+
+#include "test.h"
+#include "dead_reckoning.h"
+
+#define PI              (3.14159265358979)
+#define STEP_S          (0.001)     // SysTick period
+#define SPEED           (0.5)       // m/s of the car centre
+#define TRACK_WIDTH     (0.19)      // ODOMETRY_TRACK_WIDTH of car.h
+#define COUNTS_PER_METER (4000.0)   // ODOMETRY_COUNTS_PER_METER of car.h
+
+// Drive one lap of a circle of radius, left turn, starting at the origin facing x.
+// countsPerMeter > 0 rounds the travel to whole encoder counts like odometry_handler().
+static DeadReckoning driveCircle(double radius, double countsPerMeter)
+{
+    DeadReckoning reckoning;
+    double length = 2.0 * PI * radius;
+    uint32_t steps = (uint32_t)lround(length / (SPEED * STEP_S));
+    double step = length / steps;
+    double left = 0.0;
+    double right = 0.0;
+    double lastLeft = 0.0;
+    double lastRight = 0.0;
+
+    DeadReckoning_Reset(&reckoning, 0.0f, 0.0f, 0.0f);
+    for (uint32_t i = 0; i < steps; i++)
+    {
+        left += step * (1.0 - TRACK_WIDTH / (2.0 * radius));
+        right += step * (1.0 + TRACK_WIDTH / (2.0 * radius));
+        double leftNow = (countsPerMeter > 0.0) ? round(left * countsPerMeter) / countsPerMeter : left;
+        double rightNow = (countsPerMeter > 0.0) ? round(right * countsPerMeter) / countsPerMeter : right;
+        DeadReckoning_Step(&reckoning, (float)(leftNow - lastLeft), (float)(rightNow - lastRight),
+                           TRACK_WIDTH);
+        lastLeft = leftNow;
+        lastRight = rightNow;
+    }
+    return reckoning;
+}
+
+static void testCircle(double radius)
+{
+    DeadReckoning exact = driveCircle(radius, 0.0);
+    DeadReckoning counted = driveCircle(radius, COUNTS_PER_METER);
+    double closure = hypot(exact.pose.x, exact.pose.y);
+    double countedClosure = hypot(counted.pose.x, counted.pose.y);
+
+    // Integration error only, then with the encoder resolution
+    CHECK(closure < 0.0002);
+    CHECK(countedClosure < 0.0002);
+    // Reported heading is a float sum of every step, the heading vector is exact
+    CHECK_NEAR(exact.pose.heading, 0.0, 5e-4);
+    CHECK_NEAR(exact.pose.distance, 2.0 * PI * radius, 1e-3);
+    CHECK_NEAR(hypot(exact.cosHeading, exact.sinHeading), 1.0, 1e-5);
+    printf("circle r=%.3f m: closes within %.4f mm, %.4f mm with counts\n",
+           radius, 1000.0 * closure, 1000.0 * countedClosure);
+}
+
+// Half lap: the car is on the far side of the circle, facing back
+static void testHalfCircle(void)
+{
+    DeadReckoning reckoning;
+    double radius = 0.5;
+    uint32_t steps = 1000u;
+    double step = PI * radius / steps;
+
+    DeadReckoning_Reset(&reckoning, 0.0f, 0.0f, 0.0f);
+    for (uint32_t i = 0; i < steps; i++)
+    {
+        DeadReckoning_Step(&reckoning, (float)(step * (1.0 - TRACK_WIDTH / (2.0 * radius))),
+                           (float)(step * (1.0 + TRACK_WIDTH / (2.0 * radius))), TRACK_WIDTH);
+    }
+    CHECK_NEAR(reckoning.pose.x, 0.0, 1e-4);
+    CHECK_NEAR(reckoning.pose.y, 2.0 * radius, 1e-4);
+    CHECK_NEAR(fabs(reckoning.pose.heading), PI, 1e-4);
+}
+
+static void testStraightAndSpin(void)
+{
+    DeadReckoning reckoning;
+
+    // 1 m along a 45 degree heading, float sums of 2000 steps
+    DeadReckoning_Reset(&reckoning, 1.0f, 2.0f, (float)(PI / 4.0));
+    for (uint32_t i = 0; i < 2000u; i++)
+    {
+        DeadReckoning_Step(&reckoning, 0.0005f, 0.0005f, TRACK_WIDTH);
+    }
+    CHECK_NEAR(reckoning.pose.x, 1.0 + sqrt(0.5), 1e-4);
+    CHECK_NEAR(reckoning.pose.y, 2.0 + sqrt(0.5), 1e-4);
+    CHECK_NEAR(reckoning.pose.distance, 1.0, 1e-4);
+
+    // Three turns in place
+    DeadReckoning_Reset(&reckoning, 0.0f, 0.0f, 0.0f);
+    double turnStep = 3.0 * 2.0 * PI * (TRACK_WIDTH / 2.0) / 3000.0;
+    for (uint32_t i = 0; i < 3000u; i++)
+    {
+        DeadReckoning_Step(&reckoning, (float)-turnStep, (float)turnStep, TRACK_WIDTH);
+    }
+    CHECK_NEAR(reckoning.pose.x, 0.0, 1e-6);
+    CHECK_NEAR(reckoning.pose.y, 0.0, 1e-6);
+    CHECK_NEAR(reckoning.pose.heading, 0.0, 1e-3);
+    CHECK(fabs(reckoning.pose.heading) <= PI);
+}
+
+int main(void)
+{
+    testCircle(0.5);                // 1 m diameter
+    testCircle(0.5 / PI);           // 1 m circumference
+    testHalfCircle();
+    testStraightAndSpin();
+    return testResult("test_dead_reckoning");
+}
+
+/* [] END OF FILE */
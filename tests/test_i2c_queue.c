@@ -0,0 +1,323 @@
+/* ========================================
+ * test_i2c_queue.c
+ * ========================================
+ */
+
+// I2C queue against a stub port: submission order, write-read, callbacks,
+// full queue, bus errors, failed starts, abort, bus time and blocking transfers
+
+#include "test.h"
+#include "i2c_queue.h"
+#include <string.h>
+
+// Stub bus: one transfer at a time, finished by busComplete() like the I2C
+// interrupt would. With autoComplete set, a pending transfer finishes as soon
+// as the lock is released (the interrupt fires when interrupts are enabled).
+typedef struct
+{
+    bool pending;
+    bool read;
+    bool keepBus;
+    uint8_t address;
+    uint8_t* data;
+    uint8_t length;
+    uint8_t sent[I2C_QUEUE_BUFFER_SIZE];
+    uint32_t starts;
+    uint32_t overlaps;          // Transfer started while another was on the bus
+    bool failStart;
+    bool failBus;
+    bool autoComplete;
+    uint32_t lockDepth;
+    uint32_t time;
+} StubBus;
+
+static StubBus bus;
+
+static bool startTransfer(uint8_t address, uint8_t* data, uint8_t length, bool read, bool keepBus)
+{
+    if (bus.failStart)
+    {
+        return false;
+    }
+    if (bus.pending)
+    {
+        bus.overlaps++;
+    }
+    bus.pending = true;
+    bus.read = read;
+    bus.keepBus = keepBus;
+    bus.address = address;
+    bus.data = data;
+    bus.length = length;
+    bus.starts++;
+    if (!read)
+    {
+        memcpy(bus.sent, data, length);
+    }
+    return true;
+}
+
+static bool stubWrite(uint8_t address, uint8_t* data, uint8_t length, bool keepBus)
+{
+    return startTransfer(address, data, length, false, keepBus);
+}
+
+static bool stubRead(uint8_t address, uint8_t* data, uint8_t length)
+{
+    return startTransfer(address, data, length, true, false);
+}
+
+static void busComplete(void)
+{
+    CHECK(bus.pending);
+    bus.pending = false;
+    if (bus.read)
+    {
+        for (uint8_t i = 0; i < bus.length; i++)
+        {
+            bus.data[i] = (uint8_t)(0xA0u + i);
+        }
+    }
+    bus.time += 100u;
+    I2cQueue_OnComplete(bus.failBus);
+}
+
+static uint32_t stubLock(void)
+{
+    bus.lockDepth++;
+    return bus.lockDepth;
+}
+
+static void stubUnlock(uint32_t state)
+{
+    CHECK(state == bus.lockDepth);
+    bus.lockDepth--;
+    if ((bus.lockDepth == 0u) && bus.autoComplete && bus.pending)
+    {
+        busComplete();
+    }
+}
+
+static uint32_t stubNow(void)
+{
+    return bus.time;
+}
+
+static const I2cQueue_Port stubPort = { stubWrite, stubRead, stubLock, stubUnlock, stubNow };
+
+// Callback log
+#define LOG_SIZE    (40u)
+
+typedef struct
+{
+    enum i2cQueueStatus status;
+    uint8_t data[I2C_QUEUE_BUFFER_SIZE];
+    uint8_t length;
+    void* context;
+    uint32_t busTime;
+} Completion;
+
+static Completion completions[LOG_SIZE];
+static uint32_t completionCount;
+
+static void record(enum i2cQueueStatus status, const uint8_t* data, uint8_t length, void* context)
+{
+    if (completionCount < LOG_SIZE)
+    {
+        Completion* completion = &completions[completionCount];
+        completion->status = status;
+        completion->length = length;
+        memcpy(completion->data, data, length);
+        completion->context = context;
+        completion->busTime = I2cQueue_GetBusTimeUs();
+    }
+    completionCount++;
+}
+
+static void reset(void)
+{
+    memset(&bus, 0, sizeof(bus));
+    completionCount = 0u;
+    I2cQueue_Init(&stubPort);
+}
+
+static void testOrder(void)
+{
+    int contexts[3];
+    uint8_t data[5] = { 0x06, 1, 2, 3, 4 };
+
+    reset();
+    CHECK(I2cQueue_Write(0x40, data, 5u, record, &contexts[0]));
+    CHECK(bus.pending && !bus.read && (bus.address == 0x40) && (bus.length == 5u) && !bus.keepBus);
+    // The slot owns a copy, the caller may reuse its buffer at once
+    data[1] = 99u;
+    CHECK(bus.sent[1] == 1u);
+
+    CHECK(I2cQueue_WriteRead(0x40, data, 1u, 2u, record, &contexts[1]));
+    CHECK(I2cQueue_Read(0x20, 1u, record, &contexts[2]));
+    CHECK(I2cQueue_GetDepth() == 3u);
+    CHECK(bus.starts == 1u);
+
+    busComplete();
+    CHECK(completionCount == 1u);
+    CHECK((completions[0].status == I2C_QUEUE_OK) && (completions[0].length == 0u));
+    CHECK(completions[0].context == &contexts[0]);
+    CHECK(completions[0].busTime == 100u);
+
+    // Write-read: write without stop, then read after a repeated start, one callback
+    CHECK(bus.pending && !bus.read && bus.keepBus && (bus.length == 1u) && (bus.sent[0] == 0x06));
+    busComplete();
+    CHECK(completionCount == 1u);
+    CHECK(bus.pending && bus.read && (bus.address == 0x40) && (bus.length == 2u));
+    busComplete();
+    CHECK(completionCount == 2u);
+    CHECK((completions[1].status == I2C_QUEUE_OK) && (completions[1].length == 2u));
+    CHECK((completions[1].data[0] == 0xA0u) && (completions[1].data[1] == 0xA1u));
+    CHECK(completions[1].context == &contexts[1]);
+    CHECK(completions[1].busTime == 200u);
+
+    CHECK(bus.pending && bus.read && (bus.address == 0x20) && (bus.length == 1u));
+    busComplete();
+    CHECK(completionCount == 3u);
+    CHECK((completions[2].length == 1u) && (completions[2].context == &contexts[2]));
+
+    CHECK(!bus.pending && I2cQueue_IsIdle());
+    CHECK(bus.overlaps == 0u);
+
+    I2cQueue_Stats stats;
+    I2cQueue_GetStats(&stats);
+    CHECK((stats.transactions == 3u) && (stats.errors == 0u) && (stats.maxDepth == 3u));
+}
+
+static void testFull(void)
+{
+    uint8_t data[2] = { 0x00, 0xFF };
+
+    reset();
+    for (uint32_t i = 0; i < I2C_QUEUE_LENGTH; i++)
+    {
+        CHECK(I2cQueue_Write(0x20, data, 2u, record, NULL));
+    }
+    CHECK(!I2cQueue_Write(0x20, data, 2u, record, NULL));
+    CHECK(!I2cQueue_Read(0x20, 1u, record, NULL));
+    CHECK(I2cQueue_GetDepth() == I2C_QUEUE_LENGTH);
+
+    I2cQueue_Stats stats;
+    I2cQueue_GetStats(&stats);
+    CHECK((stats.full == 2u) && (stats.maxDepth == I2C_QUEUE_LENGTH));
+
+    // A completion frees a slot
+    busComplete();
+    CHECK(I2cQueue_Write(0x20, data, 2u, record, NULL));
+    while (bus.pending)
+    {
+        busComplete();
+    }
+    CHECK(completionCount == I2C_QUEUE_LENGTH + 1u);
+    CHECK(I2cQueue_IsIdle() && (bus.overlaps == 0u));
+}
+
+static void testErrors(void)
+{
+    uint8_t data[2] = { 0x00, 0xFF };
+
+    reset();
+    CHECK(I2cQueue_WriteRead(0x40, data, 1u, 1u, record, NULL));
+    CHECK(I2cQueue_Write(0x20, data, 2u, record, NULL));
+
+    // Error in the write part: no read follows, no data is reported, the queue moves on
+    bus.failBus = true;
+    busComplete();
+    bus.failBus = false;
+    CHECK(completionCount == 1u);
+    CHECK((completions[0].status == I2C_QUEUE_ERROR) && (completions[0].length == 0u));
+    CHECK(bus.pending && !bus.read && (bus.address == 0x20));
+    busComplete();
+    CHECK((completionCount == 2u) && (completions[1].status == I2C_QUEUE_OK));
+
+    // A transfer that does not start fails at once, the next one still runs
+    bus.failStart = true;
+    CHECK(I2cQueue_Write(0x20, data, 2u, record, NULL));
+    bus.failStart = false;
+    CHECK((completionCount == 3u) && (completions[2].status == I2C_QUEUE_ERROR));
+    CHECK(I2cQueue_IsIdle() && !bus.pending);
+
+    I2cQueue_Stats stats;
+    I2cQueue_GetStats(&stats);
+    CHECK((stats.transactions == 3u) && (stats.errors == 2u));
+
+    // Length limits
+    uint8_t big[I2C_QUEUE_BUFFER_SIZE + 1u] = { 0 };
+    CHECK(!I2cQueue_Write(0x40, big, I2C_QUEUE_BUFFER_SIZE + 1u, record, NULL));
+    CHECK(!I2cQueue_Read(0x40, I2C_QUEUE_BUFFER_SIZE + 1u, record, NULL));
+    CHECK(!I2cQueue_Write(0x40, big, 0u, record, NULL));
+    CHECK(I2cQueue_Write(0x40, big, I2C_QUEUE_BUFFER_SIZE, record, NULL));
+    busComplete();
+    CHECK(completions[3].status == I2C_QUEUE_OK);
+}
+
+static void testAbort(void)
+{
+    uint8_t data[2] = { 0x00, 0xFF };
+
+    reset();
+    CHECK(I2cQueue_Write(0x40, data, 2u, record, NULL));
+    CHECK(I2cQueue_WriteRead(0x40, data, 1u, 4u, record, NULL));
+    CHECK(I2cQueue_Read(0x20, 1u, record, NULL));
+
+    I2cQueue_Abort();
+    CHECK(completionCount == 3u);
+    for (uint32_t i = 0; i < 3u; i++)
+    {
+        CHECK((completions[i].status == I2C_QUEUE_ABORTED) && (completions[i].length == 0u));
+    }
+    CHECK(I2cQueue_IsIdle());
+
+    // A late completion of the dropped transfer is ignored
+    busComplete();
+    CHECK(completionCount == 3u);
+
+    I2cQueue_Stats stats;
+    I2cQueue_GetStats(&stats);
+    CHECK((stats.aborted == 3u) && (stats.transactions == 0u));
+
+    // The queue works again after the caller reset the hardware
+    CHECK(I2cQueue_Write(0x40, data, 2u, record, NULL));
+    busComplete();
+    CHECK((completionCount == 4u) && (completions[3].status == I2C_QUEUE_OK));
+}
+
+static void testBlocking(void)
+{
+    uint8_t reg = 0x06;
+    uint8_t value[4] = { 0 };
+    uint8_t data[2] = { 0x00, 0xFF };
+
+    reset();
+    bus.autoComplete = true;
+    CHECK(I2cQueue_Transfer(0x40, &reg, 1u, value, 4u) == I2C_QUEUE_OK);
+    CHECK((value[0] == 0xA0u) && (value[3] == 0xA3u));
+    CHECK(I2cQueue_Transfer(0x40, &reg, 1u, NULL, 0u) == I2C_QUEUE_OK);
+    CHECK(I2cQueue_Transfer(0x40, NULL, 0u, NULL, 0u) == I2C_QUEUE_ERROR);
+
+    bus.failBus = true;
+    CHECK(I2cQueue_Transfer(0x40, &reg, 1u, value, 4u) == I2C_QUEUE_ERROR);
+    bus.failBus = false;
+
+    I2cQueue_WriteWait(0x20, data, 2u, record, NULL);
+    I2cQueue_WriteWait(0x20, data, 2u, NULL, NULL);
+    CHECK(completionCount == 1u);
+    CHECK(I2cQueue_IsIdle() && (bus.lockDepth == 0u));
+}
+
+int main(void)
+{
+    testOrder();
+    testFull();
+    testErrors();
+    testAbort();
+    testBlocking();
+    return testResult("test_i2c_queue");
+}
+
+/* [] END OF FILE */
@@ -0,0 +1,170 @@
+/* ========================================
+ * test_line_estimator.c
+ * ========================================
+ */
+
+// Replay of simulated line movements through LinePosition and the estimator.
+//
+// The true line position x is in weight units. The sensors report the sweep
+// pattern (one sensor or two neighbours) whose table position is nearest to x,
+// so pattern edges lie halfway between adjacent table positions - the model the
+// estimator assumes. Default weights are uneven (1.5 gap right of center).
+
+#include "test.h"
+#include "line_position.h"
+#include "line_estimator.h"
+
+#define PERIOD_US   (2000u)
+
+typedef struct
+{
+    uint32_t steps;
+    uint32_t stops;         // Velocity reset to 0 inside a band while the line kept moving
+    float maxError;
+    float meanError;
+    float rawMeanError;     // Of LinePosition_Get() alone
+} Replay;
+
+static uint8_t sensorsAt(float x)
+{
+    uint8_t nearest = 0x01u;
+    float distance = 1.0e9f;
+
+    for (uint8_t i = 0; i < LINE_SENSOR_COUNT; i++)
+    {
+        for (uint8_t width = 1u; (width <= 2u) && ((i + width) <= LINE_SENSOR_COUNT); width++)
+        {
+            uint8_t pattern = (uint8_t)(((1u << width) - 1u) << i);
+            float d = fabsf(LinePosition_Get(pattern, 0.0f) - x);
+            if (d < distance)
+            {
+                distance = d;
+                nearest = pattern;
+            }
+        }
+    }
+    return nearest;
+}
+
+// Feed x(t) sampled every control period; errors are counted after warmUs
+static Replay replay(float (*line)(float t), float durationS, uint32_t warmUs)
+{
+    LineEstimator estimator;
+    Replay result = { 0 };
+    uint64_t now = 1000u;
+    float x = line(0.0f);
+    uint8_t sensors = sensorsAt(x);
+    float measurement = LinePosition_Get(sensors, 0.0f);
+    float lastVelocity = 0.0f;
+
+    LineEstimator_Init(&estimator, LINE_ESTIMATOR_ALPHA, LINE_ESTIMATOR_BETA);
+    LineEstimator_Reset(&estimator, sensors, measurement, now);
+
+    for (uint32_t t = PERIOD_US; t <= (uint32_t)(durationS * 1.0e6f); t += PERIOD_US)
+    {
+        now += PERIOD_US;
+        x = line((float)t * 1.0e-6f);
+        sensors = sensorsAt(x);
+        measurement = LinePosition_Get(sensors, measurement);
+        float estimate = LineEstimator_Update(&estimator, sensors, measurement, now);
+        float velocity = LineEstimator_GetVelocity(&estimator);
+
+        if (t >= warmUs)
+        {
+            float error = fabsf(estimate - x);
+            result.steps++;
+            result.maxError = (error > result.maxError) ? error : result.maxError;
+            result.meanError += error;
+            result.rawMeanError += fabsf(measurement - x);
+            if ((lastVelocity != 0.0f) && (velocity == 0.0f))
+            {
+                result.stops++;
+            }
+        }
+        lastVelocity = velocity;
+    }
+    result.meanError /= (float)result.steps;
+    result.rawMeanError /= (float)result.steps;
+    return result;
+}
+
+// Steady drift across the whole bar, -3 to +3.5 in 0.65 s
+static float sweep(float t)
+{
+    return -3.0f + 10.0f * t;
+}
+
+// Weaving on a straight, turning back inside patterns
+static float weave(float t)
+{
+    return 0.25f + 1.5f * sinf(2.0f * 3.14159265f * 0.5f * t);
+}
+
+static float hold(float t)
+{
+    (void)t;
+    return 0.3f;
+}
+
+static void testBands(void)
+{
+    float below;
+    float above;
+
+    // Sensor 3 alone: 0.5 to the left pair, 0.75 to the right pair
+    LinePosition_GetBand(0x08u, &below, &above);
+    CHECK_NEAR(below, 0.25, 1e-6);
+    CHECK_NEAR(above, 0.375, 1e-6);
+    // Sensors 3 and 4 at 0.75, halfway between 0 and 1.5
+    LinePosition_GetBand(0x18u, &below, &above);
+    CHECK_NEAR(below, 0.375, 1e-6);
+    CHECK_NEAR(above, 0.375, 1e-6);
+    // Left side is even
+    LinePosition_GetBand(0x02u, &below, &above);
+    CHECK_NEAR(below, 0.25, 1e-6);
+    CHECK_NEAR(above, 0.25, 1e-6);
+    // Ends of the bar are symmetric
+    LinePosition_GetBand(0x40u, &below, &above);
+    CHECK_NEAR(below, 0.25, 1e-6);
+    CHECK_NEAR(above, 0.25, 1e-6);
+    LinePosition_GetBand(0x00u, &below, &above);
+    CHECK(below == 0.0f && above == 0.0f);
+
+    // Bands follow the weights
+    LinePosition_SetWeight(6, 5.5f);
+    LinePosition_GetBand(0x40u, &below, &above);
+    CHECK_NEAR(below, 0.75, 1e-6);
+    LinePosition_SetWeight(6, 3.5f);
+}
+
+int main(void)
+{
+    LinePosition_Init();
+    testBands();
+
+    // Constant drift: the estimate never stops inside the wide bands right of center,
+    // and once the velocity has converged it follows the line between the edges
+    Replay result = replay(sweep, 0.65f, 0u);
+    CHECK(result.stops == 0u);
+    CHECK(result.meanError < 0.6f * result.rawMeanError);
+    result = replay(sweep, 0.65f, 300000u);
+    CHECK(result.maxError < 0.15f);
+    printf("sweep: mean error %.3f (raw %.3f), max %.3f, stops %u\n",
+           result.meanError, result.rawMeanError, result.maxError, (unsigned)result.stops);
+
+    // Weave: turning inside a band stops the estimate; the velocity lags a changing
+    // drift, but the estimate stays within the band around the line
+    result = replay(weave, 4.0f, 100000u);
+    CHECK(result.maxError < 0.75f);
+    CHECK(result.meanError < 1.2f * result.rawMeanError);
+    printf("weave: mean error %.3f (raw %.3f), max %.3f, stops %u\n",
+           result.meanError, result.rawMeanError, result.maxError, (unsigned)result.stops);
+
+    // Line held inside a pattern: the estimate is the pattern position
+    result = replay(hold, 0.2f, 0u);
+    CHECK_NEAR(result.maxError, 0.3, 1e-6);
+
+    return testResult("test_line_estimator");
+}
+
+/* [] END OF FILE */
@@ -0,0 +1,99 @@
+/* ========================================
+ * test_line_position.c
+ * ========================================
+ */
+
+// Position table against the per-tick loop it replaced, bit for bit, for all 128 patterns
+
+#include "test.h"
+#include "line_position.h"
+#include <string.h>
+
+// Old calculateLinePosition() of main_cm4.c, weights passed in
+static float oldLinePosition(const float weights[LINE_SENSOR_COUNT], uint8_t sensors, float lastError)
+{
+    float weightedSum = 0.0f;
+    int activeCount = 0;
+
+    for (uint8_t i = 0; i < 7; i++)
+    {
+        if (sensors & (1 << i))
+        {
+            weightedSum += weights[i];
+            activeCount++;
+        }
+    }
+
+    if (activeCount > 0)
+    {
+        return weightedSum / (float)activeCount;
+    }
+    else
+    {
+        return (lastError < 0.0f) ? -3.0f : 3.0f;
+    }
+}
+
+static bool sameBits(float a, float b)
+{
+    return memcmp(&a, &b, sizeof(a)) == 0;
+}
+
+// Every pattern, line last seen on either side
+static uint32_t countMismatches(const float weights[LINE_SENSOR_COUNT])
+{
+    static const float lastPositions[] = { -1.25f, 0.0f, 2.0f };
+    uint32_t mismatches = 0;
+
+    for (uint32_t pattern = 0; pattern < LINE_PATTERN_COUNT; pattern++)
+    {
+        for (uint8_t last = 0; last < 3u; last++)
+        {
+            float expected = oldLinePosition(weights, (uint8_t)pattern, lastPositions[last]);
+            float actual = LinePosition_Get((uint8_t)pattern, lastPositions[last]);
+            if (!sameBits(actual, expected))
+            {
+                printf("pattern 0x%02X: %.9g, expected %.9g\n", (unsigned)pattern, actual, expected);
+                mismatches++;
+            }
+        }
+    }
+    return mismatches;
+}
+
+int main(void)
+{
+    static const float defaults[LINE_SENSOR_COUNT] = { -3.0f, -2.0f, -1.0f, 0.0f, 1.5f, 2.5f, 3.5f };
+    static const float uneven[LINE_SENSOR_COUNT] = { -3.1f, -1.7f, -0.9f, 0.05f, 1.3f, 2.45f, 3.3f };
+
+    LinePosition_Init();
+    for (uint8_t i = 0; i < LINE_SENSOR_COUNT; i++)
+    {
+        CHECK(sameBits(LinePosition_GetWeight(i), defaults[i]));
+    }
+    CHECK(countMismatches(defaults) == 0u);
+
+    // Weights that do not sum exactly in float, the table keeps the loop's rounding
+    LinePosition_SetWeights(uneven);
+    CHECK(countMismatches(uneven) == 0u);
+    LinePosition_SetWeight(3, defaults[3]);
+    float mixed[LINE_SENSOR_COUNT];
+    memcpy(mixed, uneven, sizeof(mixed));
+    mixed[3] = defaults[3];
+    CHECK(countMismatches(mixed) == 0u);
+    LinePosition_SetWeights(defaults);
+
+    // Upper bit of the port is not a sensor
+    CHECK(sameBits(LinePosition_Get(0x88u, 0.0f), LinePosition_Get(0x08u, 0.0f)));
+
+    // Other no-line policies
+    LinePosition_SetNoLinePolicy(LINE_NO_LINE_HOLD);
+    CHECK(LinePosition_Get(0x00u, -1.5f) == -1.5f);
+    CHECK(LinePosition_Get(0x01u, -1.5f) == -3.0f);
+    LinePosition_SetNoLinePolicy(LINE_NO_LINE_CENTER);
+    CHECK(LinePosition_Get(0x00u, -1.5f) == 0.0f);
+
+    return testResult("test_line_position");
+}
+
+/* [] END OF FILE */
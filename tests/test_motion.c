@@ -0,0 +1,158 @@
+/* ========================================
+ * test_motion.c
+ * ========================================
+ */
+
+// Speed and curvature mixing: pivot on the inner wheel, saturation that keeps
+// the curvature, speed reduction, rate limits and the unlimited first command
+
+#include "test.h"
+#include "motion.h"
+
+#define PERIOD_US   (2000u)
+#define PERIOD_S    (PERIOD_US * 1.0e-6)
+
+// One command right after a reset, taken without rate limit
+static MotionWheels mix(Motion* motion, float speed, float curvature)
+{
+    Motion_Reset(motion, 1000u);
+    return Motion_Update(motion, speed, curvature, 1000u);
+}
+
+static void testMixing(void)
+{
+    Motion motion;
+    MotionWheels wheels;
+
+    Motion_Init(&motion);
+
+    wheels = mix(&motion, 1000.0f, 0.0f);
+    CHECK_NEAR(wheels.left, 1000.0, 1.0e-3);
+    CHECK_NEAR(wheels.right, 1000.0, 1.0e-3);
+
+    // +1 pivots on the right (inner) wheel, -1 on the left one
+    wheels = mix(&motion, 1000.0f, 1.0f);
+    CHECK_NEAR(wheels.left, 2000.0, 1.0e-3);
+    CHECK_NEAR(wheels.right, 0.0, 1.0e-3);
+    wheels = mix(&motion, 1000.0f, -1.0f);
+    CHECK_NEAR(wheels.left, 0.0, 1.0e-3);
+    CHECK_NEAR(wheels.right, 2000.0, 1.0e-3);
+
+    // Past the pivot the inner wheel reverses
+    wheels = mix(&motion, 1000.0f, 3.0f);
+    CHECK_NEAR(wheels.left, 4000.0, 1.0e-3);
+    CHECK_NEAR(wheels.right, -2000.0, 1.0e-3);
+
+    // Reversing keeps the turn direction of the curvature sign
+    wheels = mix(&motion, -1000.0f, 0.5f);
+    CHECK_NEAR(wheels.left, -1500.0, 1.0e-3);
+    CHECK_NEAR(wheels.right, -500.0, 1.0e-3);
+
+    // Curvature is limited to maxCurvature
+    wheels = mix(&motion, 100.0f, 1000.0f);
+    CHECK_NEAR(wheels.left, 100.0 * (1.0 + MOTION_MAX_CURVATURE), 1.0e-2);
+    CHECK_NEAR(wheels.right, 100.0 * (1.0 - MOTION_MAX_CURVATURE), 1.0e-2);
+
+    // Speed reduction 1 keeps the outer wheel at speed, the pivot still holds
+    Motion_SetMixing(&motion, 1.0f, MOTION_MAX_CURVATURE);
+    wheels = mix(&motion, 1000.0f, 1.0f);
+    CHECK_NEAR(wheels.left, 1000.0, 1.0e-3);
+    CHECK_NEAR(wheels.right, 0.0, 1.0e-3);
+    wheels = mix(&motion, 1000.0f, -0.5f);
+    CHECK_NEAR(wheels.left, 1000.0 * 0.5 / 1.5, 1.0e-3);
+    CHECK_NEAR(wheels.right, 1000.0, 1.0e-3);
+}
+
+static void testSaturation(void)
+{
+    Motion motion;
+    const float curvatures[] = { 0.0f, 0.3f, -0.7f, 1.0f, 2.5f, -6.0f };
+
+    Motion_Init(&motion);
+    for (uint32_t i = 0; i < sizeof(curvatures) / sizeof(curvatures[0]); i++)
+    {
+        float curvature = curvatures[i];
+        MotionWheels wheels = mix(&motion, 3500.0f, curvature);
+        double largest = fmax(fabs(wheels.left), fabs(wheels.right));
+
+        CHECK(largest <= MOTION_MAX_WHEEL_SPEED + 1.0e-2);
+        // The side ratio is the unsaturated one: (1 + c) * right == (1 - c) * left
+        CHECK_NEAR((1.0 - curvature) * wheels.left - (1.0 + curvature) * wheels.right, 0.0, 1.0e-2);
+        if (curvature != 0.0f)
+        {
+            // Any curvature saturates at this speed, the outer wheel is at full scale
+            CHECK_NEAR(largest, MOTION_MAX_WHEEL_SPEED, 1.0e-2);
+        }
+        else
+        {
+            CHECK_NEAR(wheels.left, 3500.0, 1.0e-3);
+        }
+    }
+}
+
+static void testRateLimits(void)
+{
+    Motion motion;
+    uint64_t now = 1000u;
+    MotionWheels wheels;
+
+    Motion_Init(&motion);
+    Motion_SetRateLimits(&motion, 10000.0f, 50.0f);
+    Motion_Reset(&motion, now);
+
+    // First command after reset passes as is
+    wheels = Motion_Update(&motion, 2000.0f, 0.5f, now);
+    CHECK_NEAR(motion.speed, 2000.0, 1.0e-3);
+    CHECK_NEAR(motion.curvature, 0.5, 1.0e-6);
+    CHECK_NEAR(wheels.left, 3000.0, 1.0e-3);
+
+    // Steps towards a far command are bounded by rate * dt every period
+    float lastSpeed = motion.speed;
+    float lastCurvature = motion.curvature;
+    uint32_t steps = 0;
+    while ((steps < 1000u) && ((motion.speed != 0.0f) || (motion.curvature != -1.0f)))
+    {
+        now += PERIOD_US;
+        (void)Motion_Update(&motion, 0.0f, -1.0f, now);
+        CHECK(fabs(motion.speed - lastSpeed) <= 10000.0 * PERIOD_S + 1.0e-3);
+        CHECK(fabs(motion.curvature - lastCurvature) <= 50.0 * PERIOD_S + 1.0e-5);
+        lastSpeed = motion.speed;
+        lastCurvature = motion.curvature;
+        steps++;
+    }
+    // Speed needs 2000 / 20 = 100 periods, curvature 1.5 / 0.1 = 15
+    CHECK(steps == 100u);
+    CHECK(motion.speed == 0.0f);
+    CHECK(motion.curvature == -1.0f);
+
+    // A longer period allows a larger step
+    now += 10u * PERIOD_US;
+    (void)Motion_Update(&motion, 2000.0f, -1.0f, now);
+    CHECK_NEAR(motion.speed, 10000.0 * 10.0 * PERIOD_S, 1.0e-2);
+
+    // After a reset the next command jumps again
+    Motion_Reset(&motion, now);
+    now += PERIOD_US;
+    wheels = Motion_Update(&motion, -1500.0f, 0.0f, now);
+    CHECK_NEAR(wheels.left, -1500.0, 1.0e-3);
+    CHECK_NEAR(wheels.right, -1500.0, 1.0e-3);
+}
+
+static void testCorrectionToCurvature(void)
+{
+    CHECK_NEAR(Motion_CorrectionToCurvature(1000.0f, 500.0f), 0.5, 1.0e-6);
+    CHECK_NEAR(Motion_CorrectionToCurvature(-1000.0f, 500.0f), 0.5, 1.0e-6);
+    // Slow or stopped: against MOTION_MIN_SPEED, no division by zero
+    CHECK_NEAR(Motion_CorrectionToCurvature(0.0f, 300.0f), 300.0 / MOTION_MIN_SPEED, 1.0e-6);
+}
+
+int main(void)
+{
+    testMixing();
+    testSaturation();
+    testRateLimits();
+    testCorrectionToCurvature();
+    return testResult("test_motion");
+}
+
+/* [] END OF FILE */
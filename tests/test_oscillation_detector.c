@@ -0,0 +1,181 @@
+/* ========================================
+ * test_oscillation_detector.c
+ * ========================================
+ */
+
+// Synthetic line errors at the 500 Hz control rate: sines above and below the
+// frequency and amplitude thresholds, a square wave with a known crossing
+// count, noise inside the hysteresis band, the once-per-window report and reset
+
+#include "test.h"
+#include "oscillation_detector.h"
+
+#define PI          (3.14159265358979)
+#define PERIOD_US   (2000u)
+#define WINDOW_S    (OSCILLATION_WINDOW * PERIOD_US * 1.0e-6)
+
+typedef struct
+{
+    uint32_t reports;
+    uint32_t firstReport;   // Sample number of the first report, 0 = none
+    uint32_t lastReport;
+    float frequency;        // At the first report, or at the end without one
+    float amplitude;
+} Run;
+
+static float sine(uint32_t n, float frequency, float amplitude)
+{
+    return amplitude * (float)sin(2.0 * PI * frequency * n * PERIOD_US * 1.0e-6);
+}
+
+static float square(uint32_t n, float frequency, float amplitude)
+{
+    return (sine(n, frequency, 1.0f) >= 0.0f) ? amplitude : -amplitude;
+}
+
+// Deterministic noise, uniform in +-amplitude (frequency is unused)
+static float noise(uint32_t n, float frequency, float amplitude)
+{
+    uint32_t state = n * 1664525u + 1013904223u;
+    (void)frequency;
+    state ^= state >> 13;
+    state *= 0x5bd1e995u;
+    state ^= state >> 15;
+    return amplitude * (2.0f * (float)(state >> 8) / (float)(1u << 24) - 1.0f);
+}
+
+static Run run(OscillationDetector* detector, float (*signal)(uint32_t, float, float),
+               float frequency, float amplitude, uint32_t samples)
+{
+    Run result = { 0 };
+    uint64_t now = 0u;
+
+    OscillationDetector_Reset(detector, now);
+    for (uint32_t n = 1; n <= samples; n++)
+    {
+        now += PERIOD_US;
+        if (OscillationDetector_Update(detector, signal(n, frequency, amplitude), now))
+        {
+            if (result.reports == 0u)
+            {
+                result.firstReport = n;
+                result.frequency = OscillationDetector_GetFrequency(detector);
+                result.amplitude = OscillationDetector_GetAmplitude(detector);
+            }
+            result.reports++;
+            result.lastReport = n;
+        }
+    }
+    if (result.reports == 0u)
+    {
+        result.frequency = OscillationDetector_GetFrequency(detector);
+        result.amplitude = OscillationDetector_GetAmplitude(detector);
+    }
+    return result;
+}
+
+static void testAboveThresholds(void)
+{
+    static OscillationDetector detector;
+    OscillationDetector_Init(&detector);
+
+    // 5 Hz, amplitude 1: reported as soon as the window is full, then once per window
+    Run result = run(&detector, sine, 5.0f, 1.0f, 4u * OSCILLATION_WINDOW);
+    CHECK(result.firstReport == OSCILLATION_WINDOW);
+    CHECK(result.reports == 4u);
+    CHECK(result.lastReport == 4u * OSCILLATION_WINDOW);
+    // Whole crossings only: the estimate is within one crossing of the true frequency
+    CHECK_NEAR(result.frequency, 5.0, 0.5 / WINDOW_S);
+    CHECK_NEAR(result.amplitude, 1.0, 0.05);
+
+    // Square wave: half period 50 samples, crossings at 50, 100, .. 250
+    result = run(&detector, square, 5.0f, 1.0f, OSCILLATION_WINDOW);
+    CHECK(result.reports == 1u);
+    CHECK_NEAR(result.frequency, 0.5 * 5.0 / WINDOW_S, 1.0e-3);
+    CHECK_NEAR(result.amplitude, PI / 2.0, 1.0e-4);
+}
+
+static void testBelowThresholds(void)
+{
+    static OscillationDetector detector;
+    OscillationDetector_Init(&detector);
+
+    // Slow wobble: a corner sequence, not a limit cycle
+    Run result = run(&detector, sine, 1.0f, 1.0f, 10u * OSCILLATION_WINDOW);
+    CHECK(result.reports == 0u);
+    CHECK(result.frequency < OSCILLATION_MIN_FREQUENCY);
+    CHECK_NEAR(result.frequency, 1.0, 0.5 / WINDOW_S);
+
+    // Fast but small
+    result = run(&detector, sine, 5.0f, 0.4f, 10u * OSCILLATION_WINDOW);
+    CHECK(result.reports == 0u);
+    CHECK_NEAR(result.amplitude, 0.4, 0.03);
+    CHECK_NEAR(result.frequency, 5.0, 0.5 / WINDOW_S);
+
+    // Lower thresholds take both
+    OscillationDetector_SetThresholds(&detector, 0.5f, 0.3f);
+    result = run(&detector, sine, 1.0f, 1.0f, 10u * OSCILLATION_WINDOW);
+    CHECK(result.reports > 0u);
+    result = run(&detector, sine, 5.0f, 0.4f, OSCILLATION_WINDOW);
+    CHECK(result.reports == 1u);
+}
+
+static void testHysteresis(void)
+{
+    static OscillationDetector detector;
+    OscillationDetector_Init(&detector);
+    OscillationDetector_SetThresholds(&detector, 0.5f, 0.0f);
+
+    // Noise and a fast square inside the band never cross
+    Run result = run(&detector, noise, 0.0f, 0.95f * OSCILLATION_HYSTERESIS, 10u * OSCILLATION_WINDOW);
+    CHECK(result.reports == 0u);
+    CHECK(result.frequency == 0.0f);
+    result = run(&detector, square, 50.0f, 0.9f * OSCILLATION_HYSTERESIS, 10u * OSCILLATION_WINDOW);
+    CHECK(result.reports == 0u);
+    CHECK(result.frequency == 0.0f);
+
+    // Just outside the band it does
+    result = run(&detector, square, 5.0f, 1.1f * OSCILLATION_HYSTERESIS, OSCILLATION_WINDOW);
+    CHECK(result.reports == 1u);
+    CHECK_NEAR(result.frequency, 0.5 * 5.0 / WINDOW_S, 1.0e-3);
+}
+
+static void testReset(void)
+{
+    static OscillationDetector detector;
+    uint64_t now = 0u;
+    uint32_t n;
+
+    OscillationDetector_Init(&detector);
+    OscillationDetector_Reset(&detector, now);
+    for (n = 1; n < OSCILLATION_WINDOW; n++)
+    {
+        now += PERIOD_US;
+        CHECK(!OscillationDetector_Update(&detector, sine(n, 5.0f, 1.0f), now));
+    }
+
+    // Cleared one sample before the window fills: a full new window is needed
+    OscillationDetector_Reset(&detector, now);
+    for (n = 1; n < OSCILLATION_WINDOW; n++)
+    {
+        now += PERIOD_US;
+        CHECK(!OscillationDetector_Update(&detector, sine(n, 5.0f, 1.0f), now));
+    }
+    now += PERIOD_US;
+    CHECK(OscillationDetector_Update(&detector, sine(n, 5.0f, 1.0f), now));
+
+    // The report survives the internal reset
+    CHECK(OscillationDetector_GetFrequency(&detector) > OSCILLATION_MIN_FREQUENCY);
+    CHECK(OscillationDetector_GetAmplitude(&detector) > OSCILLATION_MIN_AMPLITUDE);
+}
+
+int main(void)
+{
+    testAboveThresholds();
+    testBelowThresholds();
+    testHysteresis();
+    testReset();
+    return testResult("test_oscillation_detector");
+}
+
+/* [] END OF FILE */
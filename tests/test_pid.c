@@ -0,0 +1,57 @@
+/* ========================================
+ * test_pid.c
+ * ========================================
+ */
+
+// Derivative filter of the line PID: at the 2 ms control period with the 8 ms
+// filter, a step in the error kicks the D term as hard as it used to at 10 ms
+
+#include "test.h"
+#include "pid.h"
+
+#define KD          (20.0f)
+#define STEP        (1.0f)
+
+// D output over a number of updates after an error step, P and I off
+static float derivativeKick(uint32_t periodUs, uint32_t filterUs, uint32_t updates)
+{
+    Pid pid;
+    uint64_t now = 0;
+    float output = 0.0f;
+
+    Pid_Init(&pid, 0.0f, 0.0f, KD, 1000.0f, 30000.0f);  // Output limit fits Q16.16
+    Pid_SetDerivativeFilter(&pid, filterUs);
+    Pid_Reset(&pid, now);
+    for (uint32_t i = 0; i < updates; i++)
+    {
+        now += periodUs;
+        output = PID_TO_FLOAT(Pid_Update(&pid, PID_FROM_FLOAT(STEP), now));
+    }
+    return output;
+}
+
+int main(void)
+{
+    float oldKick = derivativeKick(10000u, 0u, 1u);
+    float unfilteredKick = derivativeKick(2000u, 0u, 1u);
+    float filteredKick = derivativeKick(2000u, 8000u, 1u);
+
+    CHECK_NEAR(oldKick, KD * STEP / 0.010f, 1.0);
+    CHECK_NEAR(unfilteredKick, 5.0f * oldKick, 5.0);
+    CHECK_NEAR(filteredKick, oldKick, 1.0);
+
+    // The filtered kick decays with the time constant, e^-1 after 4 periods
+    CHECK_NEAR(derivativeKick(2000u, 8000u, 5u), filteredKick * 0.8f * 0.8f * 0.8f * 0.8f, 1.0);
+    CHECK(derivativeKick(2000u, 8000u, 100u) < 0.01f);
+
+    // Constant error: no derivative once settled, filtered or not
+    CHECK_NEAR(derivativeKick(2000u, 0u, 2u), 0.0, 1e-3);
+
+    #if (PID_IMPLEMENTATION == PID_IMPL_Q16)
+    return testResult("test_pid (Q16)");
+#else
+    return testResult("test_pid (float)");
+#endif
+}
+
+/* [] END OF FILE */
@@ -0,0 +1,166 @@
+/* ========================================
+ * test_scheduler.c
+ * ========================================
+ */
+
+// Scheduler on a simulated 1 ms tick: periods, order, jitter, execution time and overruns
+
+#include "test.h"
+#include "scheduler.h"
+#include <string.h>
+
+#define TICK_US     (1000u)
+#define POLL_US     (5u)        // Main loop overhead between two Scheduler_Run() calls
+
+static uint32_t simTime = 0;    // Microseconds
+
+static uint32_t simClock(void)
+{
+    return simTime;
+}
+
+// Let time pass, the tick "interrupt" fires on every millisecond boundary
+static void advance(uint32_t us)
+{
+    for (uint32_t i = 0; i < us; i++)
+    {
+        simTime++;
+        if ((simTime % TICK_US) == 0u)
+        {
+            Scheduler_Tick();
+        }
+    }
+}
+
+static void runFor(uint32_t ticks)
+{
+    uint32_t end = Scheduler_GetTicks() + ticks;
+    while (Scheduler_GetTicks() < end)
+    {
+        Scheduler_Run();
+        advance(POLL_US);
+    }
+}
+
+static char order[64];
+static uint32_t controlExecUs = 300u;
+static uint32_t slowExecUs = 0u;
+
+static void control(void)
+{
+    strncat(order, "c", sizeof(order) - strlen(order) - 1u);
+    advance(controlExecUs);
+}
+
+static void ipc(void)
+{
+    strncat(order, "i", sizeof(order) - strlen(order) - 1u);
+    advance(20u);
+}
+
+static void leds(void)
+{
+    strncat(order, "l", sizeof(order) - strlen(order) - 1u);
+    advance(100u);
+}
+
+static void slow(void)
+{
+    advance(slowExecUs);
+}
+
+static void testPeriods(void)
+{
+    simTime = 0;
+    Scheduler_Init(simClock);
+    uint8_t controlId = Scheduler_AddTask("control", control, 2u);
+    uint8_t ipcId = Scheduler_AddTask("ipc", ipc, 1u);
+    uint8_t ledsId = Scheduler_AddTask("leds", leds, 33u);
+
+    CHECK(Scheduler_GetTaskCount() == 3u);
+    CHECK(strcmp(Scheduler_GetTaskName(ledsId), "leds") == 0);
+
+    runFor(990u);
+    Scheduler_Run();
+
+    CHECK(Scheduler_GetTaskStats(controlId)->runs == 495u);
+    CHECK(Scheduler_GetTaskStats(ipcId)->runs == 990u);
+    CHECK(Scheduler_GetTaskStats(ledsId)->runs == 30u);
+    CHECK(Scheduler_GetTaskStats(controlId)->overruns == 0u);
+    CHECK(Scheduler_GetTaskStats(ipcId)->overruns == 0u);
+
+    // Execution time is measured with the clock
+    CHECK(Scheduler_GetTaskStats(controlId)->maxExecTime == controlExecUs);
+    CHECK(Scheduler_GetTaskStats(ledsId)->lastExecTime == 100u);
+
+    // Control comes first, so its jitter is the main loop poll only;
+    // IPC waits behind control on even ticks, LEDs behind both
+    CHECK(Scheduler_GetTaskStats(controlId)->maxJitter <= POLL_US);
+    CHECK(Scheduler_GetTaskStats(ipcId)->maxJitter >= controlExecUs);
+    CHECK(Scheduler_GetTaskStats(ipcId)->maxJitter <= controlExecUs + POLL_US);
+    CHECK(Scheduler_GetTaskStats(ledsId)->maxJitter <= controlExecUs + 20u + POLL_US);
+}
+
+static void testOrder(void)
+{
+    simTime = 0;
+    Scheduler_Init(simClock);
+    (void)Scheduler_AddTask("control", control, 2u);
+    (void)Scheduler_AddTask("ipc", ipc, 1u);
+    order[0] = '\0';
+
+    runFor(4u);
+    Scheduler_Run();
+
+    // Tick 1: ipc, tick 2: control before ipc, ...
+    CHECK(strcmp(order, "icii" "ci") == 0);
+}
+
+static void testOverruns(void)
+{
+    simTime = 0;
+    Scheduler_Init(simClock);
+    uint8_t slowId = Scheduler_AddTask("slow", slow, 1u);
+
+    slowExecUs = 100u;
+    runFor(10u);
+    CHECK(Scheduler_GetTaskStats(slowId)->overruns == 0u);
+
+    // A run of 3.5 ms misses three releases, they are skipped, not run back-to-back
+    Scheduler_ResetStats();
+    slowExecUs = 3500u;
+    Scheduler_Run();
+    slowExecUs = 100u;
+    uint32_t ticksAfterSlow = Scheduler_GetTicks();
+    Scheduler_Run();
+    CHECK(Scheduler_GetTaskStats(slowId)->overruns == 3u);
+    CHECK(Scheduler_GetTaskStats(slowId)->runs == 1u);
+
+    runFor(1u);
+    Scheduler_Run();
+    CHECK(Scheduler_GetTaskStats(slowId)->runs == 2u);
+    CHECK(Scheduler_GetTicks() == ticksAfterSlow + 1u);
+    CHECK(Scheduler_GetTaskStats(slowId)->maxExecTime == 3500u);
+}
+
+static void testTableFull(void)
+{
+    Scheduler_Init(simClock);
+    for (uint8_t i = 0; i < SCHEDULER_MAX_TASKS; i++)
+    {
+        CHECK(Scheduler_AddTask("task", ipc, 1u) == i);
+    }
+    CHECK(Scheduler_AddTask("extra", ipc, 1u) == SCHEDULER_INVALID_TASK);
+    CHECK(Scheduler_AddTask("null", NULL, 1u) == SCHEDULER_INVALID_TASK);
+}
+
+int main(void)
+{
+    testPeriods();
+    testOrder();
+    testOverruns();
+    testTableFull();
+    return testResult("test_scheduler");
+}
+
+/* [] END OF FILE */
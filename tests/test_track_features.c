@@ -0,0 +1,226 @@
+/* ========================================
+ * test_track_features.c
+ * ========================================
+ */
+
+// Replay of Track_Read() pattern sequences through the feature detector:
+// crossings (square and at an angle), start/finish marks, T and Y junctions,
+// line ends, laps and segment times. Sequences are runs of (pattern, ticks)
+// as the 7 sensors see them at 500 Hz; bit 3 is the centre sensor.
+
+#include "test.h"
+#include "track_features.h"
+
+#define PERIOD_US   (2000u)
+#define MAX_EVENTS  (32u)
+
+typedef struct
+{
+    uint8_t pattern;
+    uint16_t ticks;
+} Step;
+
+static TrackFeatureEvent events[MAX_EVENTS];
+static uint32_t eventCount;
+static uint64_t now;
+
+static void record(const TrackFeatureEvent* event)
+{
+    if (eventCount < MAX_EVENTS)
+    {
+        events[eventCount] = *event;
+    }
+    eventCount++;
+}
+
+static void reset(void)
+{
+    now = 0u;
+    eventCount = 0u;
+    TrackFeatures_Reset(now);
+}
+
+static void replay(const Step* steps, uint32_t count)
+{
+    for (uint32_t i = 0; i < count; i++)
+    {
+        for (uint16_t tick = 0; tick < steps[i].ticks; tick++)
+        {
+            now += PERIOD_US;
+            TrackFeatures_Update(steps[i].pattern, now);
+        }
+    }
+}
+
+#define REPLAY(steps)   replay((steps), sizeof(steps) / sizeof((steps)[0]))
+
+static uint32_t countEvents(enum trackFeature feature)
+{
+    uint32_t count = 0;
+    for (uint32_t i = 0; (i < eventCount) && (i < MAX_EVENTS); i++)
+    {
+        if (events[i].feature == feature)
+        {
+            count++;
+        }
+    }
+    return count;
+}
+
+static void testCrossing(void)
+{
+    // Square on: full pattern only
+    static const Step square[] = { { 0x08, 50 }, { 0x7F, 5 }, { 0x08, 50 } };
+    reset();
+    REPLAY(square);
+    CHECK(eventCount == 1u);
+    CHECK(events[0].feature == TRACK_FEATURE_CROSSING);
+    // Confirmed on the third full pattern
+    CHECK(events[0].time == (50u + 3u) * PERIOD_US);
+
+    // At an angle: one side reaches the cross line first, wide and split patterns
+    // around the full one belong to the crossing
+    static const Step angled[] = {
+        { 0x08, 50 }, { 0x0C, 2 }, { 0x0F, 3 }, { 0x4F, 2 }, { 0x7F, 3 },
+        { 0x79, 2 }, { 0x78, 5 }, { 0x18, 2 }, { 0x08, 50 }
+    };
+    reset();
+    REPLAY(angled);
+    CHECK(eventCount == 1u);
+    CHECK(events[0].feature == TRACK_FEATURE_CROSSING);
+
+    // Too short to be a crossing (sensor glitch)
+    static const Step glitch[] = { { 0x08, 50 }, { 0x7F, 2 }, { 0x08, 50 } };
+    reset();
+    REPLAY(glitch);
+    CHECK(eventCount == 0u);
+}
+
+static void testStartFinish(void)
+{
+    // Mark on one side, on the other side with a two sensor wide line, on both sides
+    static const Step marks[] = {
+        { 0x08, 50 }, { 0x09, 4 }, { 0x08, 200 },
+        { 0x18, 50 }, { 0x58, 4 }, { 0x18, 200 },
+        { 0x08, 50 }, { 0x49, 4 }, { 0x08, 50 }
+    };
+    reset();
+    REPLAY(marks);
+    CHECK(eventCount == 3u);
+    CHECK(countEvents(TRACK_FEATURE_START_FINISH) == 3u);
+    CHECK(TrackFeatures_GetLapCount() == 2u);
+    CHECK(TrackFeatures_GetLastLapTime() == (4u + 200u + 50u) * PERIOD_US);
+    CHECK(events[2].lap == 2u);
+    CHECK(events[2].lastLapTime == (4u + 200u + 50u) * PERIOD_US);
+
+    // Too short, and a group away from the edge is not a mark
+    static const Step notMarks[] = {
+        { 0x08, 50 }, { 0x09, 2 }, { 0x08, 50 }, { 0x28, 4 }, { 0x08, 50 }
+    };
+    reset();
+    REPLAY(notMarks);
+    CHECK(countEvents(TRACK_FEATURE_START_FINISH) == 0u);
+    CHECK(TrackFeatures_GetLapCount() == 0u);
+}
+
+static void testJunction(void)
+{
+    // T: branch to one side
+    static const Step tee[] = { { 0x08, 50 }, { 0x0F, 6 }, { 0x08, 50 } };
+    reset();
+    REPLAY(tee);
+    CHECK(eventCount == 1u);
+    CHECK(events[0].feature == TRACK_FEATURE_JUNCTION);
+
+    // Y centred on the car: the line widens, splits from the middle and the car
+    // follows one branch
+    static const Step fork[] = {
+        { 0x08, 50 }, { 0x1C, 3 }, { 0x36, 3 }, { 0x63, 3 }, { 0x41, 2 }, { 0x01, 2 },
+        { 0x03, 3 }, { 0x06, 3 }, { 0x0C, 3 }, { 0x08, 50 }
+    };
+    reset();
+    REPLAY(fork);
+    CHECK(countEvents(TRACK_FEATURE_JUNCTION) == 1u);
+    CHECK(countEvents(TRACK_FEATURE_START_FINISH) == 0u);
+    CHECK(TrackFeatures_GetLapCount() == 0u);
+
+    // Y with the car one sensor off: the split passes a mark-like pattern
+    // (line on the centre, narrow group at the edge) before the branch moves on
+    static const Step offsetFork[] = {
+        { 0x10, 50 }, { 0x38, 3 }, { 0x6C, 3 }, { 0x46, 3 }, { 0x44, 3 }, { 0x04, 3 },
+        { 0x0C, 3 }, { 0x08, 50 }
+    };
+    reset();
+    REPLAY(offsetFork);
+    CHECK(countEvents(TRACK_FEATURE_JUNCTION) == 1u);
+    CHECK(countEvents(TRACK_FEATURE_START_FINISH) == 0u);
+
+    // Mark right after a fork is vetoed by the guard window, after it counts again
+    static const Step markNearFork[] = {
+        { 0x08, 50 }, { 0x36, 5 }, { 0x08, 5 }, { 0x09, 4 }, { 0x08, 50 }, { 0x09, 4 }, { 0x08, 50 }
+    };
+    reset();
+    REPLAY(markNearFork);
+    CHECK(countEvents(TRACK_FEATURE_JUNCTION) == 1u);
+    CHECK(countEvents(TRACK_FEATURE_START_FINISH) == 1u);
+}
+
+static void testLineEnd(void)
+{
+    static const Step gap[] = { { 0x08, 50 }, { 0x00, TRACK_LINE_END_TICKS - 1u }, { 0x08, 50 } };
+    reset();
+    REPLAY(gap);
+    CHECK(eventCount == 0u);
+
+    // Reported once per empty run
+    static const Step end[] = { { 0x08, 50 }, { 0x00, 200 } };
+    reset();
+    REPLAY(end);
+    CHECK(eventCount == 1u);
+    CHECK(events[0].feature == TRACK_FEATURE_LINE_END);
+    CHECK(events[0].time == (50u + TRACK_LINE_END_TICKS) * PERIOD_US);
+}
+
+static void testLap(void)
+{
+    // Mark, crossing, T junction, mark: the lap is cut into three segments
+    static const Step lap[] = {
+        { 0x08, 20 }, { 0x09, 4 }, { 0x08, 100 }, { 0x7F, 4 }, { 0x08, 100 },
+        { 0x78, 5 }, { 0x08, 100 }, { 0x09, 4 }, { 0x08, 10 }
+    };
+    reset();
+    REPLAY(lap);
+    CHECK(eventCount == 4u);
+    CHECK(TrackFeatures_GetLapCount() == 1u);
+    CHECK(TrackFeatures_GetLastLapTime() == (4u + 100u + 4u + 100u + 5u + 100u) * PERIOD_US);
+
+    // The second mark starts the next lap as segment 0
+    CHECK(TrackFeatures_GetSegmentCount() == 1u);
+    CHECK(TrackFeatures_GetSegment(0)->feature == TRACK_FEATURE_START_FINISH);
+    CHECK(TrackFeatures_GetSegment(1) == NULL);
+
+    // Segments of the completed lap as the events reported them. Marks and
+    // junctions are confirmed on the first tick after their run.
+    CHECK((events[0].feature == TRACK_FEATURE_START_FINISH) && (events[0].segment == 0u) && (events[0].lapTime == 0u));
+    CHECK(events[0].time == (20u + 4u + 1u) * PERIOD_US);
+    CHECK((events[1].feature == TRACK_FEATURE_CROSSING) && (events[1].segment == 1u));
+    CHECK(events[1].lapTime == (100u - 1u + 3u) * PERIOD_US);
+    CHECK((events[2].feature == TRACK_FEATURE_JUNCTION) && (events[2].segment == 2u));
+    CHECK(events[2].lapTime == (100u - 1u + 4u + 100u + 5u + 1u) * PERIOD_US);
+    CHECK((events[3].lap == 1u) && (events[3].segment == 0u));
+}
+
+int main(void)
+{
+    TrackFeatures_Init();
+    (void)TrackFeatures_Subscribe(record);
+
+    testCrossing();
+    testStartFinish();
+    testJunction();
+    testLineEnd();
+    testLap();
+    return testResult("test_track_features");
+}
+
+/* [] END OF FILE */
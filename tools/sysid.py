@@ -0,0 +1,411 @@
+#!/usr/bin/env python3
+"""Model-based tuning of the line PID from an identification capture.
+
+The car adds a chirp or PRBS excitation on top of its steering correction
+(CM4_COMMAND_SYSID, see sysid.h) and records line position, steering command
+and excitation. This tool downloads the capture over BLE, fits a low-order
+model of the steering plant (command -> line position) and searches PD gains
+with the required stability margins on that model.
+
+    sysid.py capture --address AA:BB:CC:DD:EE:FF --signal chirp --out run.csv
+    sysid.py fit run.csv
+    sysid.py fit run.csv --apply --address AA:BB:CC:DD:EE:FF
+
+Model, fitted in the frequency domain over the excited band:
+
+    P(s) = K e^(-delay s) / (s^n (1 + lag s)),  n = 1 or 2
+
+The line position of a car is close to a double integrator of the steering
+command with some lag and delay. The loop stays closed during the capture, so
+the command carries the sensor noise fed back through the controller and a
+plain fit of position against command is biased. The plant response is
+estimated from cross spectra with the excitation instead, which the car
+generated and which is independent of the noise:
+
+    P(jw) = S_yr(w) / S_ur(w)
+
+Only frequencies where the command is coherent with the excitation are used.
+
+Gains are searched on a Kp x Kd grid. A candidate has to give a stable closed
+loop, at least --phase-margin and --gain-margin and a controller gain at the
+Nyquist frequency (sensor noise amplification) below --max-noise-gain. Among
+those the one with the highest crossover frequency wins.
+
+Needs numpy, capture and --apply need bleak.
+"""
+
+import argparse
+import asyncio
+import csv
+import math
+import struct
+import sys
+
+import numpy as np
+
+# Nordic UART service of the car (BLE_config.c)
+NUS_RX = "6e400002-b5a3-f393-e0a9-e50e24dcca9e"     # Write
+NUS_TX = "6e400003-b5a3-f393-e0a9-e50e24dcca9e"     # Notify
+
+# ble_nus_subsys.h, cm4_command_list.h
+BLE_NUS_PAYLOAD_CM4_CMD = 0x02
+CM4_COMMAND_STOP_CAR = 0x02
+CM4_COMMAND_ECHO = 0x03
+CM4_COMMAND_SYSID = 0x06
+CM4_SYSID_START = 0x00
+CM4_SYSID_DOWNLOAD = 0x01
+ECHO_KP = 2
+ECHO_KD = 3
+
+# telemetry.h, sysid.h
+TELEMETRY_HEADER = 5                # Frame type, 32-bit timestamp
+TELEMETRY_FRAME_SYSID = 0x0B
+TELEMETRY_FRAME_SYSID_DATA = 0x0C
+SYSID_CHANNELS = 3
+SYSID_DECIMATION = 2                # Control periods per sample
+SYSID_SIGNALS = {"chirp": 0, "prbs": 1}
+SYSID_STATES = {0: "idle", 1: "running", 2: "done", 3: "aborted"}
+SYSID_RUNNING = 1
+MERGE_GAP = 16                      # Samples received between two gaps that are simply sent again
+
+# main_cm4.c defaults, for comparison with the recommendation
+DEFAULT_KP = 500.0
+DEFAULT_KD = 20.0
+
+
+# ---------------------------------------------------------------------------
+# Capture over BLE
+# ---------------------------------------------------------------------------
+
+class Status:
+    def __init__(self, payload):
+        (self.state, self.signal, self.count, self.period_us,
+         self.amplitude, self.speed) = struct.unpack_from("<BBHIhh", payload)
+
+    def __str__(self):
+        return "%s, %d samples, %d us, amplitude %d, speed %d" % (
+            SYSID_STATES.get(self.state, "?"), self.count, self.period_us, self.amplitude, self.speed)
+
+
+async def send(client, *payload):
+    await client.write_gatt_char(NUS_RX, bytes((BLE_NUS_PAYLOAD_CM4_CMD,) + payload), response=True)
+
+
+async def request_download(client, first, count):
+    await send(client, CM4_COMMAND_SYSID, CM4_SYSID_DOWNLOAD, *struct.pack("<HH", first, count))
+
+
+def missing_ranges(samples, count, merge):
+    """(first, count) ranges of sample indices not received yet, gaps up to merge samples are joined"""
+    ranges = []
+    index = 0
+    while index < count:
+        if index in samples:
+            index += 1
+            continue
+        first = index
+        while index < count and index not in samples:
+            index += 1
+        if ranges and first - sum(ranges[-1]) <= merge:
+            ranges[-1] = (ranges[-1][0], index - ranges[-1][0])
+        else:
+            ranges.append((first, index - first))
+    return ranges
+
+
+async def collect(client, frames, args):
+    """Wait for the capture to finish and download it, lost frames are requested again"""
+    status = None
+    stopped = False
+    samples = {}
+    received = 0
+    retries = 0
+    loop = asyncio.get_running_loop()
+    deadline = loop.time() + args.timeout
+
+    while loop.time() < deadline:
+        try:
+            frame = await asyncio.wait_for(frames.get(), args.idle)
+        except asyncio.TimeoutError:
+            if status is None or status.state == SYSID_RUNNING:
+                # Still running (or the status was lost): ask again, samples follow when done
+                await request_download(client, 0, 0)
+                continue
+            missing = missing_ranges(samples, status.count, MERGE_GAP)
+            if not missing:
+                break
+            # Retries count only while nothing new arrives
+            retries = 0 if len(samples) > received else retries + 1
+            received = len(samples)
+            if retries > args.retries:
+                print("giving up, %d samples missing" % sum(n for _, n in missing), file=sys.stderr)
+                break
+            await request_download(client, *missing[0])
+            continue
+
+        if len(frame) <= TELEMETRY_HEADER:
+            continue
+        payload = frame[TELEMETRY_HEADER:]
+        if frame[0] == TELEMETRY_FRAME_SYSID:
+            status = Status(payload)
+            print("capture", status)
+            if status.state != SYSID_RUNNING and not stopped and not args.keep_driving:
+                await send(client, CM4_COMMAND_STOP_CAR)
+                stopped = True
+        elif frame[0] == TELEMETRY_FRAME_SYSID_DATA:
+            index = struct.unpack_from("<H", payload)[0]
+            values = struct.unpack_from("<%dh" % ((len(payload) - 2) // 2), payload, 2)
+            for i in range(len(values) // SYSID_CHANNELS):
+                samples[index + i] = values[i * SYSID_CHANNELS:(i + 1) * SYSID_CHANNELS]
+
+    if status is None:
+        raise RuntimeError("no answer from the car")
+    return status, [samples[i] for i in range(status.count) if i in samples]
+
+
+async def capture(args):
+    from bleak import BleakClient
+
+    frames = asyncio.Queue()
+    async with BleakClient(args.address) as client:
+        await client.start_notify(NUS_TX, lambda _, data: frames.put_nowait(bytes(data)))
+        await send(client, CM4_COMMAND_SYSID, CM4_SYSID_START, SYSID_SIGNALS[args.signal],
+                   *struct.pack("<h", args.amplitude))
+        status, samples = await collect(client, frames, args)
+
+    if len(samples) < status.count:
+        print("%d of %d samples received, gaps are dropped" % (len(samples), status.count), file=sys.stderr)
+    period = status.period_us * 1e-6
+    with open(args.out, "w", newline="") as f:
+        f.write("# signal=%s period_us=%d amplitude=%d speed=%d state=%s\n" % (
+            args.signal, status.period_us, status.amplitude, status.speed, SYSID_STATES.get(status.state, "?")))
+        writer = csv.writer(f)
+        writer.writerow(["t", "position", "command", "excitation"])
+        for i, (position, command, excitation) in enumerate(samples):
+            writer.writerow(["%.4f" % (i * period), "%.3f" % (position / 1000.0), command, excitation])
+    print("saved", args.out)
+    return args.out
+
+
+async def apply_gains(address, kp, kd):
+    from bleak import BleakClient
+
+    async with BleakClient(address) as client:
+        for command, value in ((ECHO_KP, kp), (ECHO_KD, kd)):
+            await send(client, CM4_COMMAND_ECHO, command, *struct.pack("<h", int(round(value))))
+    print("applied Kp %d, Kd %d" % (round(kp), round(kd)))
+
+
+# ---------------------------------------------------------------------------
+# Model fit
+# ---------------------------------------------------------------------------
+
+def load(path):
+    meta = {}
+    rows = []
+    with open(path, newline="") as f:
+        for line in f:
+            if line.startswith("#"):
+                for item in line[1:].split():
+                    key, _, value = item.partition("=")
+                    meta[key] = value
+                continue
+            if line.startswith("t,"):
+                continue
+            rows.append([float(x) for x in line.strip().split(",")])
+    data = np.array(rows)
+    period = float(meta["period_us"]) * 1e-6 if "period_us" in meta else data[1, 0] - data[0, 0]
+    return meta, period, data[:, 1], data[:, 2], data[:, 3]
+
+
+def frequency_response(y, u, r, period, segment):
+    """Plant response from cross spectra with the excitation (Welch, Hann, 50 % overlap)"""
+    segment = min(segment, len(y))
+    window = np.hanning(segment)
+    syr = sur = suu = srr = 0
+    for start in range(0, len(y) - segment + 1, segment // 2):
+        part = slice(start, start + segment)
+        fy, fu, fr = (np.fft.rfft(window * (x[part] - x[part].mean())) for x in (y, u, r))
+        syr = syr + fy * np.conj(fr)
+        sur = sur + fu * np.conj(fr)
+        suu = suu + np.abs(fu) ** 2
+        srr = srr + np.abs(fr) ** 2
+    w = 2 * math.pi * np.fft.rfftfreq(segment, period)
+    with np.errstate(divide="ignore", invalid="ignore"):
+        response = syr / sur
+        coherence = np.abs(sur) ** 2 / (suu * srr)
+    return w, response, np.nan_to_num(coherence)
+
+
+class Model:
+    """K e^(-delay s) / (s^integrators (1 + lag s))"""
+
+    def __init__(self, gain, integrators, lag, delay):
+        self.gain = gain
+        self.integrators = integrators
+        self.lag = lag
+        self.delay = delay
+
+    def response(self, w):
+        s = 1j * w
+        return self.gain * np.exp(-self.delay * s) / (s ** self.integrators * (1 + self.lag * s))
+
+    def __str__(self):
+        return "%.4g e^(-%.0f ms s) / (s^%d (1 + %.0f ms s))" % (
+            self.gain, self.delay * 1e3, self.integrators, self.lag * 1e3)
+
+
+def fit(w, response, weight):
+    """Least squares of the complex log error over the excited band, grid over lag and delay"""
+    best = None
+    for integrators in (1, 2):
+        for lag in np.linspace(0.0, 0.3, 61):
+            for delay in np.linspace(0.0, 0.1, 51):
+                shape = Model(1.0, integrators, lag, delay).response(w)
+                ratio = response / shape
+                # Gain is real, its sign from the mean phase of the ratio
+                sign = 1.0 if np.sum(weight * np.cos(np.angle(ratio))) >= 0 else -1.0
+                log_gain = np.sum(weight * np.log(np.abs(ratio))) / np.sum(weight)
+                residual = np.log(ratio / (sign * math.exp(log_gain)))
+                error = np.sum(weight * np.abs(residual) ** 2) / np.sum(weight)
+                if best is None or error < best[1]:
+                    best = (Model(sign * math.exp(log_gain), integrators, lag, delay), error)
+    return best
+
+
+# ---------------------------------------------------------------------------
+# Gain search
+# ---------------------------------------------------------------------------
+
+def controller(kp, kd, w, period):
+    """PD of pid.c running every control period, derivative by backward difference"""
+    return kp + kd * (1.0 - np.exp(-1j * w * period)) / period
+
+
+def margins(model, kp, kd, w, period):
+    """Crossover (rad/s), phase margin (deg), gain margin (ratio); margins > 0 dB / 0 deg mean stable"""
+    # Positive correction turns towards the line, so the loop is y = P C y and L = -P C
+    # Sample and hold of the control period adds half a period of delay
+    loop = -model.response(w) * controller(kp, kd, w, period) * np.exp(-0.5j * w * period)
+    magnitude = np.abs(loop)
+    phase = np.degrees(np.unwrap(np.angle(loop)))
+    # Integrators start the phase at -90 / -180 deg, unwrap from there
+    phase -= 360.0 * round((phase[0] + 90.0 * model.integrators) / 360.0)
+
+    crossover = phase_margin = None
+    below = np.nonzero(magnitude < 1.0)[0]
+    if len(below) and below[0] > 0:
+        crossover = w[below[0]]
+        phase_margin = 180.0 + phase[below[0]]
+
+    gain_margin = math.inf
+    crossing = np.nonzero(phase <= -180.0)[0]
+    if len(crossing):
+        gain_margin = 1.0 / magnitude[crossing[0]]
+    return crossover, phase_margin, gain_margin
+
+
+def search(model, args, period):
+    w = np.logspace(math.log10(2 * math.pi * 0.02), math.log10(0.99 * math.pi / period), 600)
+    best = None
+    for kp in np.logspace(math.log10(args.kp_min), math.log10(args.kp_max), 80):
+        for kd in np.concatenate([[0.0], np.logspace(-1, 3, 60)]):
+            if kp + 2.0 * kd / period > args.max_noise_gain:
+                continue
+            crossover, phase_margin, gain_margin = margins(model, kp, kd, w, period)
+            if crossover is None or phase_margin < args.phase_margin:
+                continue
+            if 20 * math.log10(gain_margin) < args.gain_margin:
+                continue
+            if best is None or crossover > best[2]:
+                best = (kp, kd, crossover)
+    return w, best
+
+
+def describe(name, model, kp, kd, w, period):
+    crossover, phase_margin, gain_margin = margins(model, kp, kd, w, period)
+    if crossover is None:
+        print("%-12s Kp %7.1f  Kd %6.2f  no crossover" % (name, kp, kd))
+        return
+    stable = phase_margin > 0 and gain_margin > 1
+    print("%-12s Kp %7.1f  Kd %6.2f  %s, crossover %.2f Hz, phase margin %.0f deg, gain margin %.1f dB" % (
+        name, kp, kd, "stable" if stable else "UNSTABLE", crossover / (2 * math.pi), phase_margin,
+        20 * math.log10(gain_margin)))
+
+
+def run_fit(path, args):
+    meta, period, y, u, r = load(path)
+    control_period = period / SYSID_DECIMATION
+
+    w, response, coherence = frequency_response(y, u, r, period, args.segment)
+    band = (w >= 2 * math.pi * args.f_min) & (w <= 2 * math.pi * args.f_max) & (coherence >= args.coherence)
+    if np.count_nonzero(band) < 4:
+        print("excitation too weak: %d usable frequencies, raise the amplitude" % np.count_nonzero(band))
+        return None
+    model, error = fit(w[band], response[band], coherence[band])
+
+    print("%d samples, Ts %.1f ms, speed %s, %d frequencies %.2f..%.2f Hz" % (
+        len(y), period * 1e3, meta.get("speed", "?"), np.count_nonzero(band),
+        w[band][0] / (2 * math.pi), w[band][-1] / (2 * math.pi)))
+    print("model: %s, rms log error %.2f" % (model, math.sqrt(error)))
+    if model.gain > 0:
+        print("warning: positive command moves the line right, check the sign convention", file=sys.stderr)
+
+    w, best = search(model, args, control_period)
+    describe("current", model, args.kp, args.kd, w, control_period)
+    if best is None:
+        print("no gains meet the margins, lower --phase-margin / --gain-margin or capture again")
+        return None
+    kp, kd = best[0], best[1]
+    describe("recommended", model, kp, kd, w, control_period)
+    print("ECHO: {0x%02X, 0x%02X, %d, 0x%02X, 0x%02X}  {0x%02X, 0x%02X, %d, 0x%02X, 0x%02X}" % (
+        (BLE_NUS_PAYLOAD_CM4_CMD, CM4_COMMAND_ECHO, ECHO_KP) + tuple(struct.pack("<h", int(round(kp)))) +
+        (BLE_NUS_PAYLOAD_CM4_CMD, CM4_COMMAND_ECHO, ECHO_KD) + tuple(struct.pack("<h", int(round(kd))))))
+    print("gains hold for the capture speed; capture again after changing base speed")
+    return kp, kd
+
+
+def main():
+    parser = argparse.ArgumentParser(description=__doc__.splitlines()[0])
+    sub = parser.add_subparsers(dest="mode", required=True)
+
+    capture_parser = sub.add_parser("capture", help="run a capture on the car, download it and fit")
+    capture_parser.add_argument("--address", required=True, help="BLE address of the car")
+    capture_parser.add_argument("--signal", choices=sorted(SYSID_SIGNALS), default="chirp")
+    capture_parser.add_argument("--amplitude", type=int, default=0, help="motor units, 0 = SYSID_AMPLITUDE")
+    capture_parser.add_argument("--out", default="sysid.csv")
+    capture_parser.add_argument("--keep-driving", action="store_true", help="don't stop the car after the capture")
+    capture_parser.add_argument("--timeout", type=float, default=120.0, help="seconds for capture and download")
+    capture_parser.add_argument("--idle", type=float, default=0.5, help="seconds without frames before asking again")
+    capture_parser.add_argument("--retries", type=int, default=50)
+
+    fit_parser = sub.add_parser("fit", help="fit a saved capture")
+    fit_parser.add_argument("csv")
+    fit_parser.add_argument("--address", help="BLE address of the car, for --apply")
+
+    for p in (capture_parser, fit_parser):
+        p.add_argument("--segment", type=int, default=1024, help="samples per spectral average")
+        p.add_argument("--f-min", type=float, default=0.2, help="Hz, lowest frequency fitted")
+        p.add_argument("--f-max", type=float, default=8.0, help="Hz, highest frequency fitted")
+        p.add_argument("--coherence", type=float, default=0.5, help="minimal command / excitation coherence")
+        p.add_argument("--phase-margin", type=float, default=45.0, help="degrees")
+        p.add_argument("--gain-margin", type=float, default=6.0, help="dB")
+        p.add_argument("--max-noise-gain", type=float, default=40000.0,
+                       help="controller gain at Nyquist, motor units per position unit")
+        p.add_argument("--kp-min", type=float, default=20.0)
+        p.add_argument("--kp-max", type=float, default=20000.0)
+        p.add_argument("--kp", type=float, default=DEFAULT_KP, help="current Kp, for comparison")
+        p.add_argument("--kd", type=float, default=DEFAULT_KD, help="current Kd, for comparison")
+        p.add_argument("--apply", action="store_true", help="send the recommended gains (ECHO 2, 3)")
+
+    args = parser.parse_args()
+    path = asyncio.run(capture(args)) if args.mode == "capture" else args.csv
+    gains = run_fit(path, args)
+    if gains is not None and args.apply:
+        if not args.address:
+            parser.error("--apply needs --address")
+        asyncio.run(apply_gains(args.address, *gains))
+
+
+if __name__ == "__main__":
+    main()